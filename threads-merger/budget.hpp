@@ -0,0 +1,274 @@
+#ifndef BUDGET_HPP
+#define BUDGET_HPP
+
+#include "merger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Limits of merging and rendering, so an interactive caller gets a graph in bounded time whatever
+ * the size of the input.
+ *
+ * When a limit is reached, the work stops and the result is truncated but well-formed: the stacks
+ * that are merged are rendered, the tables that are not rendered are replaced with placeholders,
+ * and the graph is labeled with what is left out.
+ */
+
+enum class BudgetStage
+{
+    // Items are stacks.
+    Merge,
+    // Items are tables.
+    Render,
+};
+
+struct Budget
+{
+    // Time of merging and rendering together; zero means no time limit.
+    std::chrono::milliseconds time_limit{0};
+    // Maximum number of nodes of the merged tree, before it is collapsed; 0 means no limit.
+    std::size_t node_limit = 0;
+    // A stop request, e.g. from another thread, cancels the work.
+    std::stop_token stop_token{};
+    // Called with the numbers of done and all items of a stage. Returning false cancels the work,
+    // so a caller without threads can cancel it too.
+    std::function<bool(BudgetStage stage, std::size_t done, std::size_t total)> progress{};
+};
+
+/**
+ * Checks a budget while the work goes on. Merging may take the first half of the time,
+ * so the merged stacks can be rendered in the rest.
+ */
+class BudgetTracker
+{
+public:
+    // The limits are checked every this number of items, so the checks cost little.
+    static constexpr std::size_t check_interval = 256;
+
+    explicit BudgetTracker(Budget budget)
+        : budget_(std::move(budget))
+        , start_(std::chrono::steady_clock::now())
+    {}
+
+    const Budget& budget() const { return budget_; }
+
+    /**
+     * Called before each item of a stage.
+     * @return false if the work must stop. The result of the next calls is not defined then.
+     */
+    bool check(const BudgetStage stage, const std::size_t done, const std::size_t total)
+    {
+        if (cancelled_) {
+            return false;
+        }
+        if (done % check_interval != 0) {
+            return true;
+        }
+        if (budget_.stop_token.stop_requested() || (budget_.progress && !budget_.progress(stage, done, total))) {
+            cancelled_ = true;
+            return false;
+        }
+        if (budget_.time_limit.count() == 0) {
+            return true;
+        }
+        const auto stage_time = stage == BudgetStage::Merge ? budget_.time_limit / 2 : budget_.time_limit;
+        return std::chrono::steady_clock::now() - start_ < stage_time;
+    }
+
+    bool cancelled() const { return cancelled_; }
+
+private:
+    Budget budget_;
+    std::chrono::steady_clock::time_point start_;
+    bool cancelled_ = false;
+};
+
+template<typename T>
+struct BudgetedMerge
+{
+    Node<T> tree;
+    // Numbers of the non-empty stacks in the tree and in the input.
+    std::size_t merged_stacks = 0;
+    std::size_t total_stacks = 0;
+
+    bool truncated() const { return merged_stacks < total_stacks; }
+};
+
+/**
+ * Merges stacks in the order of the input until the budget runs out.
+ * Identical stacks are not grouped first, so each stack costs its frames only.
+ *
+ * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+ * @param resource Memory resource for all nodes of the tree. It must outlive the tree.
+ * @param scratch Memory resource for temporary data.
+ */
+template<typename T>
+BudgetedMerge<T> merge(
+    const std::vector<std::vector<T>>& lists,
+    BudgetTracker& tracker,
+    const Orientation orientation = Orientation::CallerRooted,
+    const std::size_t depth_limit = 0,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    BudgetedMerge<T> result{.tree = Node<T>{.next_nodes = NodeMap<T>(resource)}};
+    result.total_stacks = std::ranges::count_if(lists, [](const auto& list) { return !list.empty(); });
+
+    const auto node_limit = tracker.budget().node_limit;
+    std::size_t node_count = 0;
+    for (std::size_t i = 0; i < lists.size(); ++i) {
+        if (lists[i].empty()) {
+            continue;
+        }
+        if ((node_limit > 0 && node_count >= node_limit) || !tracker.check(BudgetStage::Merge, i, lists.size())) {
+            break;
+        }
+        node_count += add_stack(result.tree, lists[i], depth_limit, orientation);
+        ++result.merged_stacks;
+    }
+
+    collapse(result.tree, scratch);
+
+    return result;
+}
+
+struct BudgetedDot
+{
+    std::string dot;
+    bool truncated = false;
+};
+
+/**
+ * Renders a tree like get_dot_graph() until the budget runs out. The tables are rendered
+ * breadth-first, so all roots go before the deeper tables. The tables that are not rendered are
+ * replaced with one placeholder node "table_<id>_more" for each rendered parent, and the roots
+ * that are not rendered with one node "table_roots_more".
+ *
+ * @param missing_stacks Number of stacks that are not merged into the tree, shown in the label.
+ */
+template<typename T>
+BudgetedDot get_budgeted_dot_graph(
+    const Node<T>& root,
+    BudgetTracker& tracker,
+    const Orientation orientation = Orientation::CallerRooted,
+    const DotStyle style = DotStyle::Verbose,
+    const std::size_t missing_stacks = 0,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    const auto layout = layout_dot_graph(root, scratch);
+    const auto indent = style == DotStyle::Compact ? "" : "  ";
+    const auto table_count = layout.tables.size();
+
+    // Table ids are 0..n-1. The links are sorted, so the links of a parent are consecutive.
+    std::pmr::vector<std::size_t> positions(table_count, 0, scratch);
+    std::pmr::vector<bool> is_root(table_count, true, scratch);
+    for (std::size_t i = 0; i < table_count; ++i) {
+        positions[layout.tables[i].id] = i;
+    }
+    for (const auto& link : layout.links) {
+        is_root[link.second] = false;
+    }
+    std::pmr::vector<int> order{scratch};
+    order.reserve(table_count);
+    for (const auto& table : layout.tables) {
+        if (is_root[table.id]) {
+            order.push_back(table.id);
+        }
+    }
+    const auto root_count = order.size();
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        auto link = std::ranges::lower_bound(layout.links, std::pair{order[i], 0});
+        for (; link != layout.links.end() && link->first == order[i]; ++link) {
+            order.push_back(link->second);
+        }
+    }
+
+    // The rendered tables are written in the order of the layout, as by get_dot_graph().
+    std::pmr::vector<std::string> tables(table_count, scratch);
+    std::pmr::vector<bool> rendered(table_count, false, scratch);
+    std::size_t rendered_count = 0;
+    std::size_t rendered_roots = 0;
+    std::ostringstream table_dot;
+    for (const auto id : order) {
+        if (!tracker.check(BudgetStage::Render, rendered_count, table_count)) {
+            break;
+        }
+        table_dot.str({});
+        write_dot_table<T>(table_dot, id, layout.chain(layout.tables[positions[id]]), orientation, style);
+        tables[id] = table_dot.str();
+        rendered[id] = true;
+        ++rendered_count;
+        rendered_roots += is_root[id] ? 1 : 0;
+    }
+
+    std::pmr::vector<std::pair<int, int>> links{scratch};
+    std::pmr::vector<std::pair<int, std::size_t>> hidden{scratch};
+    for (const auto& link : layout.links) {
+        if (!rendered[link.first]) {
+            continue;
+        }
+        if (rendered[link.second]) {
+            links.push_back(link);
+        } else if (!hidden.empty() && hidden.back().first == link.first) {
+            ++hidden.back().second;
+        } else {
+            hidden.emplace_back(link.first, 1);
+        }
+    }
+
+    std::ostringstream dot;
+    write_dot_header(dot, orientation, style);
+    const auto missing_tables = table_count - rendered_count;
+    if (missing_stacks > 0 || missing_tables > 0) {
+        dot << indent << "labelloc=t;\n" << indent << "label=\"Truncated:";
+        if (missing_stacks > 0) {
+            dot << ' ' << missing_stacks << " stacks not merged" << (missing_tables > 0 ? "," : "");
+        }
+        if (missing_tables > 0) {
+            dot << ' ' << missing_tables << " tables not rendered";
+        }
+        dot << "\";\n";
+    }
+    for (const auto& table : layout.tables) {
+        dot << tables[table.id];
+    }
+    if (rendered_roots < root_count) {
+        dot << indent << "table_roots_more [shape=box style=dashed fontsize=14 label=\"+ " << root_count - rendered_roots << " root tables\"]\n";
+    }
+    for (const auto& [id, count] : hidden) {
+        // The font size of a compact graph is for tables.
+        dot << indent << "table_" << id << "_more [shape=box style=dashed fontsize=14 label=\"+ " << count << " tables\"]\n";
+        dot << indent << "table_" << id << " -> table_" << id << "_more [style=dashed]\n";
+    }
+    write_dot_links(dot, links, orientation, style);
+    return {dot.str(), missing_stacks > 0 || missing_tables > 0};
+}
+
+/**
+ * Merges stacks and renders them to DOT within the budget.
+ *
+ * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+ */
+template<typename T>
+BudgetedDot merge_to_graphviz_dot_budgeted(
+    const std::vector<std::vector<T>>& lists,
+    Budget budget,
+    const Orientation orientation = Orientation::CallerRooted,
+    const std::size_t depth_limit = 0,
+    const DotStyle style = DotStyle::Verbose)
+{
+    BudgetTracker tracker{std::move(budget)};
+    const auto merged = merge(lists, tracker, orientation, depth_limit);
+    return get_budgeted_dot_graph(merged.tree, tracker, orientation, style, merged.total_stacks - merged.merged_stacks);
+}
+
+#endif // BUDGET_HPP
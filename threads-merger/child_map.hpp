@@ -0,0 +1,450 @@
+#ifndef CHILD_MAP_HPP
+#define CHILD_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <utility>
+
+/*
+ * Map of the children of a tree node.
+ *
+ * Most nodes of a merged tree have exactly one child, a few have several, and only some nodes,
+ * like the roots of thread pools, have many. So the map keeps:
+ *
+ * - one child in place, without any extra allocation;
+ * - a handful of children in a small array, searched linearly;
+ * - many children in the array with a hash index of their positions. The index is an open
+ *   addressing table of 8-byte entries, a position and a hash, without copies of the keys.
+ *
+ * Each child is allocated separately and never moves, so references to the children stay valid
+ * until they are erased, as in std::unordered_map. The iteration order is unspecified.
+ *
+ * The interface is the subset of std::pmr::unordered_map used by the merger.
+ */
+template<typename Key, typename Value>
+class ChildMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<const Key, Value>;
+    using size_type = std::size_t;
+    using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+
+    // Number of children from which the hash index is used.
+    static constexpr size_type index_threshold = 8;
+
+    template<bool Const>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ChildMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        basic_iterator() = default;
+        explicit basic_iterator(value_type* const* slot) : slot_(slot) {}
+
+        // A mutable iterator converts to a const one.
+        template<bool OtherConst> requires (Const && !OtherConst)
+        basic_iterator(const basic_iterator<OtherConst>& other) : slot_(other.slot()) {}
+
+        reference operator*() const { return **slot_; }
+        pointer operator->() const { return *slot_; }
+
+        basic_iterator& operator++() { ++slot_; return *this; }
+        basic_iterator operator++(int) { auto copy = *this; ++slot_; return copy; }
+
+        bool operator==(const basic_iterator& other) const = default;
+
+        value_type* const* slot() const { return slot_; }
+
+    private:
+        value_type* const* slot_ = nullptr;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    ChildMap() = default;
+
+    explicit ChildMap(const allocator_type& allocator) : allocator_(allocator) {}
+
+    ChildMap(std::initializer_list<value_type> values, const allocator_type& allocator = {})
+        : allocator_(allocator)
+    {
+        for (const auto& value : values) {
+            emplace(value.first, value.second);
+        }
+    }
+
+    // Like std::pmr containers, a copy uses the default memory resource, for all descendants too.
+    ChildMap(const ChildMap& other)
+    {
+        copy_from(other);
+    }
+
+    ChildMap(ChildMap&& other) noexcept
+        : allocator_(other.allocator_)
+    {
+        steal(other);
+    }
+
+    ChildMap& operator=(const ChildMap& other)
+    {
+        if (this != &other) {
+            clear();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    // The memory resource is not propagated: children of another resource are copied with their
+    // descendants, since moving them would leave the descendants in the other resource.
+    ChildMap& operator=(ChildMap&& other)
+    {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        if (allocator_ == other.allocator_) {
+            steal(other);
+        } else {
+            copy_from(other);
+            other.clear();
+        }
+        return *this;
+    }
+
+    ~ChildMap()
+    {
+        clear();
+    }
+
+    allocator_type get_allocator() const { return allocator_; }
+
+    size_type size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    iterator begin() { return iterator{slots()}; }
+    iterator end() { return iterator{slots() + size_}; }
+    const_iterator begin() const { return const_iterator{slots()}; }
+    const_iterator end() const { return const_iterator{slots() + size_}; }
+
+    iterator find(const Key& key)
+    {
+        return iterator{slots() + position(key)};
+    }
+
+    const_iterator find(const Key& key) const
+    {
+        return const_iterator{slots() + position(key)};
+    }
+
+    bool contains(const Key& key) const { return position(key) != size_; }
+
+    Value& at(const Key& key)
+    {
+        const auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("ChildMap::at");
+        }
+        return it->second;
+    }
+
+    const Value& at(const Key& key) const
+    {
+        const auto it = find(key);
+        if (it == end()) {
+            throw std::out_of_range("ChildMap::at");
+        }
+        return it->second;
+    }
+
+    Value& operator[](const Key& key)
+    {
+        return emplace(key, Value{}).first->second;
+    }
+
+    template<typename V>
+    std::pair<iterator, bool> emplace(const Key& key, V&& value)
+    {
+        const auto found = position(key);
+        if (found != size_) {
+            return {iterator{slots() + found}, false};
+        }
+
+        auto* child = allocator_.template new_object<value_type>(key, std::forward<V>(value));
+        try {
+            push_back(child);
+        } catch (...) {
+            allocator_.delete_object(child);
+            throw;
+        }
+        return {iterator{slots() + size_ - 1}, true};
+    }
+
+    size_type erase(const Key& key)
+    {
+        const auto found = position(key);
+        if (found == size_) {
+            return 0;
+        }
+
+        auto** all = slots();
+
+        // The last child takes the place of the erased one.
+        const auto last = size_ - 1;
+        if (index_) {
+            index_erase(static_cast<std::uint32_t>(found));
+            if (found != last) {
+                index_entry(static_cast<std::uint32_t>(last))->position = static_cast<std::uint32_t>(found);
+            }
+        }
+        allocator_.delete_object(all[found]);
+        all[found] = all[last];
+        --size_;
+
+        if (capacity_ > 0 && size_ <= 1) {
+            // Back to a single child in place.
+            auto* single = size_ == 1 ? all[0] : nullptr;
+            release_storage();
+            single_ = single;
+        }
+        return 1;
+    }
+
+    void clear()
+    {
+        auto** all = slots();
+        for (size_type i = 0; i < size_; ++i) {
+            allocator_.delete_object(all[i]);
+        }
+        release_storage();
+        single_ = nullptr;
+        size_ = 0;
+    }
+
+    // The same children with equal values, in any order.
+    friend bool operator==(const ChildMap& a, const ChildMap& b)
+    {
+        if (a.size_ != b.size_) {
+            return false;
+        }
+        for (const auto& [key, value] : a) {
+            const auto it = b.find(key);
+            if (it == b.end() || !(it->second == value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    struct IndexEntry
+    {
+        static constexpr std::uint32_t empty = UINT32_MAX;
+
+        std::uint32_t position = empty;
+        std::uint32_t hash = 0;
+    };
+
+    allocator_type allocator_;
+    std::uint32_t size_ = 0;
+    // Zero while the only child is kept in place.
+    std::uint32_t capacity_ = 0;
+    union {
+        value_type* single_ = nullptr;
+        value_type** array_;
+    };
+    // Twice the capacity of the array, a power of two, from index_threshold children.
+    IndexEntry* index_ = nullptr;
+
+    value_type** slots() { return capacity_ == 0 ? &single_ : array_; }
+    value_type* const* slots() const { return capacity_ == 0 ? &single_ : array_; }
+
+    std::pmr::polymorphic_allocator<value_type*> slot_allocator() const
+    {
+        return std::pmr::polymorphic_allocator<value_type*>{allocator_.resource()};
+    }
+
+    std::pmr::polymorphic_allocator<IndexEntry> index_allocator() const
+    {
+        return std::pmr::polymorphic_allocator<IndexEntry>{allocator_.resource()};
+    }
+
+    std::uint32_t index_size() const { return capacity_ * 2; }
+
+    // The upper bits of a multiplicative hash, so identity hashes of integers spread too.
+    static std::uint32_t key_hash(const Key& key)
+    {
+        return static_cast<std::uint32_t>((std::hash<Key>{}(key) * 0x9e3779b97f4a7c15ull) >> 32);
+    }
+
+    size_type position(const Key& key) const
+    {
+        const auto* all = slots();
+        if (index_) {
+            const auto hash = key_hash(key);
+            const auto mask = index_size() - 1;
+            for (auto i = hash & mask;; i = (i + 1) & mask) {
+                const auto& entry = index_[i];
+                if (entry.position == IndexEntry::empty) {
+                    return size_;
+                }
+                if (entry.hash == hash && all[entry.position]->first == key) {
+                    return entry.position;
+                }
+            }
+        }
+        for (size_type i = 0; i < size_; ++i) {
+            if (all[i]->first == key) {
+                return i;
+            }
+        }
+        return size_;
+    }
+
+    void index_insert(const std::uint32_t position, const std::uint32_t hash)
+    {
+        const auto mask = index_size() - 1;
+        auto i = hash & mask;
+        while (index_[i].position != IndexEntry::empty) {
+            i = (i + 1) & mask;
+        }
+        index_[i] = IndexEntry{position, hash};
+    }
+
+    // The entry of the child at the position.
+    IndexEntry* index_entry(const std::uint32_t position)
+    {
+        const auto mask = index_size() - 1;
+        for (auto i = key_hash(array_[position]->first) & mask;; i = (i + 1) & mask) {
+            if (index_[i].position == position) {
+                return &index_[i];
+            }
+        }
+    }
+
+    // Removes the entry of the child at the position; the following entries of the probe
+    // sequence are shifted back, so no tombstones are needed.
+    void index_erase(const std::uint32_t position)
+    {
+        const auto mask = index_size() - 1;
+        auto hole = static_cast<std::uint32_t>(index_entry(position) - index_);
+        for (auto i = (hole + 1) & mask; index_[i].position != IndexEntry::empty; i = (i + 1) & mask) {
+            const auto home = index_[i].hash & mask;
+            // The entry may fill the hole if its home is not in (hole, i].
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                index_[hole] = index_[i];
+                hole = i;
+            }
+        }
+        index_[hole] = IndexEntry{};
+    }
+
+    void push_back(value_type* child)
+    {
+        if (capacity_ == 0 && size_ == 0) {
+            single_ = child;
+            size_ = 1;
+            return;
+        }
+
+        // Allocations go first, so a failure leaves the map unchanged.
+        const bool grow = size_ == capacity_ || capacity_ == 0;
+        const std::uint32_t new_capacity = !grow ? capacity_ : capacity_ == 0 ? 4 : capacity_ * 2;
+        const bool reindex = size_ + 1 >= index_threshold && (grow || !index_);
+        value_type** new_array = grow ? slot_allocator().allocate(new_capacity) : nullptr;
+        IndexEntry* new_index = nullptr;
+        if (reindex) {
+            try {
+                new_index = index_allocator().allocate(new_capacity * 2);
+            } catch (...) {
+                if (new_array) {
+                    slot_allocator().deallocate(new_array, new_capacity);
+                }
+                throw;
+            }
+        }
+
+        if (index_ && reindex) {
+            index_allocator().deallocate(index_, index_size());
+            index_ = nullptr;
+        }
+        if (grow) {
+            std::copy_n(slots(), size_, new_array);
+            if (capacity_ > 0) {
+                slot_allocator().deallocate(array_, capacity_);
+            }
+            array_ = new_array;
+            capacity_ = new_capacity;
+        }
+
+        array_[size_] = child;
+        ++size_;
+
+        if (reindex) {
+            index_ = new_index;
+            std::uninitialized_fill_n(index_, index_size(), IndexEntry{});
+            for (std::uint32_t i = 0; i < size_; ++i) {
+                index_insert(i, key_hash(array_[i]->first));
+            }
+        } else if (index_) {
+            index_insert(size_ - 1, key_hash(child->first));
+        }
+    }
+
+    void release_storage()
+    {
+        if (index_) {
+            index_allocator().deallocate(index_, index_size());
+            index_ = nullptr;
+        }
+        if (capacity_ > 0) {
+            slot_allocator().deallocate(array_, capacity_);
+            capacity_ = 0;
+        }
+    }
+
+    // A value with children of its own, like Node, is copied with copy_node(), so its descendants
+    // are allocated from the memory resource of this map too.
+    void copy_from(const ChildMap& other)
+    {
+        for (const auto& value : other) {
+            if constexpr (requires { copy_node(value.second, allocator_); }) {
+                emplace(value.first, copy_node(value.second, allocator_));
+            } else {
+                emplace(value.first, value.second);
+            }
+        }
+    }
+
+    void steal(ChildMap& other)
+    {
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        if (capacity_ == 0) {
+            single_ = other.single_;
+        } else {
+            array_ = other.array_;
+        }
+        index_ = other.index_;
+
+        other.size_ = 0;
+        other.capacity_ = 0;
+        other.single_ = nullptr;
+        other.index_ = nullptr;
+    }
+};
+
+#endif // CHILD_MAP_HPP
@@ -1,189 +1,506 @@
 #include "merger.hpp"
-
-#include <cctype>
+#include "budget.hpp"
+#include "core_file.hpp"
+#include "json_export.hpp"
+#include "frame_index.hpp"
+#include "symbolizer.hpp"
+#include "input_parser.hpp"
+#include "perf_script.hpp"
+#include "stuck_threads.hpp"
+#include "merger_daemon.hpp"
+#include "merger_service.hpp"
+#include "svg_renderer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <print>
 #include <ranges>
+#include <span>
+#include <sstream>
 #include <string>
 #include <string_view>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
-// Graphviz is only needed for CLI SVG rendering
-#include <graphviz/gvc.h>
-#include <graphviz/cgraph.h>
+namespace {
 
-static std::string dot_to_svg(const std::string& dot_content) {
-    GVC_t* gvc = gvContext();
-    if (!gvc) {
-        return "Error: Failed to create Graphviz context";
+enum class OutputFormat {
+    Svg,
+    Dot,
+    Json,
+    JsonLines,
+};
+
+struct Options {
+    OutputFormat output_format = OutputFormat::Svg;
+    Orientation orientation = Orientation::CallerRooted;
+    bool formatted_frames = false;
+    bool addresses = false;
+    std::string_view maps_path;
+    std::string_view query;
+    // Render each set of identical subtrees once.
+    bool shared_subtrees = false;
+    // Time to merge and render each input to DOT; zero means no time limit.
+    std::chrono::milliseconds time_limit{0};
+    // Roots of the samples of perf script output.
+    PerfGrouping perf_grouping = PerfGrouping::None;
+};
+
+/*
+ * Time limit of one input, from the start of merging. The stacks that are not merged in time
+ * are shown in the graph.
+ */
+struct InputBudget {
+    std::optional<BudgetTracker> tracker;
+    std::size_t missing_stacks = 0;
+};
+
+/*
+ * Where a tree is written. SVG is rendered by a shared Graphviz context.
+ */
+struct Output {
+    std::ostream& out;
+    // The number of stacks with the queried function and their callers.
+    std::ostream& log;
+    std::function<std::string(const std::string&)> render_svg;
+    // Threads for DOT tables; 0 means the number of hardware threads.
+    unsigned dot_threads = 0;
+    // Debug information and symbol caches, shared by the symbolizers of all inputs.
+    std::shared_ptr<SymbolModules> symbol_modules = std::make_shared<SymbolModules>(Symbolizer::default_cache_dir());
+};
+
+template<typename T>
+Node<T> merge_stacks(const std::vector<std::vector<T>>& lists, const Options& options, InputBudget& budget) {
+    if (options.time_limit.count() == 0) {
+        return merge(lists, options.orientation);
     }
+    auto& tracker = budget.tracker.emplace(Budget{.time_limit = options.time_limit});
+    auto merged = merge(lists, tracker, options.orientation);
+    budget.missing_stacks = merged.total_stacks - merged.merged_stacks;
+    return std::move(merged.tree);
+}
 
-    Agraph_t* graph = agmemread(const_cast<char*>(dot_content.c_str()));
-    if (!graph) {
-        gvFreeContext(gvc);
-        return "Error: Failed to parse DOT content";
+// DOT of the tree in the style, within the time limit of the input if there is one.
+template<typename T>
+std::string dot_graph(const Node<T>& tree, const Options& options, const Output& output, InputBudget& budget, DotStyle style) {
+    if (options.shared_subtrees) {
+        return get_dot_dag(tree, options.orientation, style);
     }
-
-    gvLayout(gvc, graph, "dot");
-
-    char* svg_data = nullptr;
-    size_t svg_length = 0;
-    gvRenderData(gvc, graph, "svg", (char**)&svg_data, &svg_length);
-
-    std::string svg_result;
-    if (svg_data && svg_length > 0) {
-        svg_result = std::string(svg_data, svg_length);
-        gvFreeRenderData(svg_data);
-    } else {
-        svg_result = "Error: Failed to generate SVG";
+    if (budget.tracker) {
+        auto result = get_budgeted_dot_graph(tree, *budget.tracker, options.orientation, style, budget.missing_stacks);
+        if (result.truncated) {
+            std::println(output.log, "The time limit is reached, the graph is truncated");
+        }
+        return std::move(result.dot);
     }
+    return get_dot_graph_parallel(tree, options.orientation, output.dot_threads, style);
+}
 
-    gvFreeLayout(gvc, graph);
-    agclose(graph);
-    gvFreeContext(gvc);
-
-    return svg_result;
+template<typename T>
+void print_tree(const Node<T>& tree, const Options& options, const Output& output, InputBudget& budget) {
+    switch (options.output_format) {
+        case OutputFormat::Json:
+            write_json_tree(output.out, tree);
+            return;
+        case OutputFormat::JsonLines:
+            write_json_lines(output.out, tree);
+            return;
+        case OutputFormat::Dot:
+            std::println(output.out, "{}", dot_graph(tree, options, output, budget, DotStyle::Verbose));
+            return;
+        case OutputFormat::Svg:
+            std::println(output.out, "{}", output.render_svg(dot_graph(tree, options, output, budget, DotStyle::Compact)));
+            return;
+    }
 }
 
-namespace {
+/**
+ * Prints the tree, or only the stacks that contain the queried function if there is a query.
+ * The number of the stacks and their callers, or callees for a callee-rooted tree, are printed to the log.
+ */
+template<typename T>
+void print_queried_tree(const Node<T>& tree, const Options& options, const Output& output, InputBudget& budget) {
+    const auto function = options.query;
+    if (function.empty()) {
+        print_tree(tree, options, output, budget);
+        return;
+    }
 
-std::string_view ltrim(std::string_view sv) {
-    size_t i = 0;
-    while (i < sv.size() && std::isspace(static_cast<unsigned char>(sv[i]))) ++i;
-    return sv.substr(i);
+    const FrameIndex<T> index{tree};
+    std::println(output.log, "{} of {} stacks contain '{}'", index.count(function), tree.count, function);
+    const auto* root_end = options.orientation == Orientation::CalleeRooted ? "<stack top>" : "<stack bottom>";
+    for (const auto& [parent, count] : index.callers(function)) {
+        std::println(output.log, "  {:>6}  {}", count, parent.empty() ? root_end : parent);
+    }
+    print_tree(index.filter(function), options, output, budget);
 }
 
-std::string_view rtrim(std::string_view sv) {
-    size_t i = sv.size();
-    while (i > 0 && std::isspace(static_cast<unsigned char>(sv[i - 1]))) --i;
-    return sv.substr(0, i);
+void print_core(const std::filesystem::path& core_path, const Options& options, const Output& output) {
+    const CoreFile core{core_path};
+    InputBudget budget;
+    const auto address_tree = merge_stacks<std::uint64_t>(core.stacks(), options, budget);
+    Symbolizer symbolizer{output.symbol_modules};
+    for (const auto& mapping : core.mappings()) {
+        symbolizer.add_mapping(mapping);
+    }
+    print_queried_tree(symbolize_tree(address_tree, symbolizer), options, output, budget);
 }
 
-std::string_view trim(std::string_view sv) {
-    return rtrim(ltrim(sv));
-}
+/*
+ * Prints the threads whose stacks are the same in at least the given number of the last core dumps,
+ * taken from one process in turn. The times of the snapshots are the modification times of the files.
+ */
+void print_stuck_threads(std::span<char*> core_paths, std::size_t snapshots, const Options& options, const Output& output) {
+    StuckThreads<std::uint64_t> stuck{snapshots};
+    std::optional<CoreFile> core;
+    std::vector<std::vector<std::uint64_t>> stacks;
+    for (const char* path : core_paths) {
+        core.emplace(path);
+        stacks = core->stacks();
+        std::vector<int> tids;
+        tids.reserve(core->threads().size());
+        for (const auto& thread : core->threads()) {
+            tids.push_back(thread.tid);
+        }
+        stuck.add_snapshot(tids, stacks, std::chrono::file_clock::to_sys(std::filesystem::last_write_time(path)));
+    }
 
-std::vector<std::vector<std::string>> parse_input(std::string_view input) {
-    std::vector<std::vector<std::string>> result;
+    std::println(output.log, "{} of {} threads are stuck", stuck.stuck().size(), stuck.size());
+    for (const auto& thread : stuck.stuck()) {
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(thread.duration).count();
+        std::println(output.log, "  {:>8}  {} s, {} snapshots", thread.tid, seconds, thread.snapshots);
+    }
 
-    for (auto stack_range : input | std::views::split(';')) {
-        // Build string_view over the subrange
-        std::string_view stack_sv(stack_range.begin(), stack_range.end());
-        stack_sv = trim(stack_sv);
-        if (stack_sv.empty()) continue;
+    InputBudget budget;
+    if (options.time_limit.count() > 0) {
+        budget.tracker.emplace(Budget{.time_limit = options.time_limit});
+    }
 
-        std::vector<std::string> stack_vec;
-        for (auto token_range : stack_sv | std::views::split(',')) {
-            std::string_view token_sv(token_range.begin(), token_range.end());
-            token_sv = trim(token_sv);
-            if (token_sv.empty()) continue;
-            stack_vec.emplace_back(token_sv);
+    // Only the stacks of the stuck threads are symbolized.
+    Symbolizer symbolizer{output.symbol_modules};
+    for (const auto& mapping : core->mappings()) {
+        symbolizer.add_mapping(mapping);
+    }
+    const auto tree = merge_stuck_threads(stuck, stacks, [&](const std::uint64_t address) {
+        const auto symbol = symbolizer.symbolize(address);
+        if (!symbol || symbol->function.empty()) {
+            return Frame{std::format("{:#x}", address), symbol ? symbol->module : "", 0, 0};
         }
-        if (!stack_vec.empty()) {
-            result.push_back(std::move(stack_vec));
+        return Frame{symbol->function, symbol->filename, symbol->row, symbol->column};
+    }, options.orientation);
+
+    print_queried_tree(tree, options, output, budget);
+}
+
+/*
+ * Prints the samples of `perf script` output, merged while they are read, so the input may be
+ * larger than the memory. "-" means the standard input.
+ */
+void print_perf_script(std::string_view path, const Options& options, const Output& output) {
+    std::ifstream file;
+    if (path != "-") {
+        file.open(std::string(path), std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Can't open input file: '" + std::string(path) + "'");
         }
     }
+    auto& input = path == "-" ? std::cin : file;
 
-    return result;
+    InputBudget budget;
+    Node<Frame> tree;
+    if (options.time_limit.count() == 0) {
+        add_perf_script(tree, input, options.perf_grouping, 0, options.orientation);
+    } else {
+        // The samples after the time limit are only counted.
+        auto& tracker = budget.tracker.emplace(Budget{.time_limit = options.time_limit});
+        PerfScriptReader reader{input, options.perf_grouping, options.orientation};
+        PerfSample sample;
+        std::size_t merged = 0;
+        while (reader.next(sample)) {
+            if (budget.missing_stacks == 0 && tracker.check(BudgetStage::Merge, merged, 0)) {
+                add_stack(tree, sample.stack, 0, options.orientation);
+                ++merged;
+            } else {
+                ++budget.missing_stacks;
+            }
+        }
+    }
+    collapse(tree);
+    print_queried_tree(tree, options, output, budget);
 }
 
-std::vector<std::vector<Frame>> parse_input_frames(std::string_view input) {
-    std::vector<std::vector<Frame>> result;
-
-    for (auto stack_range : input | std::views::split(';')) {
-        std::string_view stack_sv(stack_range.begin(), stack_range.end());
-        stack_sv = trim(stack_sv);
-        if (stack_sv.empty()) continue;
-
-        std::vector<Frame> stack_vec;
-        for (auto token_range : stack_sv | std::views::split(',')) {
-            std::string_view token_sv(token_range.begin(), token_range.end());
-            token_sv = trim(token_sv);
-            if (token_sv.empty()) continue;
-
-            // token format: function[:filename[:row[:column]]]
-            // find up to three ':' separators, but all fields except function are optional
-            auto p1 = token_sv.find(':');
-            auto p2 = (p1 != std::string_view::npos) ? token_sv.find(':', p1 + 1) : std::string_view::npos;
-            auto p3 = (p2 != std::string_view::npos) ? token_sv.find(':', p2 + 1) : std::string_view::npos;
-
-            std::string_view func_sv = (p1 == std::string_view::npos) ? token_sv : token_sv.substr(0, p1);
-            std::string_view file_sv;
-            std::string_view row_sv;
-            std::string_view col_sv;
-
-            if (p1 != std::string_view::npos && p2 == std::string_view::npos) {
-                // function:filename
-                file_sv = token_sv.substr(p1 + 1);
-            } else if (p1 != std::string_view::npos && p2 != std::string_view::npos && p3 == std::string_view::npos) {
-                // function:filename:row
-                file_sv = token_sv.substr(p1 + 1, p2 - p1 - 1);
-                row_sv  = token_sv.substr(p2 + 1);
-            } else if (p1 != std::string_view::npos && p2 != std::string_view::npos && p3 != std::string_view::npos) {
-                // function:filename:row:column
-                file_sv = token_sv.substr(p1 + 1, p2 - p1 - 1);
-                row_sv  = token_sv.substr(p2 + 1, p3 - p2 - 1);
-                col_sv  = token_sv.substr(p3 + 1);
+// Prints stacks in one of the text formats selected by the options.
+void print_input(std::string_view input, const Options& options, const Output& output) {
+    InputBudget budget;
+    if (options.addresses) {
+        // Merge first, so only the unique addresses of the tree are symbolized.
+        const auto address_tree = merge_stacks<std::uint64_t>(parse_input_addresses(input), options, budget);
+        Symbolizer symbolizer{output.symbol_modules};
+        if (!options.maps_path.empty()) {
+            std::ifstream maps{std::string(options.maps_path)};
+            if (!maps) {
+                throw std::runtime_error("Can't open maps file: '" + std::string(options.maps_path) + "'");
             }
+            symbolizer.load_proc_maps(maps);
+        }
+        print_queried_tree(symbolize_tree(address_tree, symbolizer), options, output, budget);
+        return;
+    }
 
-            func_sv = trim(func_sv);
-            file_sv = trim(file_sv);
-            row_sv  = trim(row_sv);
-            col_sv  = trim(col_sv);
+    if (options.formatted_frames) {
+        print_queried_tree(merge_stacks<Frame>(parse_input_frames(input), options, budget), options, output, budget);
+        return;
+    }
 
-            if (func_sv.empty()) {
-                throw std::runtime_error("Invalid frame token (empty func): '" + std::string(token_sv) + "'");
-            }
+    print_queried_tree(merge_stacks<std::string>(parse_input(input), options, budget), options, output, budget);
+}
 
-            int row = 0;
-            int col = 0;
-            if (!row_sv.empty()) {
-                try { row = std::stoi(std::string(row_sv)); }
-                catch (const std::exception&) { throw std::runtime_error("Invalid frame token (row not integer): '" + std::string(token_sv) + "'"); }
-            }
-            if (!col_sv.empty()) {
-                try { col = std::stoi(std::string(col_sv)); }
-                catch (const std::exception&) { throw std::runtime_error("Invalid frame token (column not integer): '" + std::string(token_sv) + "'"); }
+std::string_view output_extension(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::Svg: return ".svg";
+        case OutputFormat::Dot: return ".dot";
+        case OutputFormat::Json: return ".json";
+        case OutputFormat::JsonLines: return ".jsonl";
+    }
+    return {};
+}
+
+/*
+ * Input files of the batch mode: the files themselves and the files of directories, except
+ * outputs of previous runs.
+ */
+std::vector<std::filesystem::path> batch_inputs(std::span<char* const> paths) {
+    const auto is_output = [](const std::filesystem::path& path) {
+        const auto extension = path.extension();
+        return extension == ".svg" || extension == ".dot" || extension == ".json" || extension == ".jsonl";
+    };
+
+    std::vector<std::filesystem::path> inputs;
+    for (const std::filesystem::path path : paths) {
+        if (!std::filesystem::is_directory(path)) {
+            inputs.push_back(path);
+            continue;
+        }
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator{path}) {
+            if (entry.is_regular_file() && !is_output(entry.path())) {
+                files.push_back(entry.path());
             }
+        }
+        std::ranges::sort(files);
+        std::ranges::move(files, std::back_inserter(inputs));
+    }
+    return inputs;
+}
 
-            Frame f;
-            f.function = std::string(func_sv);
-            f.filename = std::string(file_sv);
-            f.row = row;
-            f.column = col;
+bool is_elf_file(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    char magic[4] = {};
+    return file.read(magic, sizeof(magic)) && std::string_view{magic, sizeof(magic)} == "\x7f" "ELF";
+}
+
+/**
+ * Renders each input to a file next to it, with the extension of the output format. Inputs are ELF
+ * core dumps or stacks in the text format selected by the options. They are parsed, merged and
+ * rendered to DOT on all hardware threads. Graphviz is not thread-safe, so SVG layouts share one
+ * context in turn.
+ *
+ * @return The number of inputs that failed.
+ */
+std::size_t run_batch(const std::vector<std::filesystem::path>& inputs, const Options& options) {
+    SvgRenderer svg_renderer;
+    std::mutex svg_mutex;
+    std::mutex log_mutex;
+    std::atomic<std::size_t> next_input{0};
+    std::atomic<std::size_t> failed{0};
+    // The debug information of a module is read once for all dumps.
+    const auto symbol_modules = std::make_shared<SymbolModules>(Symbolizer::default_cache_dir());
+
+    // A failed layout fails its input, so no error text is written as SVG.
+    const auto render_svg = [&](const std::string& dot) {
+        std::lock_guard lock{svg_mutex};
+        auto svg = svg_renderer.render(dot);
+        if (svg.starts_with("Error: ")) {
+            throw std::runtime_error(svg.substr(std::string_view{"Error: "}.size()));
+        }
+        return svg;
+    };
+
+    const auto worker = [&]() {
+        for (auto i = next_input++; i < inputs.size(); i = next_input++) {
+            const auto& input = inputs[i];
+            auto output_path = input;
+            output_path += output_extension(options.output_format);
+
+            std::ostringstream log;
+            try {
+                std::ofstream out{output_path, std::ios::binary};
+                if (!out) {
+                    throw std::runtime_error("Can't create output file: '" + output_path.string() + "'");
+                }
+                // The workers already use all hardware threads.
+                const Output output{out, log, render_svg, 1, symbol_modules};
+                if (is_elf_file(input)) {
+                    print_core(input, options, output);
+                } else {
+                    std::ifstream file{input, std::ios::binary};
+                    if (!file) {
+                        throw std::runtime_error("Can't open input file: '" + input.string() + "'");
+                    }
+                    const std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+                    print_input(text, options, output);
+                }
+                std::println(log, "Wrote {}", output_path.string());
+            } catch (const std::exception& ex) {
+                std::println(log, "Error: {}", ex.what());
+                std::error_code error;
+                std::filesystem::remove(output_path, error);
+                ++failed;
+            }
 
-            stack_vec.emplace_back(std::move(f));
+            std::lock_guard lock{log_mutex};
+            for (const auto line : std::views::split(std::move(log).str(), '\n')) {
+                if (!line.empty()) {
+                    std::println(std::cerr, "{}: {}", input.string(), std::string_view{line.begin(), line.end()});
+                }
+            }
         }
-        if (!stack_vec.empty()) {
-            result.push_back(std::move(stack_vec));
+    };
+
+    const auto thread_count = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), inputs.size());
+    {
+        std::vector<std::jthread> workers;
+        for (std::size_t i = 1; i < thread_count; ++i) {
+            workers.emplace_back(worker);
         }
+        worker();
     }
 
-    return result;
+    return failed;
 }
 
 } // namespace
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::println(std::cerr, "Usage: {} [-d] \"f,e,d,c,b,a; f,e,g,c,b,a\" > example.svg", argv[0]);
-        std::println(std::cerr, "Usage: {} [-d] -f \"<func,file,line,col,...;...>\" > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] \"f,e,d,c,b,a; f,e,g,c,b,a\" > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] -f \"<func,file,line,col,...;...>\" > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] -a [-m maps] \"0x4011d6,0x401200; ...\" > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] -c core > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] -i -c core > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d] -u -c core > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d] -t 500 -c core > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] [-g thread|comm] -p perf.txt > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: perf script | {} [-d|-j|-l] -p - > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] -w 3 core.1 core.2 core.3 > stuck.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] -q c \"f,e,d,c,b,a; f,e,g,c,b,a; g,b,a\" > example.svg", argv[0]);
+        std::println(std::cerr, "Usage: {} [-d|-j|-l] [-f|-a] -b dumps/ stacks.txt ...", argv[0]);
+        std::println(std::cerr, "Usage: {} -s /tmp/threads-merger.sock [-k paths] [-o snapshots/]", argv[0]);
         std::println(std::cerr, "  -d   output DOT instead of SVG");
+        std::println(std::cerr, "  -j   output the merged tree as JSON");
+        std::println(std::cerr, "  -l   output the merged tree as newline-delimited JSON, one node per line");
         std::println(std::cerr, "  -f   interpret input as formatted frames 'func:file:line:col, ...; ...'");
+        std::println(std::cerr, "  -a   interpret input as hexadecimal program counters, merged before symbolization");
+        std::println(std::cerr, "  -m   symbolize program counters with mappings from a /proc/<pid>/maps file");
+        std::println(std::cerr, "  -c   merge the stacks of all threads of an ELF core dump");
+        std::println(std::cerr, "  -p   merge the samples of 'perf script' output from a file, or '-' for stdin, while reading it");
+        std::println(std::cerr, "  -g   root the samples of -p at their thread or command");
+        std::println(std::cerr, "  -w   merge only the threads whose stacks are the same in at least this number of the last core dumps");
+        std::println(std::cerr, "  -q   keep only the stacks that contain the function, print their callers to stderr");
+        std::println(std::cerr, "  -i   merge the stacks from the innermost frames, so threads at the same frame share a root");
+        std::println(std::cerr, "  -u   render identical subtrees once, with the number of them and links from all their callers");
+        std::println(std::cerr, "  -t   merge and render each input to DOT in at most this number of milliseconds, truncating the graph");
+        std::println(std::cerr, "  -b   render core dumps and files of stacks, or all files of directories, next to them");
+        std::println(std::cerr, "  -s   run as a daemon that merges formatted frames pushed to a Unix domain socket");
+        std::println(std::cerr, "  -k   keep at most this number of the heaviest paths in the daemon, with approximate counts");
+        std::println(std::cerr, "  -o   let clients of the daemon write snapshots to files in this directory");
         return 1;
     }
 
     try {
-        bool output_dot = false;
-        bool formatted_frames = false;
+        Options options;
+        std::string_view socket_path;
+        std::size_t path_capacity = 0;
+        std::string_view snapshot_dir;
+        std::size_t stuck_snapshots = 0;
+        std::string_view core_path;
+        std::string_view perf_path;
+        bool batch = false;
         int argi = 1;
         while (argi < argc && argv[argi][0] == '-') {
             std::string_view opt(argv[argi]);
             if (opt == "-d") {
-                output_dot = true;
+                options.output_format = OutputFormat::Dot;
+            } else if (opt == "-j") {
+                options.output_format = OutputFormat::Json;
+            } else if (opt == "-l") {
+                options.output_format = OutputFormat::JsonLines;
             } else if (opt == "-f") {
-                formatted_frames = true;
+                options.formatted_frames = true;
+            } else if (opt == "-a") {
+                options.addresses = true;
+            } else if (opt == "-i") {
+                options.orientation = Orientation::CalleeRooted;
+            } else if (opt == "-u") {
+                options.shared_subtrees = true;
+            } else if (opt == "-b") {
+                batch = true;
+            } else if (opt == "-m" && argi + 1 < argc) {
+                options.maps_path = argv[++argi];
+            } else if (opt == "-q" && argi + 1 < argc) {
+                options.query = argv[++argi];
+            } else if (opt == "-c" && argi + 1 < argc) {
+                core_path = argv[++argi];
+            } else if (opt == "-p" && argi + 1 < argc) {
+                perf_path = argv[++argi];
+            } else if (opt == "-g" && argi + 1 < argc) {
+                const std::string_view value{argv[++argi]};
+                if (value == "thread") {
+                    options.perf_grouping = PerfGrouping::Thread;
+                } else if (value == "comm") {
+                    options.perf_grouping = PerfGrouping::Command;
+                } else {
+                    std::println(std::cerr, "Invalid grouping: {}", value);
+                    return 1;
+                }
+            } else if (opt == "-s" && argi + 1 < argc) {
+                socket_path = argv[++argi];
+            } else if (opt == "-o" && argi + 1 < argc) {
+                snapshot_dir = argv[++argi];
+            } else if (opt == "-k" && argi + 1 < argc) {
+                const std::string_view value{argv[++argi]};
+                const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), path_capacity);
+                if (error != std::errc{} || end != value.data() + value.size() || path_capacity == 0) {
+                    std::println(std::cerr, "Invalid number of paths: {}", value);
+                    return 1;
+                }
+            } else if (opt == "-w" && argi + 1 < argc) {
+                const std::string_view value{argv[++argi]};
+                const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), stuck_snapshots);
+                if (error != std::errc{} || end != value.data() + value.size() || stuck_snapshots < 2) {
+                    std::println(std::cerr, "Invalid number of snapshots: {}", value);
+                    return 1;
+                }
+            } else if (opt == "-t" && argi + 1 < argc) {
+                const std::string_view value{argv[++argi]};
+                std::size_t milliseconds = 0;
+                const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), milliseconds);
+                if (error != std::errc{} || end != value.data() + value.size() || milliseconds == 0) {
+                    std::println(std::cerr, "Invalid time limit: {}", value);
+                    return 1;
+                }
+                options.time_limit = std::chrono::milliseconds{milliseconds};
             } else {
                 std::println(std::cerr, "Unknown option: {}", opt);
                 return 1;
@@ -191,34 +508,63 @@ int main(int argc, char** argv) {
             ++argi;
         }
 
-        if (argi >= argc) {
-            std::println(std::cerr, "Error: missing input string. See --help.");
+        if (options.shared_subtrees && options.time_limit.count() > 0) {
+            std::println(std::cerr, "Error: -u can't be used with -t. See --help.");
+            return 1;
+        }
+        if (batch && (!core_path.empty() || !perf_path.empty() || stuck_snapshots > 0)) {
+            std::println(std::cerr, "Error: -b can't be used with -c, -p or -w. See --help.");
             return 1;
         }
 
-        std::string_view input(argv[argi]);
-        if (formatted_frames) {
-            auto lists = parse_input_frames(input);
-            const auto tree = merge<Frame>(lists);
-            const auto dot = get_dot_graph(tree);
-            if (output_dot) {
-                std::println("{}", dot);
-            } else {
-                const auto svg = dot_to_svg(dot);
-                std::println("{}", svg);
+        if (!socket_path.empty()) {
+            if (!snapshot_dir.empty() && !std::filesystem::is_directory(snapshot_dir)) {
+                std::println(std::cerr, "Error: {} is not a directory. See --help.", snapshot_dir);
+                return 1;
+            }
+            SvgRenderer svg_renderer;
+            MergerService service{[&](const std::string& dot) { return svg_renderer.render(dot); }, 0, path_capacity,
+                                  snapshot_dir};
+            return run_daemon(socket_path, service);
+        }
+
+        if (batch) {
+            const auto inputs = batch_inputs(std::span{argv + argi, argv + argc});
+            if (inputs.empty()) {
+                std::println(std::cerr, "Error: no input files. See --help.");
+                return 1;
             }
+            return run_batch(inputs, options) == 0 ? 0 : 2;
+        }
+
+        SvgRenderer svg_renderer;
+        const Output output{std::cout, std::cerr, [&](const std::string& dot) { return svg_renderer.render(dot); }};
+
+        if (stuck_snapshots > 0) {
+            if (argc - argi < static_cast<int>(stuck_snapshots)) {
+                std::println(std::cerr, "Error: fewer core dumps than snapshots. See --help.");
+                return 1;
+            }
+            print_stuck_threads(std::span{argv + argi, argv + argc}, stuck_snapshots, options, output);
+            return 0;
+        }
+
+        if (!core_path.empty()) {
+            print_core(core_path, options, output);
             return 0;
         }
 
-        auto lists = parse_input(input);
-        const auto tree = merge<std::string>(lists);
-        const auto dot = get_dot_graph(tree);
-        if (output_dot) {
-            std::println("{}", dot);
-        } else {
-            const auto svg = dot_to_svg(dot);
-            std::println("{}", svg);
+        if (!perf_path.empty()) {
+            print_perf_script(perf_path, options, output);
+            return 0;
         }
+
+        if (argi >= argc) {
+            std::println(std::cerr, "Error: missing input string. See --help.");
+            return 1;
+        }
+
+        print_input(argv[argi], options, output);
         return 0;
     } catch (const std::exception& ex) {
         std::println(std::cerr, "Error: {}", ex.what());
@@ -0,0 +1,159 @@
+#include "core_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+constexpr std::uint16_t EM_X86_64 = 62;
+constexpr std::uint16_t EM_AARCH64 = 183;
+
+constexpr std::uint32_t NT_PRSTATUS = 1;
+constexpr std::uint32_t NT_FILE = 0x46494c45;
+
+// Offsets in struct elf_prstatus, the same for x86-64 and AArch64.
+constexpr std::size_t PRSTATUS_PID = 32;
+constexpr std::size_t PRSTATUS_REGS = 112;
+
+template<typename T>
+std::optional<T> read_at(std::span<const std::byte> data, std::size_t offset) {
+    if (offset > data.size() || sizeof(T) > data.size() - offset) {
+        return std::nullopt;
+    }
+    T value{};
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+Unwind::Registers x86_64_registers(std::span<const std::byte> regs) {
+    // DWARF numbers of the fields of struct user_regs_struct, up to rsp.
+    // The fields are r15, r14, r13, r12, rbp, rbx, r11, r10, r9, r8, rax, rcx, rdx, rsi, rdi,
+    // orig_rax, rip, cs, eflags, rsp.
+    constexpr int dwarf_numbers[] = {15, 14, 13, 12, 6, 3, 11, 10, 9, 8, 0, 2, 1, 4, 5, -1, -1, -1, -1, 7};
+    constexpr std::size_t rip_index = 16;
+
+    Unwind::Registers registers;
+    for (std::size_t i = 0; i < std::size(dwarf_numbers); ++i) {
+        const auto value = read_at<std::uint64_t>(regs, i * 8);
+        if (value && dwarf_numbers[i] >= 0) {
+            registers.set(static_cast<std::uint32_t>(dwarf_numbers[i]), *value);
+        }
+    }
+    registers.pc = read_at<std::uint64_t>(regs, rip_index * 8).value_or(0);
+    return registers;
+}
+
+Unwind::Registers aarch64_registers(std::span<const std::byte> regs) {
+    // struct user_pt_regs: x0–x30, sp, pc. The DWARF numbers are the same up to sp.
+    constexpr std::size_t pc_index = 32;
+
+    Unwind::Registers registers;
+    for (std::uint32_t i = 0; i < pc_index; ++i) {
+        if (const auto value = read_at<std::uint64_t>(regs, i * 8)) {
+            registers.set(i, *value);
+        }
+    }
+    registers.pc = read_at<std::uint64_t>(regs, pc_index * 8).value_or(0);
+    return registers;
+}
+
+std::vector<ModuleMapping> parse_file_note(std::span<const std::byte> desc) {
+    // Format: count, page size, count × (start, end, offset in pages), count × file name.
+    std::vector<ModuleMapping> mappings;
+    const auto count = read_at<std::uint64_t>(desc, 0);
+    const auto page_size = read_at<std::uint64_t>(desc, 8);
+    if (!count || !page_size || *count > desc.size() / 24) {
+        return mappings;
+    }
+
+    std::size_t names_offset = 16 + *count * 24;
+    for (std::uint64_t i = 0; i < *count; ++i) {
+        const auto entry = 16 + i * 24;
+        ModuleMapping mapping;
+        mapping.start = read_at<std::uint64_t>(desc, entry).value_or(0);
+        mapping.end = read_at<std::uint64_t>(desc, entry + 8).value_or(0);
+        mapping.offset = read_at<std::uint64_t>(desc, entry + 16).value_or(0) * *page_size;
+
+        if (names_offset >= desc.size()) {
+            break;
+        }
+        const std::string_view names{reinterpret_cast<const char*>(desc.data()) + names_offset, desc.size() - names_offset};
+        const auto name = names.substr(0, names.find('\0'));
+        names_offset += name.size() + 1;
+
+        mapping.path = name;
+        mappings.push_back(std::move(mapping));
+    }
+    return mappings;
+}
+
+} // namespace
+
+CoreFile::CoreFile(const std::filesystem::path& path)
+    : elf_(path)
+{
+    const auto& header = elf_.header();
+    if (header.type != Elf::ET_CORE) {
+        throw std::runtime_error(std::format("Not a core dump: '{}'", path.string()));
+    }
+    if (header.machine == EM_X86_64) {
+        architecture_ = Unwind::Architecture::X86_64;
+    } else if (header.machine == EM_AARCH64) {
+        architecture_ = Unwind::Architecture::AArch64;
+    } else {
+        throw std::runtime_error(std::format("Unsupported architecture of the core dump: {}", header.machine));
+    }
+
+    for (const auto& note : elf_.notes()) {
+        if (note.name != "CORE") {
+            continue;
+        }
+        if (note.type == NT_PRSTATUS && note.desc.size() > PRSTATUS_REGS) {
+            Thread thread;
+            thread.tid = read_at<std::int32_t>(note.desc, PRSTATUS_PID).value_or(0);
+            const auto regs = note.desc.subspan(PRSTATUS_REGS);
+            thread.registers = architecture_ == Unwind::Architecture::X86_64
+                ? x86_64_registers(regs)
+                : aarch64_registers(regs);
+            threads_.push_back(thread);
+        } else if (note.type == NT_FILE) {
+            mappings_ = parse_file_note(note.desc);
+        }
+    }
+
+    for (const auto& segment : elf_.program_headers()) {
+        if (segment.type == Elf::PT_LOAD && segment.filesz > 0) {
+            segments_.push_back(segment);
+        }
+    }
+    std::ranges::sort(segments_, {}, &Elf::ProgramHeader::vaddr);
+}
+
+std::optional<std::uint64_t> CoreFile::read_u64(std::uint64_t address) const {
+    auto segment = std::ranges::upper_bound(segments_, address, {}, &Elf::ProgramHeader::vaddr);
+    if (segment == segments_.begin()) {
+        return std::nullopt;
+    }
+    --segment;
+
+    // Only the dumped part of a segment is readable.
+    const auto offset = address - segment->vaddr;
+    if (offset >= segment->filesz || sizeof(std::uint64_t) > segment->filesz - offset) {
+        return std::nullopt;
+    }
+    const auto bytes = elf_.data(segment->offset + offset, sizeof(std::uint64_t));
+    return read_at<std::uint64_t>(bytes, 0);
+}
+
+std::vector<std::vector<std::uint64_t>> CoreFile::stacks(std::size_t max_frames) const {
+    Unwind::Unwinder unwinder{architecture_, *this, mappings_};
+    std::vector<std::vector<std::uint64_t>> result;
+    result.reserve(threads_.size());
+    for (const auto& thread : threads_) {
+        result.push_back(unwinder.unwind(thread.registers, max_frames));
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "symbolizer.hpp"
+#include "symbolizer/elf_file.hpp"
+#include "unwinder/unwinder.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+/* ELF core dump of a Linux process (x86-64 or AArch64).
+ *
+ * Threads and their registers are read from the NT_PRSTATUS notes, the mapped files from the
+ * NT_FILE note, the memory from the PT_LOAD segments. The core file is mapped, not read.
+ *
+ */
+
+class CoreFile : public Unwind::Memory
+{
+public:
+    struct Thread
+    {
+        int tid = 0;
+        Unwind::Registers registers;
+    };
+
+    // Throws std::runtime_error if the file is not a core dump of a supported architecture.
+    explicit CoreFile(const std::filesystem::path& path);
+
+    Unwind::Architecture architecture() const { return architecture_; }
+    const std::vector<Thread>& threads() const { return threads_; }
+    const std::vector<ModuleMapping>& mappings() const { return mappings_; }
+
+    std::optional<std::uint64_t> read_u64(std::uint64_t address) const override;
+
+    /**
+     * Unwinds all threads. The modules are read from the paths recorded in the core dump.
+     * @return Stacks of program counters from the innermost frame, ready for merge<std::uint64_t>().
+     */
+    std::vector<std::vector<std::uint64_t>> stacks(std::size_t max_frames = 256) const;
+
+private:
+    Elf::File elf_;
+    Unwind::Architecture architecture_ = Unwind::Architecture::X86_64;
+    std::vector<Thread> threads_;
+    std::vector<ModuleMapping> mappings_;
+    // PT_LOAD segments sorted by address.
+    std::vector<Elf::ProgramHeader> segments_;
+};
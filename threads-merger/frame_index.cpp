@@ -0,0 +1,20 @@
+#include "frame_index.hpp"
+
+
+template<>
+std::string FrameKey<int>::of(const int& item)
+{
+    return std::to_string(item);
+}
+
+template<>
+std::string FrameKey<std::string>::of(const std::string& item)
+{
+    return item;
+}
+
+template<>
+std::string FrameKey<Frame>::of(const Frame& frame)
+{
+    return frame.function;
+}
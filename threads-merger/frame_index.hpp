@@ -0,0 +1,275 @@
+#ifndef FRAME_INDEX_HPP
+#define FRAME_INDEX_HPP
+
+#include "merger.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+#include <stack>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Inverted index of a merged tree: for each function, the nodes of the tree where it occurs.
+ *
+ * The index is built with one traversal of the tree. A query touches only the nodes of the
+ * function and their ancestors, so it does not depend on the size of the whole tree.
+ *
+ * A function occurs several times on one path in case of indirect recursion. Only the outermost
+ * occurrences are counted, so a stack is counted once.
+ */
+
+// Name of a frame in the index.
+template<typename T>
+struct FrameKey {
+    static std::string of(const T& item);
+};
+
+struct StringKeyHash {
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view key) const noexcept {
+        return std::hash<std::string_view>{}(key);
+    }
+};
+
+/**
+ * The tree must outlive the index and must not be changed while the index is used.
+ */
+template<typename T>
+class FrameIndex
+{
+public:
+    explicit FrameIndex(const Node<T>& root, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+    // Number of stacks that contain the function.
+    std::size_t count(std::string_view function) const;
+
+    // Subtrees of the outermost occurrences of the function.
+    std::vector<const NodeMapValue<T>*> subtrees(std::string_view function) const;
+
+    /**
+     * Callers of the outermost occurrences of the function with the number of stacks,
+     * sorted by the number of stacks in descending order.
+     * The caller is empty for the functions at the bottom of stacks.
+     */
+    std::vector<std::pair<std::string, std::size_t>> callers(std::string_view function) const;
+
+    /**
+     * A tree of only the stacks that contain the function, ready for get_dot_graph().
+     * Subtrees of the function are copied entirely, their ancestors get the number of the
+     * matched stacks below them.
+     * @param resource Memory resource for all nodes of the filtered tree.
+     */
+    Node<T> filter(std::string_view function, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+private:
+    static constexpr std::size_t no_parent = static_cast<std::size_t>(-1);
+
+    struct Entry {
+        const NodeMapValue<T>* node = nullptr;
+        std::size_t parent = no_parent;
+        std::size_t key = 0;
+        // There is no ancestor of the same function.
+        bool outermost = true;
+    };
+
+    struct Postings {
+        std::string function;
+        std::vector<std::size_t> entries;
+        std::size_t count = 0;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<Postings> postings_;
+    std::unordered_map<std::string, std::size_t, StringKeyHash, std::equal_to<>> keys_;
+
+    const Postings* find(std::string_view function) const;
+};
+
+
+template<typename T>
+FrameIndex<T>::FrameIndex(const Node<T>& root, std::pmr::memory_resource* scratch)
+{
+    struct Item {
+        const NodeMapValue<T>* node;
+        std::size_t parent;
+        std::size_t depth;
+    };
+
+    auto nodes_stack = make_scratch_stack<Item>(scratch);
+    for (const auto& next_node: root.next_nodes) {
+        nodes_stack.push({&next_node, no_parent, 0});
+    }
+
+    // Entries of the current path and the number of occurrences of each key on it.
+    std::pmr::vector<std::size_t> path{scratch};
+    std::pmr::vector<std::size_t> on_path{scratch};
+
+    while (!nodes_stack.empty()) {
+        const auto item = nodes_stack.top();
+        nodes_stack.pop();
+
+        while (path.size() > item.depth) {
+            --on_path[entries_[path.back()].key];
+            path.pop_back();
+        }
+
+        auto [it, inserted] = keys_.try_emplace(FrameKey<T>::of(item.node->first), postings_.size());
+        if (inserted) {
+            postings_.emplace_back().function = it->first;
+            on_path.push_back(0);
+        }
+        const auto key = it->second;
+
+        const auto entry = entries_.size();
+        entries_.push_back(Entry{item.node, item.parent, key, on_path[key] == 0});
+
+        auto& postings = postings_[key];
+        postings.entries.push_back(entry);
+        if (on_path[key] == 0) {
+            postings.count += item.node->second.count;
+        }
+
+        ++on_path[key];
+        path.push_back(entry);
+
+        for (const auto& next_node: item.node->second.next_nodes) {
+            nodes_stack.push({&next_node, entry, item.depth + 1});
+        }
+    }
+}
+
+template<typename T>
+const typename FrameIndex<T>::Postings* FrameIndex<T>::find(std::string_view function) const
+{
+    const auto it = keys_.find(function);
+    return it == keys_.end() ? nullptr : &postings_[it->second];
+}
+
+template<typename T>
+std::size_t FrameIndex<T>::count(std::string_view function) const
+{
+    const auto* postings = find(function);
+    return postings ? postings->count : 0;
+}
+
+template<typename T>
+std::vector<const NodeMapValue<T>*> FrameIndex<T>::subtrees(std::string_view function) const
+{
+    std::vector<const NodeMapValue<T>*> result;
+    if (const auto* postings = find(function)) {
+        for (const auto entry : postings->entries) {
+            if (entries_[entry].outermost) {
+                result.push_back(entries_[entry].node);
+            }
+        }
+    }
+    return result;
+}
+
+template<typename T>
+std::vector<std::pair<std::string, std::size_t>> FrameIndex<T>::callers(std::string_view function) const
+{
+    std::unordered_map<std::string_view, std::size_t> counts;
+    if (const auto* postings = find(function)) {
+        for (const auto entry : postings->entries) {
+            const auto& occurrence = entries_[entry];
+            if (!occurrence.outermost) {
+                continue;
+            }
+            const std::string_view caller = occurrence.parent == no_parent
+                ? std::string_view{}
+                : postings_[entries_[occurrence.parent].key].function;
+            counts[caller] += occurrence.node->second.count;
+        }
+    }
+
+    std::vector<std::pair<std::string, std::size_t>> result{counts.begin(), counts.end()};
+    std::ranges::sort(result, [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return result;
+}
+
+template<typename T>
+Node<T> FrameIndex<T>::filter(std::string_view function, std::pmr::memory_resource* resource) const
+{
+    Node<T> root{.next_nodes = NodeMap<T>(resource)};
+
+    const auto* postings = find(function);
+    if (!postings) {
+        return root;
+    }
+
+    std::vector<std::size_t> path;
+    std::stack<std::pair<const Node<T>*, Node<T>*>> copies;
+    for (const auto entry : postings->entries) {
+        const auto& occurrence = entries_[entry];
+        if (!occurrence.outermost) {
+            continue;
+        }
+        const auto count = occurrence.node->second.count;
+        root.count += count;
+
+        path.clear();
+        for (auto ancestor = occurrence.parent; ancestor != no_parent; ancestor = entries_[ancestor].parent) {
+            path.push_back(ancestor);
+        }
+
+        Node<T>* current = &root;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            const auto& [value, source] = *entries_[*it].node;
+            auto& node = child_node(*current, value);
+            node.count += count;
+            node.level = source.level;
+            node.collapsed = source.collapsed;
+            current = &node;
+        }
+
+        // Outermost occurrences never contain each other, so each subtree is copied once.
+        // It is copied node by node, so the copy is allocated from the resource too.
+        copies.push({&occurrence.node->second, &child_node(*current, occurrence.node->first)});
+        while (!copies.empty()) {
+            const auto [source, target] = copies.top();
+            copies.pop();
+
+            target->count = source->count;
+            target->level = source->level;
+            target->collapsed = source->collapsed;
+            for (const auto& [value, next_node] : source->next_nodes) {
+                copies.push({&next_node, &child_node(*target, value)});
+            }
+        }
+    }
+
+    return root;
+}
+
+/**
+ * A merged tree that owns its index.
+ */
+template<typename T>
+class IndexedTree
+{
+public:
+    explicit IndexedTree(const std::vector<std::vector<T>>& lists)
+        : tree_{merge(lists)}
+        , index_{tree_}
+    {}
+
+    IndexedTree(const IndexedTree&) = delete;
+    IndexedTree& operator=(const IndexedTree&) = delete;
+
+    const Node<T>& tree() const { return tree_; }
+    const FrameIndex<T>& index() const { return index_; }
+
+private:
+    Node<T> tree_;
+    FrameIndex<T> index_;
+};
+
+#endif // FRAME_INDEX_HPP
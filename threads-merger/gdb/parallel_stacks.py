@@ -0,0 +1,72 @@
+"""
+The 'parallel-stacks' GDB command. It merges the stacks of all threads of the inferior with the
+threads_merger module, which is built next to this file:
+
+    (gdb) source build/Release/parallel_stacks.py
+    (gdb) parallel-stacks -o stacks.svg
+"""
+
+import argparse
+import os
+import sys
+
+import gdb
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import threads_merger
+
+
+class ArgumentError(Exception):
+    pass
+
+
+class ArgumentParser(argparse.ArgumentParser):
+    # argparse exits the process on errors, GDB has to stay.
+    def error(self, message):
+        raise ArgumentError(message)
+
+
+class ParallelStacks(gdb.Command):
+    """Merge the stacks of all threads of the inferior into a graph.
+
+Usage: parallel-stacks [-d | -j] [-i] [-l DEPTH] [-o FILE]
+
+  -d  write DOT instead of SVG
+  -j  write the merged tree as JSON
+  -i  merge the stacks from the innermost frames, so threads at the same frame share a root
+  -l  maximum depth to merge from each stack, 0 means no limit
+  -o  output file, parallel-stacks.svg (.dot, .json) by default"""
+
+    def __init__(self):
+        super().__init__('parallel-stacks', gdb.COMMAND_STACK)
+        self.parser = ArgumentParser(prog='parallel-stacks', add_help=False)
+        output_format = self.parser.add_mutually_exclusive_group()
+        output_format.add_argument('-d', dest='format', action='store_const', const='dot', default='svg')
+        output_format.add_argument('-j', dest='format', action='store_const', const='json')
+        self.parser.add_argument('-i', dest='callee_rooted', action='store_true')
+        self.parser.add_argument('-l', dest='depth_limit', type=int, default=0)
+        self.parser.add_argument('-o', dest='output')
+
+    def invoke(self, argument, from_tty):
+        try:
+            args = self.parser.parse_args(gdb.string_to_argv(argument))
+        except ArgumentError as error:
+            raise gdb.GdbError('parallel-stacks: {}'.format(error))
+
+        inferior = gdb.selected_inferior()
+        if not inferior.pid:
+            raise gdb.GdbError('parallel-stacks: the program is not being run.')
+
+        try:
+            graph = threads_merger.merge_threads(inferior, args.format, args.depth_limit, args.callee_rooted)
+        except (RuntimeError, ValueError) as error:
+            raise gdb.GdbError('parallel-stacks: {}'.format(error))
+
+        output = args.output or 'parallel-stacks.{}'.format(args.format)
+        with open(output, 'w', encoding='utf-8') as file:
+            file.write(graph)
+        print('Stacks of {} threads are merged into {}'.format(len(inferior.threads()), output))
+
+
+ParallelStacks()
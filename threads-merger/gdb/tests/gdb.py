@@ -0,0 +1,68 @@
+"""
+A stand-in for the 'gdb' module of GDB with the part of its API that threads_merger uses, so the
+module is tested without a debugger. Threads are lists of function names from the innermost frame.
+"""
+
+
+class error(RuntimeError):
+    pass
+
+
+_selected_thread = None
+
+
+class Symtab_and_line:
+    def __init__(self):
+        self.symtab = None
+        self.line = 0
+
+
+class Frame:
+    def __init__(self, thread, index):
+        self._thread = thread
+        self._index = index
+
+    def name(self):
+        return self._thread.functions[self._index]
+
+    def pc(self):
+        return 0x1000 + self._index
+
+    def find_sal(self):
+        return Symtab_and_line()
+
+    def older(self):
+        index = self._index + 1
+        if index == self._thread.unreadable_frame:
+            raise error("Cannot access memory at address 0x0")
+        return Frame(self._thread, index) if index < len(self._thread.functions) else None
+
+
+class InferiorThread:
+    def __init__(self, functions, unreadable_frame=None, exited=False):
+        self.functions = functions
+        # Index of the frame whose older() raises gdb.error, like a corrupted stack.
+        self.unreadable_frame = unreadable_frame
+        self.exited = exited
+
+    def switch(self):
+        global _selected_thread
+        if self.exited:
+            raise error("Thread ID 1 has terminated.")
+        _selected_thread = self
+
+
+class Inferior:
+    def __init__(self, threads):
+        self._threads = threads
+
+    def threads(self):
+        return self._threads
+
+
+def selected_thread():
+    return _selected_thread
+
+
+def newest_frame():
+    return Frame(_selected_thread, 0)
@@ -0,0 +1,63 @@
+"""
+Tests of the threads_merger module with the stand-in gdb module next to this file:
+
+    PYTHONPATH=gdb/tests:build/Release python3 gdb/tests/test_threads_merger.py
+"""
+
+import json
+import unittest
+
+import gdb
+import threads_merger
+
+
+def paths(tree, path=()):
+    """Counts of the paths of a merged JSON tree by their function names from the root."""
+    result = {}
+    for child in tree["children"]:
+        child_path = path + (child["frame"]["function"],)
+        result[child_path] = child["count"]
+        result.update(paths(child, child_path))
+    return result
+
+
+def merge(threads):
+    return json.loads(threads_merger.merge_threads(gdb.Inferior(threads), format="json"))
+
+
+class MergeThreadsTest(unittest.TestCase):
+    def setUp(self):
+        self.selected = gdb.InferiorThread(["main"])
+        self.selected.switch()
+
+    def test_merges_all_threads(self):
+        tree = merge([gdb.InferiorThread(["c", "b", "a"]), gdb.InferiorThread(["e", "a"])])
+        self.assertEqual(2, tree["count"])
+        self.assertEqual({("a",): 2, ("a", "b"): 1, ("a", "b", "c"): 1, ("a", "e"): 1}, paths(tree))
+        self.assertIs(self.selected, gdb.selected_thread())
+
+    def test_unreadable_frame_ends_the_stack(self):
+        # The frames up to the error are kept.
+        tree = merge([gdb.InferiorThread(["d", "b", "a"], unreadable_frame=2), gdb.InferiorThread(["e", "a"])])
+        self.assertEqual({("b",): 1, ("b", "d"): 1, ("a",): 1, ("a", "e"): 1}, paths(tree))
+        self.assertIs(self.selected, gdb.selected_thread())
+
+    def test_exited_thread_is_skipped(self):
+        tree = merge([gdb.InferiorThread(["x"], exited=True), gdb.InferiorThread(["e", "a"])])
+        self.assertEqual(1, tree["count"])
+        self.assertEqual({("a",): 1, ("a", "e"): 1}, paths(tree))
+        self.assertIs(self.selected, gdb.selected_thread())
+
+    def test_other_errors_propagate(self):
+        class BrokenThread(gdb.InferiorThread):
+            def switch(self):
+                super().switch()
+                raise KeyError("broken")
+
+        with self.assertRaises(KeyError):
+            merge([gdb.InferiorThread(["e", "a"]), BrokenThread(["c", "b", "a"])])
+        self.assertIs(self.selected, gdb.selected_thread())
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,243 @@
+#ifndef HEAVY_PATHS_HPP
+#define HEAVY_PATHS_HPP
+
+#include "merger.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Approximate merged tree of an unbounded stream of stacks in a fixed number of paths.
+ *
+ * Paths from the root, the nodes of a merged tree, are counted with the Space-Saving algorithm.
+ * When all paths are taken, a new path replaces the leaf path with the smallest count and takes
+ * over its count. The count of a path is then an upper bound of its number of stacks, which is
+ * overestimated by at most max_error(). Paths with more stacks than max_error() are never lost.
+ *
+ * Only leaf paths are replaced, so the tracked paths always form a tree, and the count of a path
+ * is never less than the counts of its children.
+ */
+template<typename T>
+class HeavyPaths
+{
+public:
+    /**
+     * @param capacity Maximum number of tracked paths.
+     * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+     */
+    explicit HeavyPaths(
+        std::size_t capacity,
+        std::size_t depth_limit = 0,
+        Orientation orientation = Orientation::CallerRooted);
+
+    // Stacks are counted as add_stack() for Node<T> counts them.
+    void add_stack(const std::vector<T>& list, std::size_t weight = 1);
+
+    void clear();
+
+    // Number of stacks added since the start or the last clear().
+    std::size_t total() const { return total_; }
+    std::size_t size() const { return entries_.size(); }
+    std::size_t capacity() const { return capacity_; }
+
+    // Maximum overestimation of the count of a path.
+    std::size_t max_error() const { return max_error_; }
+
+    /**
+     * A tree of the k paths with the largest counts, or of all tracked paths if k is 0.
+     * The tree is not collapsed. The root has the number of all stacks.
+     * @param resource Memory resource for all nodes of the tree.
+     */
+    Node<T> tree(std::size_t k = 0, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+private:
+    static constexpr std::uint32_t no_entry = std::numeric_limits<std::uint32_t>::max();
+
+    struct Entry {
+        T frame;
+        std::uint32_t parent = no_entry;
+        std::uint32_t children = 0;
+        std::size_t level = 0;
+        std::size_t count = 0;
+    };
+
+    // A frame under a parent path. Keys of the index point to the frames of the entries.
+    struct Key {
+        std::uint32_t parent;
+        const T* frame;
+
+        bool operator==(const Key& other) const { return parent == other.parent && *frame == *other.frame; }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept {
+            std::size_t seed = key.parent;
+            std::hash_combine(seed, std::hash<T>{}(*key.frame));
+            return seed;
+        }
+    };
+
+    std::size_t capacity_;
+    std::size_t depth_limit_;
+    Orientation orientation_;
+    std::size_t total_ = 0;
+    std::size_t max_error_ = 0;
+
+    // Storage for all paths is reserved up front, so the frames don't move.
+    std::vector<Entry> entries_;
+    std::unordered_map<Key, std::uint32_t, KeyHash> index_;
+    // Paths without children by their counts; candidates for replacement.
+    std::set<std::pair<std::size_t, std::uint32_t>> leaves_;
+
+    std::uint32_t insert(std::uint32_t parent, std::size_t parent_count, const T& frame, std::size_t level, std::size_t weight);
+};
+
+
+template<typename T>
+HeavyPaths<T>::HeavyPaths(std::size_t capacity, std::size_t depth_limit, Orientation orientation)
+    : capacity_(std::min<std::size_t>(capacity, no_entry)), depth_limit_(depth_limit), orientation_(orientation)
+{
+    entries_.reserve(capacity_);
+    index_.reserve(capacity_);
+}
+
+template<typename T>
+void HeavyPaths<T>::clear()
+{
+    total_ = 0;
+    max_error_ = 0;
+    index_.clear();
+    leaves_.clear();
+    entries_.clear();
+}
+
+template<typename T>
+void HeavyPaths<T>::add_stack(const std::vector<T>& list, std::size_t weight)
+{
+    if (list.empty() || weight == 0) return;
+
+    total_ += weight;
+
+    auto parent = no_entry;
+    auto parent_count = total_;
+
+    const auto depth = merged_depth(list.size(), depth_limit_);
+    for (std::size_t i = 0; i < depth; i++) {
+        const auto& frame = merged_frame(list, i, orientation_);
+
+        auto id = no_entry;
+        if (const auto it = index_.find(Key{parent, &frame}); it != index_.end()) {
+            id = it->second;
+            auto& entry = entries_[id];
+            if (entry.children == 0) {
+                leaves_.erase({entry.count, id});
+                leaves_.emplace(entry.count + weight, id);
+            }
+            entry.count += weight;
+        } else {
+            id = insert(parent, parent_count, frame, i + 1, weight);
+            if (id == no_entry) {
+                // All paths are on this stack, its rest isn't tracked.
+                return;
+            }
+        }
+
+        parent = id;
+        parent_count = entries_[id].count;
+    }
+}
+
+template<typename T>
+std::uint32_t HeavyPaths<T>::insert(
+    std::uint32_t parent,
+    std::size_t parent_count,
+    const T& frame,
+    std::size_t level,
+    std::size_t weight)
+{
+    // The parent gets a child, so it can't be replaced.
+    const bool parent_was_leaf = parent != no_entry && entries_[parent].children == 0;
+    if (parent_was_leaf) {
+        leaves_.erase({entries_[parent].count, parent});
+    }
+
+    std::size_t replaced_count = 0;
+    std::uint32_t id = 0;
+    if (entries_.size() < capacity_) {
+        id = static_cast<std::uint32_t>(entries_.size());
+        entries_.push_back(Entry{.frame = frame});
+    } else {
+        if (leaves_.empty()) {
+            if (parent_was_leaf) {
+                leaves_.emplace(entries_[parent].count, parent);
+            }
+            return no_entry;
+        }
+
+        std::tie(replaced_count, id) = *leaves_.begin();
+        leaves_.erase(leaves_.begin());
+
+        auto& replaced = entries_[id];
+        index_.erase(Key{replaced.parent, &replaced.frame});
+        if (replaced.parent != no_entry && --entries_[replaced.parent].children == 0 && replaced.parent != parent) {
+            leaves_.emplace(entries_[replaced.parent].count, replaced.parent);
+        }
+        replaced.frame = frame;
+    }
+
+    // The path could have been counted in the replaced one, but not in more stacks than its parent.
+    auto& entry = entries_[id];
+    entry.parent = parent;
+    entry.children = 0;
+    entry.level = level;
+    entry.count = std::min(replaced_count + weight, parent_count);
+    max_error_ = std::max(max_error_, entry.count - weight);
+
+    index_.emplace(Key{parent, &entry.frame}, id);
+    leaves_.emplace(entry.count, id);
+    if (parent != no_entry) {
+        ++entries_[parent].children;
+    }
+    return id;
+}
+
+template<typename T>
+Node<T> HeavyPaths<T>::tree(std::size_t k, std::pmr::memory_resource* resource) const
+{
+    std::vector<std::uint32_t> selected(entries_.size());
+    std::iota(selected.begin(), selected.end(), 0);
+
+    // Parents have at least the counts of their children and go first on ties,
+    // so the selected paths are a tree.
+    const auto heavier = [&](std::uint32_t a, std::uint32_t b) {
+        const auto& lhs = entries_[a];
+        const auto& rhs = entries_[b];
+        return lhs.count != rhs.count ? lhs.count > rhs.count : lhs.level < rhs.level;
+    };
+    if (k > 0 && k < selected.size()) {
+        std::ranges::partial_sort(selected, selected.begin() + static_cast<std::ptrdiff_t>(k), heavier);
+        selected.resize(k);
+    }
+    std::ranges::sort(selected, {}, [&](std::uint32_t id) { return entries_[id].level; });
+
+    Node<T> root{.count = total_, .next_nodes = NodeMap<T>(resource)};
+    std::vector<Node<T>*> nodes(entries_.size(), nullptr);
+    for (const auto id : selected) {
+        const auto& entry = entries_[id];
+        auto& node = child_node(entry.parent == no_entry ? root : *nodes[entry.parent], entry.frame);
+        node.count = entry.count;
+        node.level = entry.level;
+        nodes[id] = &node;
+    }
+    return root;
+}
+
+#endif // HEAVY_PATHS_HPP
@@ -26,8 +26,8 @@ namespace Html {
 TableCell::TableCell(std::string content, std::size_t colspan)
     : content_(std::move(content)), colspan_(colspan) {}
 
-void TableCell::render(std::ostringstream& ss, std::string_view sides) const {
-    ss << "        <td";
+void TableCell::render(std::ostringstream& ss, std::string_view sides, bool compact) const {
+    ss << (compact ? "<td" : "        <td");
     if (colspan_ > 1) {
         ss << " COLSPAN=\"" << colspan_ << "\"";
     }
@@ -41,6 +41,10 @@ void TableCell::render(std::ostringstream& ss, std::string_view sides) const {
         ss << "\"";
     }
     ss << ">";
+    if (compact) {
+        ss << escape_html(content_) << "</td>";
+        return;
+    }
     ss << "<FONT POINT-SIZE=\"40\">";
     ss << escape_html(content_);
     ss << "</FONT>";
@@ -55,8 +59,8 @@ void TableRow::add_cell(const TableCell& cell) {
     cells_.push_back(cell);
 }
 
-void TableRow::render(std::ostringstream& ss, std::size_t row_index) const {
-    ss << "      <tr>\n";
+void TableRow::render(std::ostringstream& ss, std::size_t row_index, bool compact) const {
+    ss << (compact ? "<tr>" : "      <tr>\n");
     std::size_t column_index = 0;
     for (const auto& cell : cells_) {
         std::string sides;
@@ -66,22 +70,27 @@ void TableRow::render(std::ostringstream& ss, std::size_t row_index) const {
         if (row_index > 0) {
             sides.push_back('T');
         }
-        cell.render(ss, sides);
+        cell.render(ss, sides, compact);
         column_index += cell.colspan();
     }
-    ss << "      </tr>\n";
+    ss << (compact ? "</tr>" : "      </tr>\n");
 }
 
 void Table::add_row(const TableRow& row) {
     rows_.push_back(row);
 }
 
-void Table::render(std::ostringstream& ss) const {
-    ss << "    <table BORDER=\"1\" CELLBORDER=\"1\" CELLPADDING=\"10\" CELLSPACING=\"0\" STYLE=\"ROUNDED\">\n";
+void Table::render(std::ostringstream& ss, bool compact) const {
+    if (compact) {
+        // BORDER is 1 by default and CELLBORDER is BORDER by default.
+        ss << "<table CELLPADDING=\"10\" CELLSPACING=\"0\" STYLE=\"ROUNDED\">";
+    } else {
+        ss << "    <table BORDER=\"1\" CELLBORDER=\"1\" CELLPADDING=\"10\" CELLSPACING=\"0\" STYLE=\"ROUNDED\">\n";
+    }
     for (std::size_t row_index = 0; row_index < rows_.size(); ++row_index) {
-        rows_[row_index].render(ss, row_index);
+        rows_[row_index].render(ss, row_index, compact);
     }
-    ss << "    </table>\n";
+    ss << (compact ? "</table>" : "    </table>\n");
 }
 
 } // namespace Html
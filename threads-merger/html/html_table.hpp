@@ -23,7 +23,7 @@ private:
     std::string content_;
     std::size_t colspan_;
 
-    void render(std::ostringstream& ss, std::string_view sides) const;
+    void render(std::ostringstream& ss, std::string_view sides, bool compact) const;
     std::size_t colspan() const;
 };
 
@@ -36,13 +36,18 @@ public:
 private:
     std::vector<TableCell> cells_;
 
-    void render(std::ostringstream& ss, std::size_t row_index) const;
+    void render(std::ostringstream& ss, std::size_t row_index, bool compact) const;
 };
 
 class Table {
 public:
     void add_row(const TableRow& row);
-    void render(std::ostringstream& ss) const;
+
+    /**
+     * A compact table has no indentation, no attributes with default values and no font of cells,
+     * it looks the same in a node with fontsize=40.
+     */
+    void render(std::ostringstream& ss, bool compact = false) const;
 
 private:
     std::vector<TableRow> rows_;
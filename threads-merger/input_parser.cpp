@@ -0,0 +1,222 @@
+#include "input_parser.hpp"
+
+#include <array>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <span>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+std::string_view ltrim(std::string_view sv) {
+    size_t i = 0;
+    while (i < sv.size() && std::isspace(static_cast<unsigned char>(sv[i]))) ++i;
+    return sv.substr(i);
+}
+
+std::string_view rtrim(std::string_view sv) {
+    size_t i = sv.size();
+    while (i > 0 && std::isspace(static_cast<unsigned char>(sv[i - 1]))) --i;
+    return sv.substr(0, i);
+}
+
+std::string_view trim(std::string_view sv) {
+    return rtrim(ltrim(sv));
+}
+
+template<typename Int>
+bool parse_int(std::string_view text, Int& value, int base = 10) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return error == std::errc{} && end == text.data() + text.size();
+}
+
+/*
+ * Parses a decimal number at the start of the text like std::stoi(): after whitespace and an
+ * optional sign, the digits are read up to the first other character, which ends the number.
+ */
+bool parse_leading_int(std::string_view text, int& value) {
+    text = ltrim(text);
+    if (text.starts_with('+') && !text.substr(1).starts_with('-')) {
+        text.remove_prefix(1);
+    }
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{};
+}
+
+/*
+ * Finds the separators of the input in one pass. Bytes are compared 64 at a time with SSE2 or AVX2
+ * when the compiler targets them, the bits of the found separators are then taken one by one.
+ */
+class SeparatorScanner
+{
+public:
+    // Colons separate the fields of frames. They are only found if requested.
+    SeparatorScanner(std::string_view input, bool colons)
+        : input_(input), colon_(colons ? ':' : ';') {}
+
+    // Position of the next separator, or the size of the input after the last one.
+    std::size_t next() {
+        while (mask_ == 0) {
+            if (block_ >= input_.size()) {
+                return input_.size();
+            }
+            mask_ = input_.size() - block_ >= block_size ? block_mask(input_.data() + block_) : tail_mask();
+            block_ += block_size;
+        }
+        const auto position = block_ - block_size + std::countr_zero(mask_);
+        mask_ &= mask_ - 1;
+        return position;
+    }
+
+private:
+    static constexpr std::size_t block_size = 64;
+
+    std::string_view input_;
+    char colon_;
+    std::size_t block_ = 0;
+    // Separators of the block before block_, one bit per byte.
+    std::uint64_t mask_ = 0;
+
+    bool is_separator(char c) const {
+        return c == ';' || c == ',' || c == colon_;
+    }
+
+    std::uint64_t block_mask(const char* block) const {
+        std::uint64_t mask = 0;
+#if defined(__AVX2__)
+        const auto semicolons = _mm256_set1_epi8(';');
+        const auto commas = _mm256_set1_epi8(',');
+        const auto colons = _mm256_set1_epi8(colon_);
+        for (std::size_t i = 0; i < block_size; i += 32) {
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+            const auto found = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, semicolons), _mm256_cmpeq_epi8(bytes, commas)),
+                _mm256_cmpeq_epi8(bytes, colons));
+            mask |= std::uint64_t{static_cast<std::uint32_t>(_mm256_movemask_epi8(found))} << i;
+        }
+#elif defined(__SSE2__)
+        const auto semicolons = _mm_set1_epi8(';');
+        const auto commas = _mm_set1_epi8(',');
+        const auto colons = _mm_set1_epi8(colon_);
+        for (std::size_t i = 0; i < block_size; i += 16) {
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+            const auto found = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, semicolons), _mm_cmpeq_epi8(bytes, commas)),
+                _mm_cmpeq_epi8(bytes, colons));
+            mask |= std::uint64_t{static_cast<std::uint16_t>(_mm_movemask_epi8(found))} << i;
+        }
+#else
+        for (std::size_t i = 0; i < block_size; ++i) {
+            mask |= std::uint64_t{is_separator(block[i])} << i;
+        }
+#endif
+        return mask;
+    }
+
+    // The last block is shorter and can't be loaded at once.
+    std::uint64_t tail_mask() const {
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; block_ + i < input_.size(); ++i) {
+            mask |= std::uint64_t{is_separator(input_[block_ + i])} << i;
+        }
+        return mask;
+    }
+};
+
+/*
+ * Splits the input into non-empty stacks of non-empty frames in one sweep. A frame is parsed
+ * from the trimmed token and its fields, the parts of the token between the first three colons.
+ */
+template<typename T, typename ParseFrame>
+std::vector<std::vector<T>> parse_stacks(std::string_view input, bool colons, ParseFrame parse_frame) {
+    std::vector<std::vector<T>> result;
+    std::vector<T> stack;
+
+    SeparatorScanner scanner{input, colons};
+    std::array<std::string_view, 4> fields;
+    std::size_t field_count = 0;
+    std::size_t token_begin = 0;
+    std::size_t field_begin = 0;
+
+    while (token_begin <= input.size()) {
+        const auto end = scanner.next();
+        const char separator = end < input.size() ? input[end] : ';';
+
+        if (separator == ':') {
+            if (field_count < fields.size() - 1) {
+                fields[field_count++] = input.substr(field_begin, end - field_begin);
+                field_begin = end + 1;
+            }
+            continue;
+        }
+
+        const auto token = trim(input.substr(token_begin, end - token_begin));
+        if (!token.empty()) {
+            fields[field_count++] = input.substr(field_begin, end - field_begin);
+            stack.push_back(parse_frame(token, std::span{fields}.first(field_count)));
+        }
+        if (separator == ';' && !stack.empty()) {
+            result.push_back(std::move(stack));
+            // Stacks of a sample usually have similar depths.
+            stack = {};
+            stack.reserve(result.back().size());
+        }
+
+        field_count = 0;
+        token_begin = field_begin = end + 1;
+    }
+
+    return result;
+}
+
+} // namespace
+
+std::vector<std::vector<std::string>> parse_input(std::string_view input) {
+    return parse_stacks<std::string>(input, false, [](std::string_view token, auto) {
+        return std::string(token);
+    });
+}
+
+std::vector<std::vector<Frame>> parse_input_frames(std::string_view input) {
+    return parse_stacks<Frame>(input, true, [](std::string_view token, std::span<const std::string_view> fields) {
+        // token format: function[:filename[:row[:column]]]
+        const auto field = [&](std::size_t i) { return i < fields.size() ? trim(fields[i]) : std::string_view{}; };
+
+        Frame f;
+        const auto func_sv = field(0);
+        if (func_sv.empty()) {
+            throw std::runtime_error("Invalid frame token (empty func): '" + std::string(token) + "'");
+        }
+        const auto row_sv = field(2);
+        if (!row_sv.empty() && !parse_leading_int(row_sv, f.row)) {
+            throw std::runtime_error("Invalid frame token (row not integer): '" + std::string(token) + "'");
+        }
+        const auto col_sv = field(3);
+        if (!col_sv.empty() && !parse_leading_int(col_sv, f.column)) {
+            throw std::runtime_error("Invalid frame token (column not integer): '" + std::string(token) + "'");
+        }
+        f.function = std::string(func_sv);
+        f.filename = std::string(field(1));
+        return f;
+    });
+}
+
+std::vector<std::vector<std::uint64_t>> parse_input_addresses(std::string_view input) {
+    return parse_stacks<std::uint64_t>(input, false, [](std::string_view token, auto) {
+        // token format: hexadecimal address with an optional 0x prefix
+        std::string_view digits = token;
+        if (digits.starts_with("0x") || digits.starts_with("0X")) {
+            digits.remove_prefix(2);
+        }
+        std::uint64_t address = 0;
+        if (!parse_int(digits, address, 16)) {
+            throw std::runtime_error("Invalid address token: '" + std::string(token) + "'");
+        }
+        return address;
+    });
+}
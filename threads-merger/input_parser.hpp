@@ -0,0 +1,27 @@
+#ifndef INPUT_PARSER_HPP
+#define INPUT_PARSER_HPP
+
+#include "merger.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Parsers of the text stack formats accepted by the CLI.
+ *
+ * Stacks are separated by ';' and frames of a stack by ','. Frames go from the innermost
+ * to the outermost one. Empty stacks and frames are skipped.
+ */
+
+// Frames are arbitrary strings: "f,e,d,c,b,a; f,e,g,c,b,a".
+std::vector<std::vector<std::string>> parse_input(std::string_view input);
+
+// Frames are formatted as function[:filename[:row[:column]]]. Throws std::runtime_error on invalid frames.
+std::vector<std::vector<Frame>> parse_input_frames(std::string_view input);
+
+// Frames are hexadecimal program counters with an optional 0x prefix. Throws std::runtime_error on invalid frames.
+std::vector<std::vector<std::uint64_t>> parse_input_addresses(std::string_view input);
+
+#endif // INPUT_PARSER_HPP
@@ -0,0 +1,46 @@
+#include "json_writer.hpp"
+
+#include <array>
+
+namespace Json {
+
+void write_string(std::ostream& os, std::string_view value) {
+    static constexpr std::array<char, 16> hex_digits{
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+    };
+
+    os << '"';
+    std::size_t plain_begin = 0;
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        const auto c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        os.write(value.data() + plain_begin, static_cast<std::streamsize>(i - plain_begin));
+        plain_begin = i + 1;
+
+        switch (c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\b': os << "\\b"; break;
+            case '\f': os << "\\f"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            default: os << "\\u00" << hex_digits[c >> 4] << hex_digits[c & 0xF]; break;
+        }
+    }
+    os.write(value.data() + plain_begin, static_cast<std::streamsize>(value.size() - plain_begin));
+    os << '"';
+}
+
+void write_key(std::ostream& os, std::string_view key, bool first) {
+    if (!first) {
+        os << ',';
+    }
+    write_string(os, key);
+    os << ':';
+}
+
+} // namespace Json
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+/* Minimal helpers for writing JSON straight into a stream, without building a document in memory.
+ *
+ * JSON: https://www.json.org
+ *
+ */
+
+namespace Json {
+
+// Writes a quoted and escaped JSON string.
+void write_string(std::ostream& os, std::string_view value);
+
+// Writes `"key":` including the separating comma if the key is not the first one in the object.
+void write_key(std::ostream& os, std::string_view key, bool first = false);
+
+} // namespace Json
@@ -0,0 +1,29 @@
+#include "json_export.hpp"
+
+
+template<>
+void JsonValue<int>::write(std::ostream& os, const int& item)
+{
+    os << item;
+}
+
+template<>
+void JsonValue<std::string>::write(std::ostream& os, const std::string& item)
+{
+    Json::write_string(os, item);
+}
+
+template<>
+void JsonValue<Frame>::write(std::ostream& os, const Frame& frame)
+{
+    os << '{';
+    Json::write_key(os, "function", true);
+    Json::write_string(os, frame.function);
+    Json::write_key(os, "filename");
+    Json::write_string(os, frame.filename);
+    Json::write_key(os, "row");
+    os << frame.row;
+    Json::write_key(os, "column");
+    os << frame.column;
+    os << '}';
+}
@@ -0,0 +1,169 @@
+#ifndef JSON_EXPORT_HPP
+#define JSON_EXPORT_HPP
+
+#include "merger.hpp"
+#include "json/json_writer.hpp"
+
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory_resource>
+
+/*
+ * JSON export of a merged tree.
+ *
+ * Both writers stream the output and traverse the tree with an explicit stack, so the depth of
+ * the tree is limited by memory only. Children are written in ascending order of their values.
+ *
+ * Tree format:
+ *
+ *     {"count":2,"children":[{"frame":...,"count":2,"level":1,"collapsed":0,"children":[...]}]}
+ *
+ * The root may have more fields, e.g. "max_error" and "total" of an approximate tree.
+ *
+ * Newline-delimited format, one node per line in depth-first order, the root has id 0:
+ *
+ *     {"id":0,"count":2}
+ *     {"id":1,"parent":0,"frame":...,"count":2,"level":1,"collapsed":0}
+ */
+
+template<typename T>
+struct JsonValue {
+    static void write(std::ostream& os, const T& item);
+};
+
+template<typename T>
+void write_json_node_fields(std::ostream& os, const NodeMapValue<T>& node, bool first = false)
+{
+    Json::write_key(os, "frame", first);
+    JsonValue<T>::write(os, node.first);
+    Json::write_key(os, "count");
+    os << node.second.count;
+    Json::write_key(os, "level");
+    os << node.second.level;
+    Json::write_key(os, "collapsed");
+    os << node.second.collapsed;
+}
+
+// A number field of the root object.
+struct JsonField {
+    std::string_view key;
+    std::size_t value;
+};
+
+template<typename T>
+void write_json_tree(
+    std::ostream& os,
+    const Node<T>& root,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource(),
+    std::span<const JsonField> root_fields = {})
+{
+    using Children = decltype(sorted_nodes<T>(root.next_nodes, scratch));
+
+    struct Level {
+        Children children;
+        std::size_t written = 0;
+    };
+
+    auto levels = make_scratch_stack<Level>(scratch);
+
+    os << '{';
+    Json::write_key(os, "count", true);
+    os << root.count;
+    for (const auto& field : root_fields) {
+        Json::write_key(os, field.key);
+        os << field.value;
+    }
+    Json::write_key(os, "children");
+    os << '[';
+    levels.push(Level{sorted_nodes<T>(root.next_nodes, scratch)});
+
+    while (!levels.empty()) {
+        auto& level = levels.top();
+        if (level.written == level.children.size()) {
+            levels.pop();
+            os << "]}";
+            continue;
+        }
+
+        // sorted_nodes() returns the descending order.
+        const auto& node = level.children[level.children.size() - 1 - level.written].get();
+        if (level.written++ > 0) {
+            os << ',';
+        }
+
+        os << '{';
+        write_json_node_fields<T>(os, node, true);
+        Json::write_key(os, "children");
+        os << '[';
+        levels.push(Level{sorted_nodes<T>(node.second.next_nodes, scratch)});
+    }
+    os << '\n';
+}
+
+template<typename T>
+void write_json_lines(
+    std::ostream& os,
+    const Node<T>& root,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    struct Item {
+        NodeMapValueConstRef<T> node;
+        std::size_t parent_id;
+    };
+
+    auto items = make_scratch_stack<Item>(scratch);
+    std::size_t id_count = 0;
+
+    auto push_children = [&](const NodeMap<T>& next_nodes, std::size_t parent_id) {
+        // sorted_nodes() returns the descending order, so the smallest value is popped first.
+        for (const auto& next_node: sorted_nodes<T>(next_nodes, scratch)) {
+            items.push(Item{next_node, parent_id});
+        }
+    };
+
+    os << '{';
+    Json::write_key(os, "id", true);
+    os << id_count;
+    Json::write_key(os, "count");
+    os << root.count;
+    os << "}\n";
+    push_children(root.next_nodes, id_count++);
+
+    while (!items.empty()) {
+        const auto item = items.top();
+        items.pop();
+
+        const auto id = id_count++;
+        const auto& node = item.node.get();
+
+        os << '{';
+        Json::write_key(os, "id", true);
+        os << id;
+        Json::write_key(os, "parent");
+        os << item.parent_id;
+        write_json_node_fields<T>(os, node);
+        os << "}\n";
+
+        push_children(node.second.next_nodes, id);
+    }
+}
+
+template<typename T>
+std::string get_json_tree(const Node<T>& root, std::span<const JsonField> root_fields = {})
+{
+    std::ostringstream json;
+    write_json_tree(json, root, std::pmr::get_default_resource(), root_fields);
+    return json.str();
+}
+
+template<typename T>
+std::string merge_to_json(const std::vector<std::vector<T>>& lists)
+{
+    const auto root = merge(lists);
+    return get_json_tree(root);
+}
+
+#endif // JSON_EXPORT_HPP
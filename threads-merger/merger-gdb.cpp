@@ -0,0 +1,231 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "merger.hpp"
+#include "json_export.hpp"
+#include "svg_renderer.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Python module for GDB that merges the stacks of the threads of an inferior. Frames are read
+ * through the GDB Python API and go to merge() as they are, without printing and parsing backtraces.
+ * The 'parallel-stacks' command is defined in gdb/parallel_stacks.py.
+ */
+
+namespace {
+
+struct PyObjectDeleter {
+    void operator()(PyObject* object) const { Py_XDECREF(object); }
+};
+
+using PyObjectPtr = std::unique_ptr<PyObject, PyObjectDeleter>;
+
+// A Python call failed, the Python exception is set.
+struct PythonError {};
+
+PyObjectPtr checked(PyObject* object) {
+    if (!object) {
+        throw PythonError{};
+    }
+    return PyObjectPtr{object};
+}
+
+PyObjectPtr call_method(PyObject* object, const char* name) {
+    return checked(PyObject_CallMethod(object, name, nullptr));
+}
+
+PyObjectPtr attribute(PyObject* object, const char* name) {
+    return checked(PyObject_GetAttrString(object, name));
+}
+
+std::string to_string(PyObject* text) {
+    Py_ssize_t size = 0;
+    const char* data = PyUnicode_AsUTF8AndSize(text, &size);
+    if (!data) {
+        throw PythonError{};
+    }
+    return std::string(data, static_cast<std::size_t>(size));
+}
+
+template<typename Int>
+Int to_int(PyObject* number) {
+    const auto value = PyLong_AsLongLong(number);
+    if (value == -1 && PyErr_Occurred()) {
+        throw PythonError{};
+    }
+    return static_cast<Int>(value);
+}
+
+// Clears the Python exception if it is a gdb.error, e.g. of a corrupted stack. Other exceptions stay.
+bool clear_gdb_error(PyObject* gdb_error) {
+    if (!PyErr_ExceptionMatches(gdb_error)) {
+        return false;
+    }
+    PyErr_Clear();
+    return true;
+}
+
+/*
+ * Frames of the selected thread from the innermost one. A gdb.error of a frame ends the stack,
+ * the frames read before it are kept.
+ * https://sourceware.org/gdb/current/onlinedocs/gdb.html/Frames-In-Python.html
+ */
+std::vector<Frame> selected_thread_stack(PyObject* gdb, PyObject* gdb_error) {
+    std::vector<Frame> stack;
+    try {
+        for (auto frame = call_method(gdb, "newest_frame"); frame.get() != Py_None; frame = call_method(frame.get(), "older")) {
+            Frame result;
+
+            const auto name = call_method(frame.get(), "name");
+            if (name.get() != Py_None) {
+                result.function = to_string(name.get());
+            } else {
+                result.function = std::format("{:#x}", to_int<std::uint64_t>(call_method(frame.get(), "pc").get()));
+            }
+
+            // https://sourceware.org/gdb/current/onlinedocs/gdb.html/Symbol-Tables-In-Python.html
+            const auto sal = call_method(frame.get(), "find_sal");
+            const auto symtab = attribute(sal.get(), "symtab");
+            if (symtab.get() != Py_None) {
+                result.filename = std::filesystem::path{to_string(attribute(symtab.get(), "filename").get())}.filename().string();
+                result.row = to_int<int>(attribute(sal.get(), "line").get());
+            }
+
+            stack.push_back(std::move(result));
+        }
+    } catch (const PythonError&) {
+        if (!clear_gdb_error(gdb_error)) {
+            throw;
+        }
+    }
+    return stack;
+}
+
+/*
+ * Stacks of all threads of the inferior. Each thread is selected to read its frames,
+ * the thread that was selected before is selected again. A thread that can't be selected,
+ * e.g. one that exited, is skipped.
+ */
+std::vector<std::vector<Frame>> inferior_stacks(PyObject* inferior) {
+    const auto gdb = checked(PyImport_ImportModule("gdb"));
+    const auto gdb_error = attribute(gdb.get(), "error");
+    const auto selected = call_method(gdb.get(), "selected_thread");
+    const auto threads = checked(PySequence_Fast(call_method(inferior, "threads").get(), "threads() must return a sequence"));
+
+    std::vector<std::vector<Frame>> stacks;
+    try {
+        const auto count = PySequence_Fast_GET_SIZE(threads.get());
+        stacks.reserve(static_cast<std::size_t>(count));
+        for (Py_ssize_t i = 0; i < count; ++i) {
+            try {
+                call_method(PySequence_Fast_GET_ITEM(threads.get(), i), "switch");
+            } catch (const PythonError&) {
+                if (!clear_gdb_error(gdb_error.get())) {
+                    throw;
+                }
+                continue;
+            }
+            stacks.push_back(selected_thread_stack(gdb.get(), gdb_error.get()));
+        }
+    } catch (const PythonError&) {
+        if (selected.get() != Py_None) {
+            PyObject* type = nullptr;
+            PyObject* value = nullptr;
+            PyObject* traceback = nullptr;
+            PyErr_Fetch(&type, &value, &traceback);
+            Py_XDECREF(PyObject_CallMethod(selected.get(), "switch", nullptr));
+            PyErr_Restore(type, value, traceback);
+        }
+        throw;
+    }
+
+    if (selected.get() != Py_None) {
+        call_method(selected.get(), "switch");
+    }
+    return stacks;
+}
+
+std::string render(const std::vector<std::vector<Frame>>& stacks, std::string_view format, std::size_t depth_limit, Orientation orientation) {
+    const auto tree = merge(stacks, orientation, depth_limit);
+    if (format == "dot") {
+        return get_dot_graph_parallel(tree, orientation);
+    }
+    if (format == "json") {
+        return get_json_tree(tree);
+    }
+    if (format == "svg") {
+        SvgRenderer svg_renderer;
+        auto svg = svg_renderer.render(get_dot_graph_parallel(tree, orientation, 0, DotStyle::Compact));
+        if (svg.starts_with("Error:")) {
+            throw std::runtime_error(svg);
+        }
+        return svg;
+    }
+    throw std::runtime_error("Unknown format: " + std::string(format));
+}
+
+PyObject* merge_threads(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"inferior", "format", "depth_limit", "callee_rooted", nullptr};
+    PyObject* inferior = nullptr;
+    const char* format = "svg";
+    Py_ssize_t depth_limit = 0;
+    int callee_rooted = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|snp", const_cast<char**>(keywords),
+                                     &inferior, &format, &depth_limit, &callee_rooted)) {
+        return nullptr;
+    }
+    if (depth_limit < 0) {
+        PyErr_SetString(PyExc_ValueError, "depth_limit must not be negative");
+        return nullptr;
+    }
+
+    try {
+        const auto stacks = inferior_stacks(inferior);
+        const auto orientation = callee_rooted ? Orientation::CalleeRooted : Orientation::CallerRooted;
+        const auto result = render(stacks, format, static_cast<std::size_t>(depth_limit), orientation);
+        return PyUnicode_FromStringAndSize(result.data(), static_cast<Py_ssize_t>(result.size()));
+    } catch (const PythonError&) {
+        return nullptr;
+    } catch (const std::exception& ex) {
+        PyErr_SetString(PyExc_RuntimeError, ex.what());
+        return nullptr;
+    }
+}
+
+PyMethodDef methods[] = {
+    {
+        "merge_threads",
+        reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(merge_threads)),
+        METH_VARARGS | METH_KEYWORDS,
+        "merge_threads(inferior, format='svg', depth_limit=0, callee_rooted=False)\n"
+        "--\n\n"
+        "Merges the stacks of all threads of a gdb.Inferior and returns the graph as 'svg', 'dot' or 'json'.",
+    },
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    "threads_merger",
+    "Merges the stacks of the threads of a GDB inferior into a graph.",
+    -1,
+    methods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_threads_merger() {
+    return PyModule_Create(&module);
+}
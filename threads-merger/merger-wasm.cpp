@@ -1,8 +1,38 @@
 #include "merger.hpp"
+#include "json_export.hpp"
+#include "frame_index.hpp"
+#include "tree_view.hpp"
+#include "budget.hpp"
 
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
+#include <chrono>
+#include <sstream>
+#include <string>
 #include <vector>
 
+namespace {
+
+// A budget of a time in milliseconds and a number of nodes; 0 means no limit.
+// The progress callback gets the stage ("merge" or "render"), the done and all items,
+// and cancels the work by returning false.
+Budget make_budget(double time_limit, double node_limit, emscripten::val progress) {
+    Budget budget{
+        .time_limit = std::chrono::milliseconds{static_cast<long long>(time_limit)},
+        .node_limit = static_cast<std::size_t>(node_limit),
+    };
+    if (!progress.isUndefined() && !progress.isNull()) {
+        budget.progress = [progress](BudgetStage stage, std::size_t done, std::size_t total) {
+            const auto result = progress(std::string(stage == BudgetStage::Merge ? "merge" : "render"),
+                                         static_cast<double>(done), static_cast<double>(total));
+            return !result.isFalse();
+        };
+    }
+    return budget;
+}
+
+} // namespace
+
 EMSCRIPTEN_BINDINGS(parallel_stacks_module) {
     emscripten::class_<Frame>("Frame")
         .constructor<>()
@@ -16,4 +46,78 @@ EMSCRIPTEN_BINDINGS(parallel_stacks_module) {
     emscripten::register_vector<std::vector<Frame>>("VectorVectorFrame");
     
     emscripten::function("merge_to_graphviz_dot", &merge_to_graphviz_dot<Frame>);
+    emscripten::function("merge_to_json", &merge_to_json<Frame>);
+
+    emscripten::value_object<BudgetedDot>("BudgetedDot")
+        .field("dot", &BudgetedDot::dot)
+        .field("truncated", &BudgetedDot::truncated);
+
+    // Compact DOT within a budget, see make_budget().
+    emscripten::function("merge_to_graphviz_dot_budgeted", emscripten::optional_override(
+        [](const std::vector<std::vector<Frame>>& stacks, double time_limit, double node_limit, emscripten::val progress) {
+            return merge_to_graphviz_dot_budgeted(stacks, make_budget(time_limit, node_limit, std::move(progress)),
+                                                  Orientation::CallerRooted, 0, DotStyle::Compact);
+        }));
+
+    // Merged stacks that stay in the module and are rendered to DOT on demand.
+    emscripten::class_<TreeView<Frame>>("TreeView")
+        .constructor<const std::vector<std::vector<Frame>>&>()
+        .function("add_stack", &TreeView<Frame>::add_stack)
+        .function("remove_stack", &TreeView<Frame>::remove_stack)
+        .function("render", emscripten::optional_override(
+            [](TreeView<Frame>& self, std::size_t depth) { return self.render(depth); }))
+        .function("expand", emscripten::optional_override(
+            [](TreeView<Frame>& self, int table_id) { return self.expand(table_id); }))
+        .function("dot", emscripten::optional_override(
+            [](TreeView<Frame>& self) { return self.dot(); }))
+        // The same within a time in milliseconds, see make_budget(); the tables that are left out
+        // are placeholders.
+        .function("render_budgeted", emscripten::optional_override(
+            [](TreeView<Frame>& self, std::size_t depth, double time_limit, emscripten::val progress) {
+                BudgetTracker tracker{make_budget(time_limit, 0, std::move(progress))};
+                return self.render(depth, &tracker);
+            }))
+        .function("expand_budgeted", emscripten::optional_override(
+            [](TreeView<Frame>& self, int table_id, double time_limit, emscripten::val progress) {
+                BudgetTracker tracker{make_budget(time_limit, 0, std::move(progress))};
+                return self.expand(table_id, &tracker);
+            }))
+        .function("dot_budgeted", emscripten::optional_override(
+            [](TreeView<Frame>& self, double time_limit, emscripten::val progress) {
+                BudgetTracker tracker{make_budget(time_limit, 0, std::move(progress))};
+                return self.dot(&tracker);
+            }));
+
+    // Merged stacks with an index for queries by function name.
+    emscripten::class_<IndexedTree<Frame>>("IndexedTree")
+        .constructor<const std::vector<std::vector<Frame>>&>()
+        .function("count", emscripten::optional_override(
+            [](const IndexedTree<Frame>& self, const std::string& function) {
+                return self.index().count(function);
+            }))
+        // DOT of only the stacks that contain the function, or of all stacks for an empty name.
+        .function("graphviz_dot", emscripten::optional_override(
+            [](const IndexedTree<Frame>& self, const std::string& function) {
+                if (function.empty()) {
+                    return get_dot_graph(self.tree(), Orientation::CallerRooted, DotStyle::Compact);
+                }
+                return get_dot_graph(self.index().filter(function), Orientation::CallerRooted, DotStyle::Compact);
+            }))
+        // JSON array of {"caller":..., "count":...}.
+        .function("callers_json", emscripten::optional_override(
+            [](const IndexedTree<Frame>& self, const std::string& function) {
+                std::ostringstream os;
+                os << '[';
+                bool first = true;
+                for (const auto& [caller, count] : self.index().callers(function)) {
+                    os << (first ? "{" : ",{");
+                    Json::write_key(os, "caller", true);
+                    Json::write_string(os, caller);
+                    Json::write_key(os, "count");
+                    os << count << '}';
+                    first = false;
+                }
+                os << ']';
+                return os.str();
+            }));
 }
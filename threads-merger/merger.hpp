@@ -1,8 +1,10 @@
 #ifndef MERGER_HPP
 #define MERGER_HPP
 
+#include "child_map.hpp"
 #include "html/html_table.hpp"
 
+#include <cstdint>
 #include <string>
 #include <functional>
 #include <unordered_map>
@@ -14,6 +16,13 @@
 #include <algorithm>
 #include <format>
 #include <ranges>
+#include <span>
+#include <memory_resource>
+#include <type_traits>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 
 struct Frame
@@ -62,7 +71,8 @@ struct Node
     std::size_t count = 0;
     std::size_t level = 0;
     std::size_t collapsed = 0;
-    std::unordered_map<T, Node> next_nodes;
+    // Children share the memory resource of their parent (see merge()).
+    ChildMap<T, Node> next_nodes;
 
     auto operator<=>(const Node&) const = default;
 
@@ -104,68 +114,362 @@ std::ostream& Node<T>::print_node(std::ostream& os, int indent) const {
 }
 
 
+template<typename T>
+using NodeMap = decltype(Node<T>{}.next_nodes);
+
+template<typename T>
+using NodeMapValue = typename NodeMap<T>::value_type;
+
+template<typename T>
+using NodeMapValueRef = std::reference_wrapper<NodeMapValue<T>>;
+
+template<typename T>
+using NodeMapValueConstRef = std::reference_wrapper<const NodeMapValue<T>>;
+
+/**
+ * Copies a node and its subtree. All copied nodes allocate their children from the memory
+ * resource of the allocator, so the copy can be a child of a map of that resource.
+ */
+template<typename T>
+Node<T> copy_node(const Node<T>& node, const typename NodeMap<T>::allocator_type& allocator)
+{
+    Node<T> copy{
+        .count = node.count,
+        .level = node.level,
+        .collapsed = node.collapsed,
+        .next_nodes = NodeMap<T>(allocator),
+    };
+    for (const auto& [value, next_node] : node.next_nodes) {
+        copy.next_nodes.emplace(value, copy_node(next_node, allocator));
+    }
+    return copy;
+}
+
+/**
+ * Explicit stack for tree traversals. The storage comes from a scratch memory resource.
+ */
+template<typename T>
+using ScratchStack = std::stack<T, std::pmr::vector<T>>;
+
+template<typename T>
+ScratchStack<T> make_scratch_stack(std::pmr::memory_resource* scratch)
+{
+    return ScratchStack<T>{std::pmr::vector<T>{scratch}};
+}
+
+/**
+ * Returns the child node for the value, creating it if necessary.
+ * A new child allocates its own children from the same memory resource as the parent.
+ */
+template<typename T>
+Node<T>& child_node(Node<T>& parent, const T& value)
+{
+    auto it = parent.next_nodes.find(value);
+    if (it == parent.next_nodes.end()) {
+        it = parent.next_nodes.emplace(
+            value,
+            Node<T>{.next_nodes = NodeMap<T>(parent.next_nodes.get_allocator())}
+        ).first;
+    }
+    return it->second;
+}
+
+template<typename T>
+void collapse(Node<T> & root, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+/**
+ * Direction in which stacks are merged into a tree.
+ */
+enum class Orientation {
+    // From the outermost caller: the roots are the entry points of threads.
+    CallerRooted,
+    // From the innermost callee: the roots are the frames where threads are, e.g. blocked.
+    CalleeRooted,
+};
+
+// Number of frames of a stack that are merged; 0 means no depth limit.
+inline std::size_t merged_depth(const std::size_t stack_size, const std::size_t depth_limit)
+{
+    return depth_limit > 0 ? std::min(stack_size, depth_limit) : stack_size;
+}
+
+// Frame of a stack at the depth of a tree. Stacks go from the innermost to the outermost frame.
+template<typename T>
+const T& merged_frame(const std::vector<T>& list, const std::size_t depth, const Orientation orientation)
+{
+    return orientation == Orientation::CalleeRooted ? list[depth] : list[list.size() - 1 - depth];
+}
+
+/**
+ * Adds a stack to a tree that is not collapsed yet.
+ *
+ * @param depth_limit Maximum depth to merge from the stack; 0 means no depth limit.
+ * @param weight Number of threads with the stack.
+ * @return Number of new nodes.
+ */
+template<typename T>
+std::size_t add_stack(
+    Node<T>& root,
+    const std::vector<T>& list,
+    const std::size_t depth_limit = 0,
+    const Orientation orientation = Orientation::CallerRooted,
+    const std::size_t weight = 1)
+{
+    if (list.empty() || weight == 0) return 0;
+
+    root.count += weight; // Увеличиваем счетчик для каждого непустого стека
+
+    // Добавляем элементы в дерево, начиная с корневого
+    Node<T>* current = &root;
+
+    std::size_t new_nodes = 0;
+    const auto depth = merged_depth(list.size(), depth_limit);
+    for (std::size_t i = 0; i < depth; i++) {
+        // Получаем ссылку на узел (создает новый, если не существует)
+        auto& node_ref = child_node(*current, merged_frame(list, i, orientation));
+        if (node_ref.count == 0) {
+            // Новый узел
+            node_ref.level = i + 1;
+            ++new_nodes;
+        }
+        node_ref.count += weight;
+        current = &node_ref;
+    }
+    return new_nodes;
+}
+
+/**
+ * Removes a stack that was added with add_stack() with the same depth limit and orientation
+ * from a tree that is not collapsed. Nodes that are left without stacks are erased.
+ * A stack that is not in the tree, including a prefix of longer stacks only, is ignored.
+ *
+ * @param depth_limit Maximum depth to merge from the stack; 0 means no depth limit.
+ */
+template<typename T>
+void remove_stack(
+    Node<T>& root,
+    const std::vector<T>& list,
+    const std::size_t depth_limit = 0,
+    const Orientation orientation = Orientation::CallerRooted)
+{
+    if (list.empty()) return;
+
+    const auto depth = merged_depth(list.size(), depth_limit);
+
+    // Find the whole path first, so a missing stack doesn't change the counts.
+    std::vector<Node<T>*> path;
+    Node<T>* current = &root;
+    for (std::size_t i = 0; i < depth; i++) {
+        const auto it = current->next_nodes.find(merged_frame(list, i, orientation));
+        if (it == current->next_nodes.end()) {
+            return;
+        }
+        current = &it->second;
+        path.push_back(current);
+    }
+
+    // A stack ends at the last node only if the node has more stacks than its children, otherwise
+    // the path is a prefix of longer stacks.
+    std::size_t children_count = 0;
+    for (const auto& [frame, child] : current->next_nodes) {
+        children_count += child.count;
+    }
+    if (current->count <= children_count) {
+        return;
+    }
+
+    root.count--;
+    for (auto* node : path) {
+        node->count--;
+    }
+
+    // The counts don't grow along the path, so the first node without stacks is erased
+    // together with all nodes after it.
+    Node<T>* parent = &root;
+    for (std::size_t i = 0; i < path.size(); i++) {
+        if (path[i]->count == 0) {
+            parent->next_nodes.erase(merged_frame(list, i, orientation));
+            return;
+        }
+        parent = path[i];
+    }
+}
+
 /**
+ * Hash of the frames of a stack that are merged into a tree.
+ */
+template<typename T>
+std::uint64_t stack_fingerprint(const std::vector<T>& list, const std::size_t depth, const Orientation orientation)
+{
+    std::uint64_t hash = depth;
+    for (std::size_t i = 0; i < depth; i++) {
+        const std::uint64_t frame_hash = std::hash<T>{}(merged_frame(list, i, orientation));
+        hash ^= frame_hash + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+/**
+ * A stack and the number of threads with it.
+ */
+template<typename T>
+using WeightedStack = std::pair<std::vector<T>, std::size_t>;
+
+/**
+ * Merges stacks that are already aggregated. The cost depends on the number of unique stacks only.
+ *
  * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+ * @param resource Memory resource for all nodes of the tree. It must outlive the tree.
+ * @param scratch Memory resource for temporary data.
  */
 template<typename T>
 Node<T> merge(
-    const std::vector<std::vector<T>>& lists,
-    const std::size_t depth_limit = 0)
+    const std::vector<WeightedStack<T>>& stacks,
+    const Orientation orientation = Orientation::CallerRooted,
+    const std::size_t depth_limit = 0,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
 {
-    Node<T> root{};
+    Node<T> root{.next_nodes = NodeMap<T>(resource)};
 
-    for (const auto& list: lists) {
-        if (list.empty()) continue;
+    for (const auto& [list, weight]: stacks) {
+        add_stack(root, list, depth_limit, orientation, weight);
+    }
 
-        root.count++; // Увеличиваем счетчик для каждого непустого стека
+    collapse(root, scratch);
 
-        // Добавляем элементы в дерево, начиная с последнего (корневого)
-        Node<T>* current = &root;
+    return root;
+}
 
-        auto last_item = list.rend();
-        if (depth_limit > 0 && list.size() > depth_limit) {
-            last_item = std::next(list.rbegin(), depth_limit);
-        }
+/**
+ * Merges stacks in the orientation. The parsed stacks can be merged in both orientations.
+ * Identical stacks, up to the depth limit, are added to the tree once with their number as the weight.
+ *
+ * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+ * @param resource Memory resource for all nodes of the tree. It must outlive the tree.
+ * @param scratch Memory resource for temporary data.
+ */
+template<typename T>
+Node<T> merge(
+    const std::vector<std::vector<T>>& lists,
+    const Orientation orientation,
+    const std::size_t depth_limit = 0,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    struct UniqueStack {
+        const std::vector<T>* list;
+        std::size_t depth;
+        std::size_t weight;
+    };
 
-        std::size_t level = 0;
-        for (auto valueIt = list.rbegin(); valueIt != last_item; valueIt++) {
-            level++;
+    std::pmr::vector<UniqueStack> unique_stacks{scratch};
+    std::pmr::unordered_multimap<std::uint64_t, std::size_t> fingerprints{scratch};
+    fingerprints.reserve(lists.size());
 
-            // Получаем ссылку на узел (создает новый, если не существует)
-            auto& node_ref = current->next_nodes[*valueIt];
-            if (node_ref.count == 0) {
-                // Новый узел
-                node_ref.count = 1;
-                node_ref.level = level;
-            } else {
-                // Существующий узел
-                node_ref.count++;
+    for (const auto& list: lists) {
+        const auto depth = merged_depth(list.size(), depth_limit);
+        const auto fingerprint = stack_fingerprint(list, depth, orientation);
+
+        const auto [first, last] = fingerprints.equal_range(fingerprint);
+        const auto same = std::find_if(first, last, [&](const auto& item) {
+            const auto& unique = unique_stacks[item.second];
+            if (unique.depth != depth) {
+                return false;
+            }
+            for (std::size_t i = 0; i < depth; i++) {
+                if (!(merged_frame(*unique.list, i, orientation) == merged_frame(list, i, orientation))) {
+                    return false;
+                }
             }
-            current = &node_ref;
+            return true;
+        });
+
+        if (same != last) {
+            unique_stacks[same->second].weight++;
+        } else {
+            fingerprints.emplace(fingerprint, unique_stacks.size());
+            unique_stacks.push_back(UniqueStack{&list, depth, 1});
         }
     }
 
-    collapse(root);
+    Node<T> root{.next_nodes = NodeMap<T>(resource)};
+
+    for (const auto& unique: unique_stacks) {
+        add_stack(root, *unique.list, depth_limit, orientation, unique.weight);
+    }
+
+    collapse(root, scratch);
 
     return root;
 }
 
+/**
+ * Merges stacks from the outermost caller.
+ *
+ * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+ * @param resource Memory resource for all nodes of the tree. It must outlive the tree.
+ * @param scratch Memory resource for temporary data.
+ */
 template<typename T>
-using NodeMap = decltype(Node<T>{}.next_nodes);
+Node<T> merge(
+    const std::vector<std::vector<T>>& lists,
+    const std::size_t depth_limit = 0,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    return merge(lists, Orientation::CallerRooted, depth_limit, resource, scratch);
+}
 
+/**
+ * A merged tree that lives in its own arena.
+ *
+ * All nodes are allocated from a few large blocks owned by the tree. When the tree is destroyed,
+ * the blocks are released at once. Nodes are not destroyed one by one if the values are
+ * trivially destructible.
+ */
 template<typename T>
-using NodeMapValue = typename NodeMap<T>::value_type;
+class ArenaTree
+{
+public:
+    /**
+     * @param initial_size Size of the first arena block in bytes.
+     */
+    explicit ArenaTree(
+        const std::vector<std::vector<T>>& lists,
+        const std::size_t depth_limit = 0,
+        std::pmr::memory_resource* scratch = std::pmr::get_default_resource(),
+        const std::size_t initial_size = 64 * 1024)
+        : arena_{initial_size}
+    {
+        std::pmr::polymorphic_allocator<> allocator{&arena_};
+        root_ = allocator.new_object<Node<T>>(merge(lists, depth_limit, &arena_, scratch));
+    }
 
-template<typename T>
-using NodeMapValueRef = std::reference_wrapper<NodeMapValue<T>>;
+    ArenaTree(const ArenaTree&) = delete;
+    ArenaTree& operator=(const ArenaTree&) = delete;
 
-template<typename T>
-using NodeMapValueConstRef = std::reference_wrapper<const NodeMapValue<T>>;
+    ~ArenaTree()
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            root_->~Node<T>();
+        }
+    }
+
+    const Node<T>& root() const { return *root_; }
+    Node<T>& root() { return *root_; }
+
+    std::pmr::memory_resource* resource() { return &arena_; }
+
+private:
+    std::pmr::monotonic_buffer_resource arena_;
+    Node<T>* root_ = nullptr;
+};
 
 template<typename T>
-void collapse(Node<T> & root)
+void collapse(Node<T> & root, std::pmr::memory_resource* scratch)
 {
-    std::stack<NodeMapValueRef<T>> nodes_stack;
+    auto nodes_stack = make_scratch_stack<NodeMapValueRef<T>>(scratch);
 
     for (auto& next_node: root.next_nodes) {
         nodes_stack.push(next_node);
@@ -179,8 +483,10 @@ void collapse(Node<T> & root)
             if (next_nodes_count == 1) {
                 auto next_node_ptr = &(*current_node_ptr->second.next_nodes.begin());
                 if (current_node_ptr->first == next_node_ptr->first) {
-                    // Collapse a node.
-                    std::swap(current_node_ptr->second.next_nodes, next_node_ptr->second.next_nodes);
+                    // Collapse a node. The next nodes are moved out first, because assigning
+                    // them destroys the map that holds the next node.
+                    auto next_next_nodes = std::move(next_node_ptr->second.next_nodes);
+                    current_node_ptr->second.next_nodes = std::move(next_next_nodes);
                     current_node_ptr->second.collapsed++;
                 } else {
                     current_node_ptr = next_node_ptr;
@@ -202,9 +508,10 @@ void collapse(Node<T> & root)
 }
 
 template<typename T>
-auto sorted_nodes(const NodeMap<T>& node_map)
+auto sorted_nodes(const NodeMap<T>& node_map, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
 {
-    std::vector<NodeMapValueConstRef<T>> nodes;
+    std::pmr::vector<NodeMapValueConstRef<T>> nodes{scratch};
+    nodes.reserve(node_map.size());
 
     for (const auto& node: node_map) {
         nodes.push_back(node);
@@ -231,59 +538,130 @@ struct HtmlTableRow {
     static std::size_t column_count();
 };
 
+// Adds a cell with the level or the range of levels of collapsed frames.
+void add_level_cell(Html::TableRow& row, const LevelRange& level_range);
+
+/**
+ * Verbose DOT is indented and styles every table and link on its own. Compact DOT moves the common
+ * style to the node and edge defaults of the graph and has no whitespace in tables. Graphviz lays
+ * out both the same way, compact DOT is several times smaller and faster to parse.
+ */
+enum class DotStyle
+{
+    Verbose,
+    Compact,
+};
+
+/**
+ * Writes a DOT node of a table with a chain of frames. The chain goes from the root of the tree,
+ * the table shows it from the top of the stacks in both orientations.
+ *
+ * @param copies Number of identical subtrees the table stands for, shown as ×N.
+ */
 template<typename T>
-std::string get_dot_graph(const Node<T>& root) {
-    std::ostringstream dot;
-    dot << "digraph G {\n";
-    dot << "  rankdir=BT;\n";
-    dot << "  node [shape=plaintext];\n";
+void write_dot_table(
+    std::ostringstream& dot,
+    int table_id,
+    std::span<const std::reference_wrapper<const NodeMapValue<T>>> chain,
+    const Orientation orientation = Orientation::CallerRooted,
+    const DotStyle style = DotStyle::Verbose,
+    const std::size_t copies = 1)
+{
+    Html::Table table;
+
+    if (!chain.empty()) {
+        Html::TableRow row;
+        const auto thread_count = chain[0].get().second.count;
+        auto threads_str = std::to_string(thread_count) + " Thread";
+        if (thread_count > 1) {
+            threads_str += "s";
+        }
+        if (copies > 1) {
+            threads_str += " \u00d7" + std::to_string(copies);
+        }
+        const size_t colspan = HtmlTableRow<T>::column_count();
+        Html::TableCell cell{threads_str, colspan};
+        row.add_cell(cell);
+        table.add_row(row);
+    }
+    const auto add_row = [&](const NodeMapValue<T>& node) {
+        const auto level = node.second.level - 1;
+        const LevelRange& level_range{level, level + node.second.collapsed};
+        table.add_row(HtmlTableRow<T>::to_row(node.first, level_range));
+    };
+    if (orientation == Orientation::CalleeRooted) {
+        std::ranges::for_each(chain, add_row);
+    } else {
+        std::ranges::for_each(chain | std::views::reverse, add_row);
+    }
+
+    if (style == DotStyle::Compact) {
+        dot << "table_" << table_id << "[label=<";
+        table.render(dot, true);
+        dot << ">]\n";
+        return;
+    }
+    dot << "  table_" << table_id << " [label=<" << std::endl;
+    table.render(dot);
+    dot << "  >]" << std::endl << std::endl;
+}
+
+/**
+ * Tables of the DOT graph of a tree in the order they are written, with their ids assigned up front.
+ * The tables can be rendered independently of each other.
+ */
+template<typename T>
+struct DotLayout
+{
+    struct Table
+    {
+        int id = 0;
+        // Range of the chain of the table in nodes.
+        std::size_t first = 0;
+        std::size_t size = 0;
+    };
+
+    std::pmr::vector<NodeMapValueConstRef<T>> nodes;
+    std::pmr::vector<Table> tables;
+    // Sorted links from a table to its next tables.
+    std::pmr::vector<std::pair<int, int>> links;
+    // Number of identical subtrees of each table in a DAG layout; empty in a tree layout.
+    std::pmr::vector<std::size_t> copies;
+
+    std::span<const NodeMapValueConstRef<T>> chain(const Table& table) const
+    {
+        return std::span{nodes}.subspan(table.first, table.size);
+    }
+};
+
+template<typename T>
+DotLayout<T> layout_dot_graph(const Node<T>& root, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    DotLayout<T> layout{
+        .nodes = decltype(DotLayout<T>::nodes){scratch},
+        .tables = decltype(DotLayout<T>::tables){scratch},
+        .links = decltype(DotLayout<T>::links){scratch},
+        .copies = decltype(DotLayout<T>::copies){scratch},
+    };
 
     int table_id_count = 0;
 
     using Pair = NodeMapValue<T>;
 
-    std::stack<NodeMapValueConstRef<T>> nodes_stack;
-    std::stack<int> table_id_stack;
+    auto nodes_stack = make_scratch_stack<NodeMapValueConstRef<T>>(scratch);
+    auto table_id_stack = make_scratch_stack<int>(scratch);
 
-    for (const auto& next_node: sorted_nodes<T>(root.next_nodes)) {
+    for (const auto& next_node: sorted_nodes<T>(root.next_nodes, scratch)) {
         nodes_stack.push(next_node);
         table_id_stack.push(table_id_count++);
     }
 
     const Pair * next_node_ptr = nullptr;
-    int current_table_id = 0;
-    std::vector<std::reference_wrapper<const Pair>> current_table;
-
-    std::unordered_multimap<int, int> table_links;
+    typename DotLayout<T>::Table current_table;
 
     auto save_table = [&]() {
-        Html::Table table;
-
-        if (!current_table.empty()) {
-            Html::TableRow row;
-            const auto thread_count = current_table[0].get().second.count;
-            auto threads_str = std::to_string(thread_count) + " Thread";
-            if (thread_count > 1) {
-                threads_str += "s";
-            }
-            const size_t colspan = HtmlTableRow<T>::column_count();
-            Html::TableCell cell{threads_str, colspan};
-            row.add_cell(cell);
-            table.add_row(row);
-        }
-        for (auto it = current_table.rbegin(); it != current_table.rend(); ++it) {
-            const T& item = it->get().first;
-            const auto level = it->get().second.level - 1;
-            const auto collapsed = it->get().second.collapsed;
-            const LevelRange& level_range{level, level + collapsed};
-            table.add_row(HtmlTableRow<T>::to_row(item, level_range));
-        }
-
-        current_table.clear();
-
-        dot << "  table_" << current_table_id << " [label=<" << std::endl;
-        table.render(dot);
-        dot << "  >]" << std::endl << std::endl;
+        current_table.size = layout.nodes.size() - current_table.first;
+        layout.tables.push_back(current_table);
     };
 
     while (next_node_ptr != nullptr || !nodes_stack.empty()) {
@@ -296,22 +674,23 @@ std::string get_dot_graph(const Node<T>& root) {
             current_node_ptr = &nodes_stack.top().get();
             nodes_stack.pop();
 
-            current_table_id = table_id_stack.top();
+            current_table.id = table_id_stack.top();
+            current_table.first = layout.nodes.size();
             table_id_stack.pop();
         }
 
-        current_table.push_back(*current_node_ptr);
+        layout.nodes.push_back(*current_node_ptr);
 
         if (current_node_ptr->second.next_nodes.size() == 1) {
             next_node_ptr = &(*current_node_ptr->second.next_nodes.begin());
         }
         else if (current_node_ptr->second.next_nodes.size() > 1) {
-            for (const auto& next_node: sorted_nodes<T>(current_node_ptr->second.next_nodes)) {
+            for (const auto& next_node: sorted_nodes<T>(current_node_ptr->second.next_nodes, scratch)) {
                 nodes_stack.push(next_node);
                 table_id_stack.push(table_id_count++);
 
                 // Link the current table to a next table.
-                table_links.emplace(current_table_id, table_id_stack.top());
+                layout.links.emplace_back(current_table.id, table_id_stack.top());
 
             }
 
@@ -322,14 +701,348 @@ std::string get_dot_graph(const Node<T>& root) {
         }
     }
 
-    for (const auto& link : table_links) {
-        dot << "  table_" << link.first << " -> table_" << link.second << " [arrowsize=2 minlen=2]" << std::endl;
+    std::ranges::sort(layout.links);
+
+    return layout;
+}
+
+/**
+ * Classes of identical subtrees of a tree. Subtrees are identical when their roots have the same
+ * frames, counts and levels and their children are identical. The classes are found bottom-up
+ * with Merkle hashes: the hash of a node covers the hashes of the classes of its children.
+ */
+template<typename T>
+struct SubtreeClasses
+{
+    std::pmr::unordered_map<const NodeMapValue<T>*, std::size_t> class_of;
+    // Number of subtrees of each class.
+    std::pmr::vector<std::size_t> copies;
+
+    std::size_t copies_of(const NodeMapValue<T>& node) const { return copies[class_of.at(&node)]; }
+};
+
+template<typename T>
+SubtreeClasses<T> classify_subtrees(const Node<T>& root, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    struct Class
+    {
+        const NodeMapValue<T>* node;
+        std::size_t hash;
+        // Range of the sorted classes of the children in children_classes.
+        std::size_t first;
+        std::size_t size;
+    };
+
+    SubtreeClasses<T> result{
+        .class_of = decltype(SubtreeClasses<T>::class_of){scratch},
+        .copies = decltype(SubtreeClasses<T>::copies){scratch},
+    };
+    std::pmr::vector<Class> classes{scratch};
+    std::pmr::vector<std::size_t> children_classes{scratch};
+    std::pmr::unordered_multimap<std::size_t, std::size_t> classes_by_hash{scratch};
+    std::pmr::vector<std::size_t> children{scratch};
+
+    // A node is classified when it is on the top of the stack the second time, after its children.
+    auto nodes_stack = make_scratch_stack<std::pair<const NodeMapValue<T>*, bool>>(scratch);
+    for (const auto& next_node: root.next_nodes) {
+        nodes_stack.push({&next_node, false});
+    }
+
+    while (!nodes_stack.empty()) {
+        const auto [node, children_done] = nodes_stack.top();
+        if (!children_done) {
+            nodes_stack.top().second = true;
+            for (const auto& next_node: node->second.next_nodes) {
+                nodes_stack.push({&next_node, false});
+            }
+            continue;
+        }
+        nodes_stack.pop();
+
+        children.clear();
+        for (const auto& next_node: node->second.next_nodes) {
+            children.push_back(result.class_of.at(&next_node));
+        }
+        std::ranges::sort(children);
+
+        std::size_t hash = children.size();
+        std::hash_combine(hash, std::hash<T>{}(node->first));
+        std::hash_combine(hash, node->second.count);
+        std::hash_combine(hash, node->second.level);
+        std::hash_combine(hash, node->second.collapsed);
+        for (const auto child: children) {
+            std::hash_combine(hash, classes[child].hash);
+        }
+
+        const auto [first, last] = classes_by_hash.equal_range(hash);
+        const auto same = std::find_if(first, last, [&](const auto& candidate) {
+            const auto& other = classes[candidate.second];
+            return other.node->first == node->first
+                && other.node->second.count == node->second.count
+                && other.node->second.level == node->second.level
+                && other.node->second.collapsed == node->second.collapsed
+                && std::ranges::equal(std::span{children_classes}.subspan(other.first, other.size), children);
+        });
+
+        auto node_class = classes.size();
+        if (same != last) {
+            node_class = same->second;
+        } else {
+            classes.push_back({node, hash, children_classes.size(), children.size()});
+            children_classes.insert(children_classes.end(), children.begin(), children.end());
+            classes_by_hash.emplace(hash, node_class);
+            result.copies.push_back(0);
+        }
+        ++result.copies[node_class];
+        result.class_of.emplace(node, node_class);
+    }
+
+    return result;
+}
+
+/**
+ * Tables of the DOT graph of a tree in which each set of identical subtrees is laid out once and
+ * is linked from the tables of all its parents. A chain ends before a node that is in more subtrees
+ * than the chain, so a common tail of different chains gets a table of its own.
+ */
+template<typename T>
+DotLayout<T> layout_dot_dag(const Node<T>& root, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    const auto subtrees = classify_subtrees(root, scratch);
+
+    DotLayout<T> layout{
+        .nodes = decltype(DotLayout<T>::nodes){scratch},
+        .tables = decltype(DotLayout<T>::tables){scratch},
+        .links = decltype(DotLayout<T>::links){scratch},
+        .copies = decltype(DotLayout<T>::copies){scratch},
+    };
+
+    int table_id_count = 0;
+
+    auto nodes_stack = make_scratch_stack<NodeMapValueConstRef<T>>(scratch);
+    auto table_id_stack = make_scratch_stack<int>(scratch);
+    // Tables of the classes of subtrees that are laid out.
+    std::pmr::unordered_map<std::size_t, int> class_tables{scratch};
+
+    // A table is laid out for the first subtree of its class, the others are links to it.
+    const auto push_table = [&](const NodeMapValue<T>& node, const int parent_table_id) {
+        const auto [it, inserted] = class_tables.try_emplace(subtrees.class_of.at(&node), table_id_count);
+        if (inserted) {
+            nodes_stack.push(node);
+            table_id_stack.push(table_id_count++);
+        }
+        if (parent_table_id >= 0) {
+            layout.links.emplace_back(parent_table_id, it->second);
+        }
+    };
+
+    for (const auto& next_node: sorted_nodes<T>(root.next_nodes, scratch)) {
+        push_table(next_node, -1);
+    }
+
+    const NodeMapValue<T>* next_node_ptr = nullptr;
+    typename DotLayout<T>::Table current_table;
+
+    auto save_table = [&]() {
+        current_table.size = layout.nodes.size() - current_table.first;
+        layout.tables.push_back(current_table);
+        layout.copies.push_back(subtrees.copies_of(layout.nodes[current_table.first]));
+    };
+
+    while (next_node_ptr != nullptr || !nodes_stack.empty()) {
+        const NodeMapValue<T>* current_node_ptr = nullptr;
+
+        if (next_node_ptr) {
+            current_node_ptr = next_node_ptr;
+            next_node_ptr = nullptr;
+        } else {
+            current_node_ptr = &nodes_stack.top().get();
+            nodes_stack.pop();
+
+            current_table.id = table_id_stack.top();
+            current_table.first = layout.nodes.size();
+            table_id_stack.pop();
+        }
+
+        layout.nodes.push_back(*current_node_ptr);
+
+        const auto& next_nodes = current_node_ptr->second.next_nodes;
+        if (next_nodes.size() == 1 && subtrees.copies_of(*next_nodes.begin()) == subtrees.copies_of(*current_node_ptr)) {
+            next_node_ptr = &(*next_nodes.begin());
+        } else {
+            for (const auto& next_node: sorted_nodes<T>(next_nodes, scratch)) {
+                push_table(next_node, current_table.id);
+            }
+            save_table();
+        }
+    }
+
+    std::ranges::sort(layout.links);
+
+    return layout;
+}
+
+inline void write_dot_header(std::ostringstream& dot, const Orientation orientation, const DotStyle style = DotStyle::Verbose)
+{
+    const bool callee_rooted = orientation == Orientation::CalleeRooted;
+    dot << "digraph G {\n";
+    dot << (callee_rooted ? "  rankdir=TB;\n" : "  rankdir=BT;\n");
+    if (style == DotStyle::Compact) {
+        // Text of HTML labels takes the font size of the node.
+        dot << "  node [shape=plaintext fontsize=40];\n";
+        dot << (callee_rooted ? "  edge [arrowsize=2 minlen=2 dir=back];\n" : "  edge [arrowsize=2 minlen=2];\n");
+        return;
     }
+    dot << "  node [shape=plaintext];\n";
+}
 
+inline void write_dot_links(
+    std::ostringstream& dot,
+    std::span<const std::pair<int, int>> links,
+    const Orientation orientation,
+    const DotStyle style = DotStyle::Verbose)
+{
+    const bool callee_rooted = orientation == Orientation::CalleeRooted;
+    for (const auto& link : links) {
+        if (style == DotStyle::Compact) {
+            dot << "table_" << link.first << " -> table_" << link.second << '\n';
+            continue;
+        }
+        dot << "  table_" << link.first << " -> table_" << link.second
+            << (callee_rooted ? " [arrowsize=2 minlen=2 dir=back]" : " [arrowsize=2 minlen=2]") << std::endl;
+    }
     dot << "}\n";
+}
+
+/**
+ * Renders a tree merged in the orientation. The roots are at the bottom of a caller-rooted graph
+ * and at the top of a callee-rooted one, the arrows always point from callers to callees.
+ */
+template<typename T>
+std::string get_dot_graph(
+    const Node<T>& root,
+    const Orientation orientation,
+    const DotStyle style = DotStyle::Verbose,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    const auto layout = layout_dot_graph(root, scratch);
+
+    std::ostringstream dot;
+    write_dot_header(dot, orientation, style);
+    for (const auto& table : layout.tables) {
+        write_dot_table<T>(dot, table.id, layout.chain(table), orientation, style);
+    }
+    write_dot_links(dot, layout.links, orientation, style);
+    return dot.str();
+}
+
+template<typename T>
+std::string get_dot_graph(const Node<T>& root, std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    return get_dot_graph(root, Orientation::CallerRooted, DotStyle::Verbose, scratch);
+}
+
+/**
+ * Renders a tree like get_dot_graph(), but each set of identical subtrees once with the number of
+ * the subtrees, see layout_dot_dag(). E.g. the same calls under different request handlers.
+ */
+template<typename T>
+std::string get_dot_dag(
+    const Node<T>& root,
+    const Orientation orientation = Orientation::CallerRooted,
+    const DotStyle style = DotStyle::Verbose,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    const auto layout = layout_dot_dag(root, scratch);
+
+    std::ostringstream dot;
+    write_dot_header(dot, orientation, style);
+    for (std::size_t i = 0; i < layout.tables.size(); ++i) {
+        const auto& table = layout.tables[i];
+        write_dot_table<T>(dot, table.id, layout.chain(table), orientation, style, layout.copies[i]);
+    }
+    write_dot_links(dot, layout.links, orientation, style);
     return dot.str();
 }
 
+/**
+ * Renders the same graph as get_dot_graph() on several threads. Consecutive tables are rendered
+ * in chunks by the threads, the chunks are concatenated in the order of the tables.
+ *
+ * @param thread_count Number of threads; 0 means the number of hardware threads.
+ * @param scratch Memory resource for the layout of the tables. It is used by the calling thread only.
+ */
+template<typename T>
+std::string get_dot_graph_parallel(
+    const Node<T>& root,
+    const Orientation orientation = Orientation::CallerRooted,
+    unsigned thread_count = 0,
+    const DotStyle style = DotStyle::Verbose,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource())
+{
+    constexpr std::size_t chunk_size = 64;
+
+    const auto layout = layout_dot_graph(root, scratch);
+    const auto tables = std::span{layout.tables};
+    const auto chunk_count = (tables.size() + chunk_size - 1) / chunk_size;
+
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = static_cast<unsigned>(std::min<std::size_t>(thread_count, chunk_count));
+
+    std::vector<std::string> chunks(chunk_count);
+    std::atomic<std::size_t> next_chunk{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    const auto render = [&]() {
+        try {
+            for (auto chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++) {
+                const auto first = chunk * chunk_size;
+                std::ostringstream dot;
+                for (const auto& table : tables.subspan(first, std::min(chunk_size, tables.size() - first))) {
+                    write_dot_table<T>(dot, table.id, layout.chain(table), orientation, style);
+                }
+                chunks[chunk] = std::move(dot).str();
+            }
+        } catch (...) {
+            std::lock_guard lock{error_mutex};
+            error = std::current_exception();
+            next_chunk = chunk_count;
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        for (unsigned i = 1; i < thread_count; ++i) {
+            workers.emplace_back(render);
+        }
+        render();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    std::ostringstream header;
+    write_dot_header(header, orientation, style);
+    std::ostringstream links;
+    write_dot_links(links, layout.links, orientation, style);
+
+    std::string dot = std::move(header).str();
+    auto tail = std::move(links).str();
+    std::size_t size = dot.size() + tail.size();
+    for (const auto& chunk : chunks) {
+        size += chunk.size();
+    }
+    dot.reserve(size);
+    for (const auto& chunk : chunks) {
+        dot += chunk;
+    }
+    dot += tail;
+    return dot;
+}
+
 template<typename T>
 std::string merge_to_graphviz_dot(const std::vector<std::vector<T>>& lists)
 {
@@ -0,0 +1,216 @@
+#include "merger_daemon.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <print>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Longest command line; a client that sends a longer one is dropped.
+constexpr std::size_t max_line_size = 64 * 1024 * 1024;
+
+// A client whose responses are pending is not read until it takes this much of them.
+constexpr std::size_t max_pending_output = 4 * 1024 * 1024;
+
+struct Client
+{
+    int fd = -1;
+    std::string input{};
+    // Responses that the socket didn't take yet, from output_offset.
+    std::string output{};
+    std::size_t output_offset = 0;
+    // The client sent everything; it is closed once its responses are sent.
+    bool input_closed = false;
+
+    bool has_output() const { return output_offset < output.size(); }
+};
+
+// Sends as much pending output as the socket takes. Returns false if the client is gone.
+bool flush_output(Client& client) {
+    while (client.has_output()) {
+        const auto sent = ::send(client.fd, client.output.data() + client.output_offset,
+                                 client.output.size() - client.output_offset, 0);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client.output_offset += static_cast<std::size_t>(sent);
+    }
+    client.output.clear();
+    client.output_offset = 0;
+    return true;
+}
+
+// Handles complete lines of the client input and queues the responses.
+void handle_input(Client& client, MergerService& service) {
+    std::size_t line_begin = 0;
+    for (auto line_end = client.input.find('\n'); line_end != std::string::npos;
+         line_end = client.input.find('\n', line_begin)) {
+        const std::string_view line{client.input.data() + line_begin, line_end - line_begin};
+        line_begin = line_end + 1;
+        if (line.empty()) continue;
+        client.output += service.handle(line);
+    }
+    client.input.erase(0, line_begin);
+}
+
+/**
+ * Removes the socket of a daemon that is gone, so its path can be bound again.
+ * Any other file, or the socket of a daemon that still accepts connections, is kept.
+ * @return false if the path is taken.
+ */
+bool remove_stale_socket(const std::filesystem::path& socket_path, const sockaddr_un& address) {
+    struct stat status{};
+    if (::lstat(socket_path.c_str(), &status) != 0) {
+        if (errno == ENOENT) return true;
+        std::println(std::cerr, "Error: can't check {}: {}", socket_path.string(), std::strerror(errno));
+        return false;
+    }
+    if (!S_ISSOCK(status.st_mode)) {
+        std::println(std::cerr, "Error: {} exists and isn't a socket", socket_path.string());
+        return false;
+    }
+
+    const int probe_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe_fd < 0) {
+        std::println(std::cerr, "Error: can't create a socket: {}", std::strerror(errno));
+        return false;
+    }
+    const bool connected = ::connect(probe_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    const int connect_error = errno;
+    ::close(probe_fd);
+    if (connected) {
+        std::println(std::cerr, "Error: {} is in use by another daemon", socket_path.string());
+        return false;
+    }
+    // Only a socket that nobody listens on anymore refuses connections.
+    if (connect_error != ECONNREFUSED) {
+        std::println(std::cerr, "Error: can't check {}: {}", socket_path.string(), std::strerror(connect_error));
+        return false;
+    }
+    if (::unlink(socket_path.c_str()) != 0 && errno != ENOENT) {
+        std::println(std::cerr, "Error: can't remove {}: {}", socket_path.string(), std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int run_daemon(const std::filesystem::path& socket_path, MergerService& service) {
+    // A client that disconnects before reading a response must not stop the daemon.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.native().size() >= sizeof(address.sun_path)) {
+        std::println(std::cerr, "Error: socket path is too long: {}", socket_path.string());
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::println(std::cerr, "Error: can't create a socket: {}", std::strerror(errno));
+        return 1;
+    }
+
+    if (!remove_stale_socket(socket_path, address)) {
+        ::close(listen_fd);
+        return 1;
+    }
+    if (::bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(listen_fd, SOMAXCONN) != 0) {
+        std::println(std::cerr, "Error: can't listen on {}: {}", socket_path.string(), std::strerror(errno));
+        ::close(listen_fd);
+        return 1;
+    }
+
+    std::println(std::cerr, "Listening on {}", socket_path.string());
+
+    std::vector<Client> clients;
+    std::vector<pollfd> poll_fds;
+    std::vector<char> buffer(64 * 1024);
+
+    while (true) {
+        poll_fds.clear();
+        poll_fds.push_back(pollfd{listen_fd, POLLIN, 0});
+        for (const auto& client : clients) {
+            // A slow reader is not read until it takes its responses, so its output stays bounded.
+            short events = !client.input_closed && client.output.size() - client.output_offset < max_pending_output ? POLLIN : 0;
+            if (client.has_output()) {
+                events |= POLLOUT;
+            }
+            poll_fds.push_back(pollfd{client.fd, events, 0});
+        }
+
+        if (::poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            std::println(std::cerr, "Error: poll failed: {}", std::strerror(errno));
+            break;
+        }
+
+        // Clients first, so the indices of poll_fds match the clients.
+        for (std::size_t i = clients.size(); i > 0; --i) {
+            const auto& poll_fd = poll_fds[i];
+            if (poll_fd.revents == 0) continue;
+
+            auto& client = clients[i - 1];
+            bool connected = (poll_fd.revents & (POLLERR | POLLNVAL)) == 0;
+            if (connected && (poll_fd.revents & POLLIN)) {
+                const auto received = ::recv(client.fd, buffer.data(), buffer.size(), 0);
+                if (received > 0) {
+                    client.input.append(buffer.data(), static_cast<std::size_t>(received));
+                    handle_input(client, service);
+                    if (client.input.size() > max_line_size) {
+                        std::println(std::cerr, "Error: a command line is longer than {} bytes, the client is dropped", max_line_size);
+                        connected = false;
+                    }
+                } else if (received == 0) {
+                    client.input_closed = true;
+                } else {
+                    connected = errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+            } else if (connected && (poll_fd.revents & POLLHUP) && !client.has_output()) {
+                connected = false;
+            }
+            // Responses are sent without waiting for POLLOUT first, most of them fit the socket buffer.
+            if (connected) {
+                connected = flush_output(client) && !(client.input_closed && !client.has_output());
+            }
+
+            if (!connected) {
+                ::close(client.fd);
+                clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i - 1));
+            }
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            const int client_fd = ::accept(listen_fd, nullptr, nullptr);
+            // Replies are sent without blocking, so a slow client doesn't stall the others.
+            if (client_fd >= 0 && ::fcntl(client_fd, F_SETFL, ::fcntl(client_fd, F_GETFL) | O_NONBLOCK) == 0) {
+                clients.push_back(Client{.fd = client_fd});
+            } else if (client_fd >= 0) {
+                ::close(client_fd);
+            }
+        }
+    }
+
+    for (const auto& client : clients) {
+        ::close(client.fd);
+    }
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+    return 1;
+}
@@ -0,0 +1,16 @@
+#ifndef MERGER_DAEMON_HPP
+#define MERGER_DAEMON_HPP
+
+#include "merger_service.hpp"
+
+#include <filesystem>
+
+/**
+ * Serves MergerService commands on a Unix domain socket until the process is stopped.
+ * Clients are served one command at a time, so all of them see the same tree.
+ *
+ * @return Exit code of the process.
+ */
+int run_daemon(const std::filesystem::path& socket_path, MergerService& service);
+
+#endif // MERGER_DAEMON_HPP
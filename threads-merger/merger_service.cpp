@@ -0,0 +1,143 @@
+#include "merger_service.hpp"
+#include "input_parser.hpp"
+#include "json_export.hpp"
+
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+std::string ok(std::string_view payload = {}) {
+    return "OK " + std::to_string(payload.size()) + "\n" + std::string(payload);
+}
+
+std::string error(std::string_view message) {
+    std::string response = "ERR ";
+    for (const char c : message) {
+        response += c == '\n' ? ' ' : c;
+    }
+    return response + "\n";
+}
+
+// The number of paths of a DOT, JSON or SVG command; 0 without it.
+std::size_t path_count(std::string_view argument) {
+    std::size_t paths = 0;
+    if (!argument.empty()) {
+        const auto [end, error] = std::from_chars(argument.data(), argument.data() + argument.size(), paths);
+        if (error != std::errc{} || end != argument.data() + argument.size() || paths == 0) {
+            throw std::invalid_argument("Invalid number of paths: " + std::string(argument));
+        }
+    }
+    return paths;
+}
+
+} // namespace
+
+MergerService::MergerService(SvgRenderer svg_renderer, std::size_t depth_limit, std::size_t path_capacity,
+                             std::filesystem::path snapshot_dir)
+    : svg_renderer_(std::move(svg_renderer)), depth_limit_(depth_limit), snapshot_dir_(std::move(snapshot_dir))
+{
+    if (path_capacity > 0) {
+        heavy_paths_.emplace(path_capacity, depth_limit);
+    }
+}
+
+const Node<Frame>& MergerService::collapsed_tree(std::size_t paths) {
+    if (paths > 0 && !heavy_paths_) {
+        throw std::invalid_argument("A number of paths requires an approximate tree");
+    }
+    if (!collapsed_ || collapsed_paths_ != paths) {
+        collapsed_ = heavy_paths_ ? heavy_paths_->tree(paths) : tree_;
+        collapsed_paths_ = paths;
+        collapse(*collapsed_);
+    }
+    return *collapsed_;
+}
+
+std::string MergerService::dot_graph(std::size_t paths, DotStyle style) {
+    auto dot = get_dot_graph(collapsed_tree(paths), Orientation::CallerRooted, style);
+    if (heavy_paths_) {
+        // Before the closing brace of the graph.
+        dot.insert(dot.size() - 2, std::format("  label=\"Counts are at most {} too high, of {} stacks\";\n  labelloc=t;\n",
+                                               heavy_paths_->max_error(), heavy_paths_->total()));
+    }
+    return dot;
+}
+
+std::vector<JsonField> MergerService::error_fields() const {
+    if (!heavy_paths_) {
+        return {};
+    }
+    return {{"max_error", heavy_paths_->max_error()}, {"total", heavy_paths_->total()}};
+}
+
+std::string MergerService::handle(std::string_view command) {
+    if (command.ends_with('\r')) {
+        command.remove_suffix(1);
+    }
+
+    const auto space = command.find(' ');
+    const auto name = command.substr(0, space);
+    const auto argument = space == std::string_view::npos ? std::string_view{} : command.substr(space + 1);
+
+    try {
+        if (name == "PUSH") {
+            collapsed_.reset();
+            for (const auto& stack : parse_input_frames(argument)) {
+                if (heavy_paths_) {
+                    heavy_paths_->add_stack(stack);
+                } else {
+                    add_stack(tree_, stack, depth_limit_);
+                }
+            }
+            return ok();
+        }
+        if (name == "DOT") {
+            return ok(dot_graph(path_count(argument), DotStyle::Verbose));
+        }
+        if (name == "JSON") {
+            return ok(get_json_tree(collapsed_tree(path_count(argument)), error_fields()));
+        }
+        if (name == "SVG") {
+            if (!svg_renderer_) {
+                return error("SVG rendering is not available");
+            }
+            return ok(svg_renderer_(dot_graph(path_count(argument), DotStyle::Compact)));
+        }
+        if (name == "RESET") {
+            collapsed_.reset();
+            tree_ = Node<Frame>{};
+            if (heavy_paths_) {
+                heavy_paths_->clear();
+            }
+            return ok();
+        }
+        if (name == "SNAPSHOT") {
+            if (snapshot_dir_.empty()) {
+                return error("Snapshots are not enabled");
+            }
+            // A bare file name, so a client can't write outside the snapshot directory.
+            if (argument.empty() || argument == "." || argument == ".." || argument.find('/') != std::string_view::npos) {
+                return error("SNAPSHOT requires a file name");
+            }
+            // Written to a temporary file first, so readers never see a partial snapshot.
+            const auto path = snapshot_dir_ / argument;
+            auto temporary_path = path;
+            temporary_path += ".tmp";
+            {
+                std::ofstream file{temporary_path};
+                if (!file) {
+                    return error("Can't write " + temporary_path.string());
+                }
+                write_json_tree(file, collapsed_tree(), std::pmr::get_default_resource(), error_fields());
+            }
+            std::filesystem::rename(temporary_path, path);
+            return ok();
+        }
+        return error("Unknown command: " + std::string(name));
+    } catch (const std::exception& ex) {
+        return error(ex.what());
+    }
+}
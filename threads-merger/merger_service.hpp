@@ -0,0 +1,74 @@
+#ifndef MERGER_SERVICE_HPP
+#define MERGER_SERVICE_HPP
+
+#include "merger.hpp"
+#include "heavy_paths.hpp"
+#include "json_export.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * A merged tree that is updated incrementally and queried by text commands.
+ *
+ * Commands, one per line:
+ *
+ *     PUSH <stacks>      Adds stacks in the format 'func:file:line:col, ...; ...'.
+ *     DOT | JSON | SVG [<k>]
+ *                        Returns the merged tree, of the k heaviest paths of an approximate tree.
+ *     RESET              Removes all stacks.
+ *     SNAPSHOT <name>    Writes the merged tree as JSON to the file in the snapshot directory.
+ *
+ * The counts of an approximate tree are upper bounds: a DOT or SVG graph is labeled with the bound
+ * of their error and the number of stacks, JSON has them in the root fields "max_error" and "total".
+ *
+ * Responses:
+ *
+ *     OK <payload size>\n<payload>
+ *     ERR <message>\n
+ */
+class MergerService
+{
+public:
+    using SvgRenderer = std::function<std::string(const std::string& dot)>;
+
+    /**
+     * @param svg_renderer Renders DOT to SVG. Without it the SVG command fails.
+     * @param depth_limit Maximum depth to merge from each stack; 0 means no depth limit.
+     * @param path_capacity Maximum number of paths of an approximate tree, see HeavyPaths;
+     * 0 means an exact tree.
+     * @param snapshot_dir Directory of the SNAPSHOT files. Without it the SNAPSHOT command fails,
+     * so clients can't write anywhere else.
+     */
+    explicit MergerService(SvgRenderer svg_renderer = {}, std::size_t depth_limit = 0, std::size_t path_capacity = 0,
+                           std::filesystem::path snapshot_dir = {});
+
+    // Handles one command without the line break and returns the response.
+    std::string handle(std::string_view command);
+
+    std::size_t thread_count() const { return heavy_paths_ ? heavy_paths_->total() : tree_.count; }
+
+private:
+    SvgRenderer svg_renderer_;
+    std::size_t depth_limit_;
+    std::filesystem::path snapshot_dir_;
+    // Stacks are added to a tree that is not collapsed. Queries collapse a copy.
+    Node<Frame> tree_;
+    // Replaces the tree for endless streams of stacks.
+    std::optional<HeavyPaths<Frame>> heavy_paths_;
+    // The collapsed copy of the heaviest collapsed_paths_ paths, or of all, until the next PUSH or RESET.
+    std::optional<Node<Frame>> collapsed_;
+    std::size_t collapsed_paths_ = 0;
+
+    // @param paths Number of the heaviest paths of an approximate tree; 0 means all.
+    const Node<Frame>& collapsed_tree(std::size_t paths = 0);
+    std::string dot_graph(std::size_t paths, DotStyle style);
+    // The root fields of the JSON of an approximate tree.
+    std::vector<JsonField> error_fields() const;
+};
+
+#endif // MERGER_SERVICE_HPP
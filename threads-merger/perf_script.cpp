@@ -0,0 +1,196 @@
+#include "perf_script.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <string_view>
+
+namespace {
+
+bool is_space(const char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+std::string_view trim(std::string_view sv) {
+    while (!sv.empty() && is_space(sv.front())) sv.remove_prefix(1);
+    while (!sv.empty() && is_space(sv.back())) sv.remove_suffix(1);
+    return sv;
+}
+
+std::string_view next_token(std::string_view& sv) {
+    sv = trim(sv);
+    std::size_t end = 0;
+    while (end < sv.size() && !is_space(sv[end])) ++end;
+    const auto token = sv.substr(0, end);
+    sv.remove_prefix(end);
+    return token;
+}
+
+bool parse_int(const std::string_view text, int& value) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size() && !text.empty();
+}
+
+bool is_hex(const std::string_view text) {
+    if (text.empty()) {
+        return false;
+    }
+    for (const char c : text) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Parses "comm pid/tid ..." or "comm tid ...", the fields that follow are ignored.
+ * The command may contain spaces, so it ends before the first numeric token.
+ */
+bool parse_header(const std::string_view line, PerfSample& sample) {
+    std::string_view rest = line;
+    next_token(rest);
+    while (!rest.empty()) {
+        const auto before = rest;
+        const auto token = next_token(rest);
+        const auto slash = token.find('/');
+        int pid = 0;
+        int tid = 0;
+        const bool matched = slash == std::string_view::npos
+            ? parse_int(token, tid)
+            : parse_int(token.substr(0, slash), pid) && parse_int(token.substr(slash + 1), tid);
+        if (matched) {
+            sample.comm.assign(trim(line.substr(0, line.size() - before.size())));
+            sample.pid = pid;
+            sample.tid = tid;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Parses "address symbol+offset (dso)". The symbol may contain spaces and parentheses,
+ * e.g. of C++ signatures, so the DSO is in the last parentheses.
+ * Lines of other fields, e.g. of source lines, are not frames.
+ */
+bool parse_frame(std::string_view line, Frame& frame) {
+    const auto address = next_token(line);
+    if (!is_hex(address)) {
+        return false;
+    }
+    line = trim(line);
+
+    std::string_view dso;
+    if (line.ends_with(')')) {
+        if (const auto open = line.rfind(" ("); open != std::string_view::npos) {
+            dso = line.substr(open + 2, line.size() - open - 3);
+            line = trim(line.substr(0, open));
+        } else if (line.starts_with('(')) {
+            dso = line.substr(1, line.size() - 2);
+            line = {};
+        }
+    }
+    if (const auto slash = dso.rfind('/'); slash != std::string_view::npos && !dso.starts_with('[')) {
+        dso.remove_prefix(slash + 1);
+    }
+
+    if (const auto plus = line.rfind("+0x"); plus != std::string_view::npos && is_hex(line.substr(plus + 3))) {
+        line = line.substr(0, plus);
+    }
+
+    // Unknown symbols are kept apart by their addresses.
+    if (line.empty() || line == "[unknown]") {
+        frame.function.assign("0x");
+        frame.function.append(address);
+    } else {
+        frame.function.assign(line);
+    }
+    frame.filename.assign(dso);
+    frame.row = 0;
+    frame.column = 0;
+    return true;
+}
+
+} // namespace
+
+PerfScriptReader::PerfScriptReader(std::istream& input, const PerfGrouping grouping, const Orientation orientation)
+    : input_(input)
+    , grouping_(grouping)
+    , orientation_(orientation)
+{}
+
+bool PerfScriptReader::next(PerfSample& sample)
+{
+    while (true) {
+        // Find the header of a sample.
+        bool found = false;
+        while (header_pending_ || std::getline(input_, line_)) {
+            header_pending_ = false;
+            if (!line_.empty() && !is_space(line_.front()) && line_.front() != '#' && parse_header(line_, sample)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+
+        // Frames are assigned in place, so their strings keep their memory between samples.
+        std::size_t depth = 0;
+        while (std::getline(input_, line_)) {
+            if (trim(line_).empty()) {
+                break;
+            }
+            if (!is_space(line_.front())) {
+                header_pending_ = true;
+                break;
+            }
+            if (depth == sample.stack.size()) {
+                sample.stack.emplace_back();
+            }
+            if (parse_frame(line_, sample.stack[depth])) {
+                ++depth;
+            }
+        }
+        if (depth == 0) {
+            continue;
+        }
+
+        if (grouping_ != PerfGrouping::None) {
+            if (depth == sample.stack.size()) {
+                sample.stack.emplace_back();
+            }
+            auto& group = sample.stack[depth++];
+            group.function.assign(sample.comm);
+            if (grouping_ == PerfGrouping::Thread) {
+                group.function.append("/").append(std::to_string(sample.tid));
+            }
+            group.filename.clear();
+            group.row = 0;
+            group.column = 0;
+            if (orientation_ == Orientation::CalleeRooted) {
+                std::rotate(sample.stack.begin(), sample.stack.begin() + depth - 1, sample.stack.begin() + depth);
+            }
+        }
+        sample.stack.resize(depth);
+        return true;
+    }
+}
+
+std::size_t add_perf_script(
+    Node<Frame>& root,
+    std::istream& input,
+    const PerfGrouping grouping,
+    const std::size_t depth_limit,
+    const Orientation orientation)
+{
+    PerfScriptReader reader{input, grouping, orientation};
+    PerfSample sample;
+    std::size_t count = 0;
+    while (reader.next(sample)) {
+        add_stack(root, sample.stack, depth_limit, orientation);
+        ++count;
+    }
+    return count;
+}
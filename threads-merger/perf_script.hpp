@@ -0,0 +1,82 @@
+#ifndef PERF_SCRIPT_HPP
+#define PERF_SCRIPT_HPP
+
+#include "merger.hpp"
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+/*
+ * Reader of the output of `perf script` for samples recorded with call graphs (`perf record -g`).
+ *
+ * A sample is a header line "comm pid/tid [cpu] time: period event:" followed by indented frames
+ * "address symbol+offset (dso)" from the innermost one, and an empty line. Samples are read one
+ * by one from a stream, so an input of any size is read in constant memory.
+ */
+
+/*
+ * Roots of the stacks of samples. A group frame is added at the root end of a stack: after the
+ * outermost frame of a caller-rooted tree, before the innermost frame of a callee-rooted one.
+ */
+enum class PerfGrouping
+{
+    // The frames at the root end.
+    None,
+    // A frame "comm/tid" for each thread.
+    Thread,
+    // A frame "comm" for each command.
+    Command,
+};
+
+struct PerfSample
+{
+    std::string comm;
+    int pid = 0;
+    int tid = 0;
+    // From the innermost frame, with a group frame at the root end, see PerfGrouping. Functions are
+    // symbols without offsets, or addresses of unknown symbols; filenames are the names of the DSOs.
+    std::vector<Frame> stack;
+};
+
+class PerfScriptReader
+{
+public:
+    /**
+     * @param input Must outlive the reader.
+     * @param orientation Orientation of the tree of the samples, the end of the group frames.
+     */
+    explicit PerfScriptReader(
+        std::istream& input,
+        PerfGrouping grouping = PerfGrouping::None,
+        Orientation orientation = Orientation::CallerRooted);
+
+    /**
+     * Reads the next sample with frames; samples without frames are skipped.
+     * The sample is overwritten, so its memory is reused.
+     * @return false at the end of the input.
+     */
+    bool next(PerfSample& sample);
+
+private:
+    std::istream& input_;
+    PerfGrouping grouping_;
+    Orientation orientation_;
+    std::string line_;
+    // The header of the next sample was read with the frames of the previous one.
+    bool header_pending_ = false;
+};
+
+/**
+ * Adds the samples of `perf script` output to a tree that is not collapsed yet, see add_stack().
+ * @return Number of added samples.
+ */
+std::size_t add_perf_script(
+    Node<Frame>& root,
+    std::istream& input,
+    PerfGrouping grouping = PerfGrouping::None,
+    std::size_t depth_limit = 0,
+    Orientation orientation = Orientation::CallerRooted);
+
+#endif // PERF_SCRIPT_HPP
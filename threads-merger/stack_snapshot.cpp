@@ -0,0 +1,417 @@
+#include "stack_snapshot.hpp"
+#include "unwinder/unwinder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <print>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+constexpr auto native_architecture = Unwind::Architecture::X86_64;
+constexpr std::uint32_t stack_pointer_register = 7;
+#elif defined(__aarch64__)
+constexpr auto native_architecture = Unwind::Architecture::AArch64;
+constexpr std::uint32_t stack_pointer_register = 31;
+#else
+#error "Stack snapshots support x86-64 and AArch64 only"
+#endif
+
+namespace Snapshot {
+
+namespace {
+
+constexpr std::size_t page_size = 4096;
+
+/*
+ * The thread that is interrupted now, and the buffers for its registers and stack.
+ * Only the signal handler of the thread writes the buffers.
+ */
+struct Capture
+{
+    // The thread that has to copy its stack; 0 if none. The handler takes the capture by resetting it.
+    std::atomic<pid_t> tid{0};
+    Unwind::Registers registers;
+    std::uint64_t stack_address = 0;
+    std::size_t stack_size = 0;
+    std::vector<std::byte> stack;
+    // One element for each page of the copied stack, so a copy stops at the first unmapped page.
+    std::vector<iovec> pages;
+    sem_t done;
+};
+
+std::atomic<Capture*> active_capture{nullptr};
+
+pid_t current_tid() {
+    return static_cast<pid_t>(::syscall(SYS_gettid));
+}
+
+void copy_registers(const ucontext_t& context, Unwind::Registers& registers) {
+#if defined(__x86_64__)
+    // By DWARF numbers: rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8–r15.
+    constexpr int gregs[] = {
+        REG_RAX, REG_RDX, REG_RCX, REG_RBX, REG_RSI, REG_RDI, REG_RBP, REG_RSP,
+        REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+    };
+    for (std::uint32_t i = 0; i < std::size(gregs); ++i) {
+        registers.set(i, static_cast<std::uint64_t>(context.uc_mcontext.gregs[gregs[i]]));
+    }
+    registers.pc = static_cast<std::uint64_t>(context.uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    // x0–x30 and sp have the same DWARF numbers.
+    for (std::uint32_t i = 0; i < 31; ++i) {
+        registers.set(i, context.uc_mcontext.regs[i]);
+    }
+    registers.set(31, context.uc_mcontext.sp);
+    registers.pc = context.uc_mcontext.pc;
+#endif
+}
+
+// Async-signal-safe: no allocations, no locks, only system calls.
+void copy_stack(int, siginfo_t*, void* context) {
+    const auto saved_errno = errno;
+
+    auto* capture = active_capture.load(std::memory_order_acquire);
+    auto tid = current_tid();
+    if (capture && capture->tid.compare_exchange_strong(tid, 0, std::memory_order_acq_rel)) {
+        capture->registers = {};
+        copy_registers(*static_cast<const ucontext_t*>(context), capture->registers);
+        capture->stack_address = capture->registers.values[stack_pointer_register];
+
+        // The stack is read with a system call, which fails on unmapped pages instead of crashing.
+        auto address = capture->stack_address;
+        auto left = capture->stack.size();
+        std::size_t count = 0;
+        while (left > 0 && count < capture->pages.size()) {
+            const auto size = std::min<std::uint64_t>(left, page_size - address % page_size);
+            capture->pages[count++] = iovec{reinterpret_cast<void*>(address), size};
+            address += size;
+            left -= size;
+        }
+        iovec local{capture->stack.data(), capture->stack.size()};
+        const auto copied = ::process_vm_readv(::getpid(), &local, 1, capture->pages.data(), count, 0);
+        capture->stack_size = copied > 0 ? static_cast<std::size_t>(copied) : 0;
+
+        ::sem_post(&capture->done);
+    }
+
+    errno = saved_errno;
+}
+
+// The copied top of the stack of a thread.
+class CopiedStack : public Unwind::Memory
+{
+public:
+    void assign(std::uint64_t address, const std::byte* data, std::size_t size) {
+        address_ = address;
+        data_ = data;
+        size_ = size;
+    }
+
+    std::optional<std::uint64_t> read_u64(std::uint64_t address) const override {
+        if (address < address_ || address - address_ > size_ || size_ - (address - address_) < sizeof(std::uint64_t)) {
+            return std::nullopt;
+        }
+        std::uint64_t value = 0;
+        std::memcpy(&value, data_ + (address - address_), sizeof(value));
+        return value;
+    }
+
+private:
+    std::uint64_t address_ = 0;
+    const std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+std::vector<pid_t> thread_ids() {
+    std::vector<pid_t> tids;
+    for (const auto& entry : std::filesystem::directory_iterator{"/proc/self/task"}) {
+        const auto name = entry.path().filename().string();
+        pid_t tid = 0;
+        const auto [end, error] = std::from_chars(name.data(), name.data() + name.size(), tid);
+        if (error == std::errc{} && end == name.data() + name.size()) {
+            tids.push_back(tid);
+        }
+    }
+    std::ranges::sort(tids);
+    return tids;
+}
+
+} // namespace
+
+struct StackSnapshotter::State
+{
+    Options options;
+    int signal = 0;
+    struct sigaction previous{};
+    Capture capture;
+
+    std::mutex mutex;
+    CopiedStack memory;
+    // The unwinder is created again when the mappings change.
+    std::string maps;
+    std::unique_ptr<Unwind::Unwinder> unwinder;
+    std::size_t missed_threads = 0;
+
+    // The symbolizer is created again when the mappings change; the loaded modules are kept.
+    std::mutex symbolizer_mutex;
+    std::shared_ptr<SymbolModules> symbol_modules;
+    std::string symbolizer_maps;
+    std::unique_ptr<Symbolizer> symbolizer;
+
+    // Returns false if the thread exited or didn't answer in time.
+    bool interrupt(pid_t tid);
+};
+
+StackSnapshotter::StackSnapshotter(Options options)
+    : state_(std::make_unique<State>())
+{
+    state_->options = std::move(options);
+    state_->signal = state_->options.signal != 0 ? state_->options.signal : SIGRTMIN + 3;
+    state_->symbol_modules = std::make_shared<SymbolModules>(state_->options.symbol_cache_dir);
+
+    auto& capture = state_->capture;
+    capture.stack.resize(state_->options.stack_bytes);
+    capture.pages.resize(std::min<std::size_t>(state_->options.stack_bytes / page_size + 2, IOV_MAX));
+    if (::sem_init(&capture.done, 0, 0) != 0) {
+        throw std::system_error(errno, std::generic_category(), "sem_init");
+    }
+
+    Capture* expected = nullptr;
+    if (!active_capture.compare_exchange_strong(expected, &capture)) {
+        ::sem_destroy(&capture.done);
+        throw std::logic_error("Only one StackSnapshotter may exist at a time");
+    }
+
+    struct sigaction action{};
+    action.sa_sigaction = copy_stack;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (::sigaction(state_->signal, &action, &state_->previous) != 0) {
+        const auto error = errno;
+        active_capture.store(nullptr);
+        ::sem_destroy(&capture.done);
+        throw std::system_error(error, std::generic_category(), "sigaction");
+    }
+}
+
+StackSnapshotter::~StackSnapshotter()
+{
+    // A signal of a thread that didn't answer in time may still come.
+    auto previous = state_->previous;
+    if (!(previous.sa_flags & SA_SIGINFO) && previous.sa_handler == SIG_DFL) {
+        previous.sa_handler = SIG_IGN;
+    }
+    ::sigaction(state_->signal, &previous, nullptr);
+    active_capture.store(nullptr);
+    ::sem_destroy(&state_->capture.done);
+}
+
+bool StackSnapshotter::State::interrupt(pid_t tid)
+{
+    capture.tid.store(tid, std::memory_order_release);
+    if (::syscall(SYS_tgkill, ::getpid(), tid, signal) != 0) {
+        capture.tid.store(0);
+        return false;
+    }
+
+    timespec deadline{};
+    ::clock_gettime(CLOCK_REALTIME, &deadline);
+    const auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(options.thread_timeout).count();
+    deadline.tv_sec += static_cast<time_t>(timeout / 1'000'000'000);
+    deadline.tv_nsec += static_cast<long>(timeout % 1'000'000'000);
+    if (deadline.tv_nsec >= 1'000'000'000) {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1'000'000'000;
+    }
+
+    while (::sem_timedwait(&capture.done, &deadline) != 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        // If the handler took the capture meanwhile, it is about to finish it.
+        pid_t expected = tid;
+        if (capture.tid.compare_exchange_strong(expected, 0)) {
+            ++missed_threads;
+            return false;
+        }
+        while (::sem_wait(&capture.done) != 0 && errno == EINTR) {
+        }
+        break;
+    }
+    return true;
+}
+
+ThreadStacks StackSnapshotter::capture()
+{
+    std::lock_guard lock{state_->mutex};
+    auto& state = *state_;
+    state.missed_threads = 0;
+
+    auto maps = read_file("/proc/self/maps");
+    if (!state.unwinder || maps != state.maps) {
+        std::istringstream maps_stream{maps};
+        state.unwinder = std::make_unique<Unwind::Unwinder>(native_architecture, state.memory, parse_proc_maps(maps_stream));
+        state.maps = std::move(maps);
+    }
+
+    ThreadStacks result;
+    const auto self = current_tid();
+    for (const auto tid : thread_ids()) {
+        if (result.stacks.size() >= state.options.max_threads) {
+            break;
+        }
+        if (tid == self || !state.interrupt(tid)) {
+            continue;
+        }
+        const auto& capture = state.capture;
+        state.memory.assign(capture.stack_address, capture.stack.data(), capture.stack_size);
+        auto frames = state.unwinder->unwind(capture.registers, state.options.max_frames);
+        if (!frames.empty()) {
+            result.stacks.push_back(std::move(frames));
+            result.thread_ids.push_back(tid);
+        }
+    }
+    result.missed_threads = state.missed_threads;
+    return result;
+}
+
+Node<SymbolizedAddress> StackSnapshotter::merged_tree(Orientation orientation)
+{
+    const auto tree = merge<std::uint64_t>(capture().stacks, orientation);
+
+    std::lock_guard lock{state_->symbolizer_mutex};
+    auto& state = *state_;
+    auto maps = read_file("/proc/self/maps");
+    if (!state.symbolizer || maps != state.symbolizer_maps) {
+        state.symbolizer = std::make_unique<Symbolizer>(state.symbol_modules);
+        std::istringstream maps_stream{maps};
+        state.symbolizer->load_proc_maps(maps_stream);
+        state.symbolizer_maps = std::move(maps);
+    }
+    return symbolize_tree(tree, *state.symbolizer);
+}
+
+std::string StackSnapshotter::dot_graph(Orientation orientation)
+{
+    return get_dot_graph(merged_tree(orientation), orientation);
+}
+
+
+namespace {
+
+// Write end of the pipe of the active dumper; -1 if none.
+std::atomic<int> dump_fd{-1};
+
+void request_dump(int) {
+    const auto saved_errno = errno;
+    const auto fd = dump_fd.load(std::memory_order_acquire);
+    if (fd >= 0) {
+        const char request = 'd';
+        [[maybe_unused]] const auto written = ::write(fd, &request, 1);
+    }
+    errno = saved_errno;
+}
+
+} // namespace
+
+struct DumpOnSignal::State
+{
+    int signal = 0;
+    struct sigaction previous{};
+    int pipe[2] = {-1, -1};
+    std::jthread thread;
+};
+
+DumpOnSignal::DumpOnSignal(StackSnapshotter& snapshotter, int signal, std::filesystem::path path)
+    : state_(std::make_unique<State>())
+{
+    state_->signal = signal;
+    if (::pipe2(state_->pipe, O_CLOEXEC) != 0) {
+        throw std::system_error(errno, std::generic_category(), "pipe2");
+    }
+    // The signal handler must not block. Requests that come while the pipe is full are not needed.
+    ::fcntl(state_->pipe[1], F_SETFL, O_NONBLOCK);
+
+    int expected = -1;
+    if (!dump_fd.compare_exchange_strong(expected, state_->pipe[1])) {
+        ::close(state_->pipe[0]);
+        ::close(state_->pipe[1]);
+        throw std::logic_error("Only one DumpOnSignal may exist at a time");
+    }
+
+    state_->thread = std::jthread{[&snapshotter, path = std::move(path), fd = state_->pipe[0]]() {
+        // The requests that came during a dump are served with one more dump.
+        char requests[64];
+        for (;;) {
+            const auto size = ::read(fd, requests, sizeof(requests));
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0 || std::memchr(requests, 'q', static_cast<std::size_t>(size))) {
+                break;
+            }
+            auto temporary = path;
+            temporary += ".tmp";
+            try {
+                {
+                    std::ofstream out{temporary, std::ios::binary};
+                    if (!out) {
+                        throw std::runtime_error("Can't create output file: '" + temporary.string() + "'");
+                    }
+                    out << snapshotter.dot_graph();
+                }
+                std::filesystem::rename(temporary, path);
+            } catch (const std::exception& ex) {
+                std::println(std::cerr, "Error: can't dump stacks: {}", ex.what());
+            }
+        }
+    }};
+
+    struct sigaction action{};
+    action.sa_handler = request_dump;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(signal, &action, &state_->previous);
+}
+
+DumpOnSignal::~DumpOnSignal()
+{
+    ::sigaction(state_->signal, &state_->previous, nullptr);
+    dump_fd.store(-1);
+
+    // The thread finishes the dump it takes, if any, and stops. The stop request waits for room in the pipe.
+    ::fcntl(state_->pipe[1], F_SETFL, 0);
+    const char stop = 'q';
+    while (::write(state_->pipe[1], &stop, 1) != 1 && errno == EINTR) {
+    }
+    state_->thread.join();
+    ::close(state_->pipe[0]);
+    ::close(state_->pipe[1]);
+}
+
+} // namespace Snapshot
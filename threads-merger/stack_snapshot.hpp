@@ -0,0 +1,103 @@
+#pragma once
+
+#include "merger.hpp"
+#include "symbolizer.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Snapshots of the stacks of all threads of the own process, e.g. for a service that dumps its
+ * merged stacks on demand without a debugger.
+ *
+ * The threads are interrupted by a signal one by one. The signal handler only copies the registers
+ * and the top of the stack of its thread into buffers allocated in advance, which is
+ * async-signal-safe and takes microseconds. The copies are unwound with the call frame information
+ * afterwards, off the signal path, then merged and rendered as usual. As with any signal, system
+ * calls that are not restarted after a handler, like nanosleep(), fail with EINTR in the threads.
+ *
+ * Linux on x86-64 and AArch64 only.
+ */
+
+namespace Snapshot {
+
+struct Options
+{
+    // Signal that interrupts the threads; 0 means SIGRTMIN + 3. The process must not use it otherwise.
+    int signal = 0;
+    // Maximum number of threads in a snapshot, the others are skipped.
+    std::size_t max_threads = 4096;
+    // Bytes copied from the stack pointer of a thread. Deeper frames are cut.
+    std::size_t stack_bytes = 64 * 1024;
+    std::size_t max_frames = 256;
+    // Time to wait for a thread, e.g. one that blocks the signal.
+    std::chrono::milliseconds thread_timeout{100};
+    // Directory of the symbol cache; empty means no cache.
+    std::filesystem::path symbol_cache_dir{};
+};
+
+// Stacks of the threads of one snapshot.
+struct ThreadStacks
+{
+    // Stacks of program counters from the innermost frame, ready for merge<std::uint64_t>().
+    std::vector<std::vector<std::uint64_t>> stacks;
+    // Thread IDs of the stacks, in the same order, e.g. for StuckThreads.
+    std::vector<int> thread_ids;
+    // Number of threads that didn't answer in time.
+    std::size_t missed_threads = 0;
+};
+
+class StackSnapshotter
+{
+public:
+    // Installs the signal handler. Only one snapshotter may exist at a time.
+    explicit StackSnapshotter(Options options = {});
+    // Restores the previous signal handler, or ignores the signal if it had the default action.
+    ~StackSnapshotter();
+
+    StackSnapshotter(const StackSnapshotter&) = delete;
+    StackSnapshotter& operator=(const StackSnapshotter&) = delete;
+
+    // Takes a snapshot of all threads except the calling one. Snapshots are taken one at a time.
+    ThreadStacks capture();
+
+    // Takes a snapshot, merges and symbolizes it.
+    Node<SymbolizedAddress> merged_tree(Orientation orientation = Orientation::CallerRooted);
+
+    // Takes a snapshot and renders it with get_dot_graph().
+    std::string dot_graph(Orientation orientation = Orientation::CallerRooted);
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+/**
+ * Writes the DOT graph of a snapshot to a file whenever the process gets a signal, e.g. SIGUSR2.
+ * The signal handler only wakes a background thread, which takes the snapshot.
+ * Only one dumper may exist at a time.
+ */
+class DumpOnSignal
+{
+public:
+    /**
+     * @param snapshotter Must outlive the dumper.
+     * @param path The file is replaced with each dump.
+     */
+    DumpOnSignal(StackSnapshotter& snapshotter, int signal, std::filesystem::path path);
+    // Restores the previous signal handler.
+    ~DumpOnSignal();
+
+    DumpOnSignal(const DumpOnSignal&) = delete;
+    DumpOnSignal& operator=(const DumpOnSignal&) = delete;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+} // namespace Snapshot
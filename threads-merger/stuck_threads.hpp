@@ -0,0 +1,152 @@
+#ifndef STUCK_THREADS_HPP
+#define STUCK_THREADS_HPP
+
+#include "merger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Threads whose stacks don't change across consecutive snapshots of a process, e.g. deadlocked
+ * or stalled ones.
+ *
+ * Only a hash of the stack of each thread is kept between snapshots, so a snapshot costs one pass
+ * over its frames and memory doesn't depend on the depth of the stacks. A hash collision would
+ * take a changed stack for the same one, which is negligible with 64-bit hashes.
+ */
+template<typename T>
+class StuckThreads
+{
+public:
+    using Clock = std::chrono::system_clock;
+
+    struct Thread
+    {
+        int tid = 0;
+        // Number of the last consecutive snapshots with the same stack.
+        std::size_t snapshots = 0;
+        // Time from the first of these snapshots to the last one.
+        Clock::duration duration{};
+        // Index of the stack in the last snapshot.
+        std::size_t stack = 0;
+    };
+
+    /**
+     * @param snapshots Number of consecutive snapshots with the same stack that make a thread stuck,
+     * at least 2.
+     */
+    explicit StuckThreads(const std::size_t snapshots)
+        : min_snapshots_(snapshots)
+    {
+        if (snapshots < 2) {
+            throw std::invalid_argument("A thread is stuck in at least 2 snapshots");
+        }
+    }
+
+    /**
+     * Adds the next snapshot, where tids[i] is the thread of stacks[i].
+     * The threads that are not in the snapshot are forgotten.
+     */
+    void add_snapshot(std::span<const int> tids, const std::vector<std::vector<T>>& stacks, const Clock::time_point time = Clock::now())
+    {
+        if (tids.size() != stacks.size()) {
+            throw std::invalid_argument("Each stack of a snapshot needs a thread ID");
+        }
+
+        ++generation_;
+        stuck_.clear();
+        for (std::size_t i = 0; i < stacks.size(); ++i) {
+            const auto hash = stack_hash(stacks[i]);
+            auto [it, inserted] = threads_.try_emplace(tids[i], State{hash, 0, time, generation_});
+            auto& state = it->second;
+            if (inserted || state.generation != generation_ - 1 || state.hash != hash) {
+                state = State{hash, 1, time, generation_};
+                continue;
+            }
+            state.generation = generation_;
+            if (++state.snapshots >= min_snapshots_) {
+                stuck_.push_back(Thread{tids[i], state.snapshots, time - state.since, i});
+            }
+        }
+        std::erase_if(threads_, [this](const auto& item) { return item.second.generation != generation_; });
+
+        std::ranges::sort(stuck_, [](const Thread& a, const Thread& b) {
+            return a.snapshots != b.snapshots ? a.snapshots > b.snapshots : a.tid < b.tid;
+        });
+    }
+
+    // Stuck threads of the last snapshot, the longest stuck first.
+    const std::vector<Thread>& stuck() const { return stuck_; }
+
+    // Number of threads of the last snapshot.
+    std::size_t size() const { return threads_.size(); }
+
+private:
+    struct State
+    {
+        std::size_t hash = 0;
+        std::size_t snapshots = 0;
+        Clock::time_point since;
+        // Number of the last snapshot with the thread.
+        std::size_t generation = 0;
+    };
+
+    static std::size_t stack_hash(const std::vector<T>& stack)
+    {
+        auto hash = stack.size();
+        for (const auto& frame : stack) {
+            std::hash_combine(hash, std::hash<T>{}(frame));
+        }
+        return hash;
+    }
+
+    std::size_t min_snapshots_;
+    std::size_t generation_ = 0;
+    std::unordered_map<int, State> threads_;
+    std::vector<Thread> stuck_;
+};
+
+/**
+ * Merges the stacks of the stuck threads of the last snapshot with merge<Frame>(). Each stack gets
+ * a frame "stuck for <seconds> s, <snapshots> snapshots" at the root end for the orientation, so
+ * threads that got stuck together, e.g. in a deadlock, share a root.
+ *
+ * @param stacks The last snapshot.
+ * @param to_frame Converts a frame of the snapshot to Frame.
+ */
+template<typename T, typename ToFrame>
+Node<Frame> merge_stuck_threads(
+    const StuckThreads<T>& threads,
+    const std::vector<std::vector<T>>& stacks,
+    ToFrame&& to_frame,
+    const Orientation orientation = Orientation::CallerRooted)
+{
+    std::vector<std::vector<Frame>> lists;
+    lists.reserve(threads.stuck().size());
+    for (const auto& thread : threads.stuck()) {
+        auto& list = lists.emplace_back();
+        list.reserve(stacks[thread.stack].size() + 1);
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(thread.duration).count();
+        Frame stuck{std::format("stuck for {} s, {} snapshots", seconds, thread.snapshots), "", 0, 0};
+        if (orientation == Orientation::CalleeRooted) {
+            list.push_back(std::move(stuck));
+        }
+        for (const auto& frame : stacks[thread.stack]) {
+            list.push_back(std::invoke(to_frame, frame));
+        }
+        if (orientation == Orientation::CallerRooted) {
+            list.push_back(std::move(stuck));
+        }
+    }
+    return merge(lists, orientation);
+}
+
+#endif // STUCK_THREADS_HPP
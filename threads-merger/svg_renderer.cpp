@@ -0,0 +1,43 @@
+#include "svg_renderer.hpp"
+
+#include <graphviz/gvc.h>
+#include <graphviz/cgraph.h>
+
+SvgRenderer::SvgRenderer()
+    : gvc_(gvContext()) {}
+
+SvgRenderer::~SvgRenderer() {
+    if (gvc_) {
+        gvFreeContext(gvc_);
+    }
+}
+
+std::string SvgRenderer::render(const std::string& dot_content) {
+    if (!gvc_) {
+        return "Error: Failed to create Graphviz context";
+    }
+
+    Agraph_t* graph = agmemread(const_cast<char*>(dot_content.c_str()));
+    if (!graph) {
+        return "Error: Failed to parse DOT content";
+    }
+
+    gvLayout(gvc_, graph, "dot");
+
+    char* svg_data = nullptr;
+    size_t svg_length = 0;
+    gvRenderData(gvc_, graph, "svg", (char**)&svg_data, &svg_length);
+
+    std::string svg_result;
+    if (svg_data && svg_length > 0) {
+        svg_result = std::string(svg_data, svg_length);
+        gvFreeRenderData(svg_data);
+    } else {
+        svg_result = "Error: Failed to generate SVG";
+    }
+
+    gvFreeLayout(gvc_, graph);
+    agclose(graph);
+
+    return svg_result;
+}
@@ -0,0 +1,28 @@
+#ifndef SVG_RENDERER_HPP
+#define SVG_RENDERER_HPP
+
+#include <string>
+
+struct GVC_s;
+
+/*
+ * Renders DOT to SVG with Graphviz. The Graphviz context is created once and reused by
+ * all render() calls.
+ */
+class SvgRenderer
+{
+public:
+    SvgRenderer();
+    ~SvgRenderer();
+
+    SvgRenderer(const SvgRenderer&) = delete;
+    SvgRenderer& operator=(const SvgRenderer&) = delete;
+
+    // Returns an "Error: ..." string on failure.
+    std::string render(const std::string& dot_content);
+
+private:
+    GVC_s* gvc_ = nullptr;
+};
+
+#endif // SVG_RENDERER_HPP
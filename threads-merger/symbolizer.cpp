@@ -0,0 +1,358 @@
+#include "symbolizer.hpp"
+#include "json_export.hpp"
+#include "frame_index.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+namespace {
+
+std::string demangle(std::string_view name) {
+#if __has_include(<cxxabi.h>)
+    if (name.starts_with("_Z")) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(std::string(name).c_str(), nullptr, nullptr, &status);
+        if (demangled) {
+            std::string result{demangled};
+            std::free(demangled);
+            return result;
+        }
+    }
+#endif
+    return std::string(name);
+}
+
+// Tabs and line breaks separate fields and entries of the cache files.
+std::string sanitize(std::string value) {
+    std::ranges::replace_if(value, [](char c) { return c == '\t' || c == '\n'; }, ' ');
+    return value;
+}
+
+template<typename Int>
+bool parse_int(std::string_view text, Int& value, int base = 10) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return error == std::errc{} && end == text.data() + text.size();
+}
+
+} // namespace
+
+SymbolModules::SymbolModules(std::filesystem::path cache_dir)
+    : cache_dir_(std::move(cache_dir)) {}
+
+SymbolModules::~SymbolModules() {
+    try {
+        save_cache();
+    } catch (...) {
+        // The cache is an optimization only.
+    }
+}
+
+Symbolizer::Symbolizer(std::filesystem::path cache_dir)
+    : modules_(std::make_shared<SymbolModules>(std::move(cache_dir))) {}
+
+Symbolizer::Symbolizer(std::shared_ptr<SymbolModules> modules)
+    : modules_(std::move(modules)) {}
+
+Symbolizer::~Symbolizer() {
+    try {
+        save_cache();
+    } catch (...) {
+        // The cache is an optimization only.
+    }
+}
+
+std::filesystem::path Symbolizer::default_cache_dir() {
+    if (const char* xdg_cache = std::getenv("XDG_CACHE_HOME"); xdg_cache && *xdg_cache) {
+        return std::filesystem::path{xdg_cache} / "threads-merger" / "symbols";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path{home} / ".cache" / "threads-merger" / "symbols";
+    }
+    return {};
+}
+
+std::vector<ModuleMapping> parse_proc_maps(std::istream& maps) {
+    std::vector<ModuleMapping> mappings;
+
+    // Format: start-end perms offset dev inode path
+    std::string line;
+    while (std::getline(maps, line)) {
+        std::istringstream fields{line};
+        std::string range, perms, offset, dev, inode, path;
+        fields >> range >> perms >> offset >> dev >> inode;
+        std::getline(fields >> std::ws, path);
+
+        const auto dash = range.find('-');
+        ModuleMapping mapping;
+        if (path.empty() || path.front() != '/' || dash == std::string::npos
+            || !parse_int(std::string_view{range}.substr(0, dash), mapping.start, 16)
+            || !parse_int(std::string_view{range}.substr(dash + 1), mapping.end, 16)
+            || !parse_int(std::string_view{offset}, mapping.offset, 16)) {
+            continue;
+        }
+        mapping.path = path;
+        mappings.push_back(std::move(mapping));
+    }
+
+    return mappings;
+}
+
+void Symbolizer::add_mapping(ModuleMapping mapping) {
+    const auto it = std::ranges::upper_bound(mappings_, mapping.start, {}, &ModuleMapping::start);
+    mappings_.insert(it, std::move(mapping));
+}
+
+void Symbolizer::load_proc_maps(std::istream& maps) {
+    for (auto& mapping : parse_proc_maps(maps)) {
+        add_mapping(std::move(mapping));
+    }
+}
+
+SymbolModules::Module& SymbolModules::module(const std::filesystem::path& path, std::unique_lock<std::mutex>& lock) {
+    Module* module = nullptr;
+    {
+        std::lock_guard map_lock{mutex_};
+        auto& entry = modules_[path.string()];
+        if (!entry) {
+            entry = std::make_unique<Module>();
+        }
+        module = entry.get();
+    }
+    lock = std::unique_lock{module->mutex};
+    if (!module->loaded) {
+        module->loaded = true;
+        load(*module, path);
+    }
+    return *module;
+}
+
+void SymbolModules::load(Module& module, const std::filesystem::path& path) {
+    try {
+        module.elf = std::make_unique<Elf::File>(path);
+        module.build_id = module.elf->build_id();
+    } catch (const std::runtime_error&) {
+        // Not readable or not an ELF file. It is remembered as a module without an ELF file.
+        module.elf.reset();
+        return;
+    }
+
+    if (cache_dir_.empty() || module.build_id.empty()) {
+        return;
+    }
+    std::ifstream cache_file{cache_dir_ / module.build_id};
+    std::string line;
+    while (std::getline(cache_file, line)) {
+        // Format: address<TAB>function<TAB>filename<TAB>row<TAB>column
+        std::vector<std::string_view> fields;
+        for (const auto field : std::views::split(std::string_view{line}, '\t')) {
+            fields.emplace_back(field.begin(), field.end());
+        }
+        std::uint64_t address = 0;
+        CachedSymbol symbol;
+        if (fields.size() != 5 || !parse_int(fields[0], address, 16)
+            || !parse_int(fields[3], symbol.row) || !parse_int(fields[4], symbol.column)) {
+            continue;
+        }
+        symbol.function = fields[1];
+        symbol.filename = fields[2];
+        module.cache.emplace(address, std::move(symbol));
+    }
+}
+
+std::optional<SymbolModules::CachedSymbol> SymbolModules::resolve(const std::filesystem::path& path, std::uint64_t file_offset) {
+    std::unique_lock<std::mutex> lock;
+    auto& module = this->module(path, lock);
+    if (!module.elf) {
+        return std::nullopt;
+    }
+    const auto elf_address = module.elf->offset_to_address(file_offset);
+    if (!elf_address) {
+        return std::nullopt;
+    }
+    return resolve(module, *elf_address);
+}
+
+SymbolModules::CachedSymbol SymbolModules::resolve(Module& module, std::uint64_t address) {
+    if (const auto it = module.cache.find(address); it != module.cache.end()) {
+        return it->second;
+    }
+
+    if (!module.debug_info_loaded) {
+        module.debug_info_loaded = true;
+        module.functions = module.elf->function_symbols();
+        module.lines = std::make_unique<Dwarf::LineTable>(Dwarf::LineSections{
+            module.elf->section_data(".debug_line"),
+            module.elf->section_data(".debug_str"),
+            module.elf->section_data(".debug_line_str"),
+        });
+    }
+
+    ++resolved_count_;
+
+    CachedSymbol symbol;
+    auto function = std::ranges::upper_bound(module.functions, address, {}, &Elf::FunctionSymbol::address);
+    if (function != module.functions.begin()) {
+        --function;
+        if (function->size == 0 || address < function->address + function->size) {
+            symbol.function = sanitize(demangle(function->name));
+        }
+    }
+    if (const auto line = module.lines->find(address)) {
+        symbol.filename = sanitize(line->filename);
+        symbol.row = line->row;
+        symbol.column = line->column;
+    }
+
+    module.cache.emplace(address, symbol);
+    module.new_addresses.push_back(address);
+    return symbol;
+}
+
+std::shared_ptr<const Symbol> Symbolizer::symbolize(std::uint64_t address) {
+    if (const auto it = symbols_.find(address); it != symbols_.end()) {
+        return it->second;
+    }
+
+    std::shared_ptr<const Symbol> result;
+
+    auto mapping = std::ranges::upper_bound(mappings_, address, {}, &ModuleMapping::start);
+    if (mapping != mappings_.begin() && address < std::prev(mapping)->end) {
+        --mapping;
+        auto symbol = std::make_shared<Symbol>();
+        symbol->module = mapping->path.filename().string();
+
+        if (auto cached = modules_->resolve(mapping->path, address - mapping->start + mapping->offset)) {
+            symbol->function = std::move(cached->function);
+            symbol->filename = std::move(cached->filename);
+            symbol->row = cached->row;
+            symbol->column = cached->column;
+        }
+        result = std::move(symbol);
+    }
+
+    symbols_.emplace(address, result);
+    return result;
+}
+
+void Symbolizer::save_cache() {
+    modules_->save_cache();
+}
+
+void SymbolModules::save_cache() {
+    if (cache_dir_.empty()) {
+        return;
+    }
+
+    std::lock_guard map_lock{mutex_};
+    for (auto& [path, module] : modules_) {
+        std::lock_guard lock{module->mutex};
+        if (!module->elf || module->build_id.empty() || module->new_addresses.empty()) {
+            continue;
+        }
+
+        // The lines are appended in one write, so they don't interleave with the lines of other
+        // processes that append to the same cache file.
+        std::string lines;
+        for (const auto address : module->new_addresses) {
+            const auto& symbol = module->cache.at(address);
+            lines += std::format("{:x}\t{}\t{}\t{}\t{}\n",
+                address, symbol.function, symbol.filename, symbol.row, symbol.column);
+        }
+        std::filesystem::create_directories(cache_dir_);
+        std::ofstream cache_file{cache_dir_ / module->build_id, std::ios::app};
+        cache_file.rdbuf()->pubsetbuf(nullptr, 0);
+        cache_file.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+        module->new_addresses.clear();
+    }
+}
+
+Node<SymbolizedAddress> symbolize_tree(const Node<std::uint64_t>& root, Symbolizer& symbolizer)
+{
+    Node<SymbolizedAddress> result{};
+    result.count = root.count;
+    result.level = root.level;
+    result.collapsed = root.collapsed;
+
+    struct Item {
+        const Node<std::uint64_t>* source;
+        Node<SymbolizedAddress>* target;
+    };
+
+    std::stack<Item> items;
+    items.push(Item{&root, &result});
+
+    while (!items.empty()) {
+        const auto item = items.top();
+        items.pop();
+
+        for (const auto& [address, next_node] : item.source->next_nodes) {
+            auto& target = child_node(*item.target, SymbolizedAddress{address, symbolizer.symbolize(address)});
+            target.count = next_node.count;
+            target.level = next_node.level;
+            target.collapsed = next_node.collapsed;
+            items.push(Item{&next_node, &target});
+        }
+    }
+
+    return result;
+}
+
+template<>
+Html::TableRow HtmlTableRow<SymbolizedAddress>::to_row(const SymbolizedAddress& item, const LevelRange& level_range)
+{
+    Html::TableRow row;
+    add_level_cell(row, level_range);
+
+    const auto* symbol = item.symbol.get();
+    const auto address = std::format("{:#x}", item.address);
+    row.add_cell(Html::TableCell{symbol && !symbol->function.empty() ? symbol->function : address});
+
+    std::string location;
+    if (symbol && !symbol->filename.empty()) {
+        location = std::filesystem::path{symbol->filename}.filename().string() + ":" + std::to_string(symbol->row);
+    }
+    row.add_cell(Html::TableCell{location});
+    row.add_cell(Html::TableCell{symbol ? symbol->module : std::string{}});
+
+    return row;
+}
+
+template<>
+std::size_t HtmlTableRow<SymbolizedAddress>::column_count() { return 4; }
+
+template<>
+void JsonValue<SymbolizedAddress>::write(std::ostream& os, const SymbolizedAddress& item)
+{
+    os << '{';
+    Json::write_key(os, "address", true);
+    os << item.address;
+    if (item.symbol) {
+        Json::write_key(os, "function");
+        Json::write_string(os, item.symbol->function);
+        Json::write_key(os, "filename");
+        Json::write_string(os, item.symbol->filename);
+        Json::write_key(os, "row");
+        os << item.symbol->row;
+        Json::write_key(os, "column");
+        os << item.symbol->column;
+        Json::write_key(os, "module");
+        Json::write_string(os, item.symbol->module);
+    }
+    os << '}';
+}
+
+template<>
+std::string FrameKey<SymbolizedAddress>::of(const SymbolizedAddress& item)
+{
+    if (item.symbol && !item.symbol->function.empty()) {
+        return item.symbol->function;
+    }
+    return std::format("{:#x}", item.address);
+}
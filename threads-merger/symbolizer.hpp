@@ -0,0 +1,194 @@
+#pragma once
+
+#include "merger.hpp"
+#include "symbolizer/dwarf_line.hpp"
+#include "symbolizer/elf_file.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Deferred symbolization of raw program counters.
+ *
+ * Stacks of addresses are merged with merge<std::uint64_t>(), then only the unique nodes of
+ * the merged tree are symbolized with symbolize_tree(). Symbols are looked up in the ELF
+ * symbol tables and DWARF line tables of the mapped modules. Resolved symbols are kept in
+ * an on-disk cache keyed by the build-id of a module, so the debug information of a module
+ * is not read again for known addresses.
+ *
+ */
+
+struct Symbol
+{
+    std::string function;
+    std::string filename;
+    int row = 0;
+    int column = 0;
+    std::string module;
+};
+
+struct SymbolizedAddress
+{
+    std::uint64_t address = 0;
+    // Null if the address is not in a known module.
+    std::shared_ptr<const Symbol> symbol;
+
+    bool operator==(const SymbolizedAddress& other) const { return address == other.address; }
+    auto operator<=>(const SymbolizedAddress& other) const { return address <=> other.address; }
+
+    friend std::ostream& operator<<(std::ostream& os, const SymbolizedAddress& item) {
+        return os << std::format("{:#x}", item.address);
+    }
+};
+
+namespace std
+{
+
+template<>
+struct hash<SymbolizedAddress> {
+    size_t operator()(const SymbolizedAddress& item) const noexcept {
+        return std::hash<std::uint64_t>{}(item.address);
+    }
+};
+
+} // namespace std
+
+// A file mapped into the address space of a process.
+struct ModuleMapping
+{
+    std::uint64_t start = 0;
+    std::uint64_t end = 0;
+    // Offset of the mapping in the file.
+    std::uint64_t offset = 0;
+    std::filesystem::path path;
+};
+
+// Reads the file mappings from the /proc/<pid>/maps format.
+std::vector<ModuleMapping> parse_proc_maps(std::istream& maps);
+
+/*
+ * ELF files, debug information and symbol caches of modules, keyed by path. They don't depend on
+ * the address space of a process, so symbolizers of different processes, e.g. of core dumps
+ * symbolized in parallel, share them and read the debug information of a module once.
+ * Thread-safe: modules are loaded and resolved under their own locks.
+ */
+class SymbolModules
+{
+public:
+    struct CachedSymbol
+    {
+        std::string function;
+        std::string filename;
+        int row = 0;
+        int column = 0;
+    };
+
+    /**
+     * @param cache_dir Directory of the symbol cache. An empty path disables the cache.
+     */
+    explicit SymbolModules(std::filesystem::path cache_dir = {});
+
+    // Saves the cache.
+    ~SymbolModules();
+
+    SymbolModules(const SymbolModules&) = delete;
+    SymbolModules& operator=(const SymbolModules&) = delete;
+
+    /**
+     * Resolves an offset in a file.
+     * @return Empty if the file is not a readable ELF file or the offset is not in a segment.
+     */
+    std::optional<CachedSymbol> resolve(const std::filesystem::path& path, std::uint64_t file_offset);
+
+    // Appends the newly resolved symbols to the cache files.
+    void save_cache();
+
+    // Number of addresses resolved through the debug information, not through the cache.
+    std::size_t resolved_count() const { return resolved_count_; }
+
+private:
+    struct Module
+    {
+        std::mutex mutex;
+        bool loaded = false;
+        // Null if the file is not readable or not an ELF file.
+        std::unique_ptr<Elf::File> elf;
+        std::string build_id;
+        std::unordered_map<std::uint64_t, CachedSymbol> cache;
+        std::vector<std::uint64_t> new_addresses;
+
+        // The debug information is read on the first cache miss.
+        bool debug_info_loaded = false;
+        std::vector<Elf::FunctionSymbol> functions;
+        std::unique_ptr<Dwarf::LineTable> lines;
+    };
+
+    std::filesystem::path cache_dir_;
+    // Guards the map, not the modules.
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<Module>> modules_;
+    std::atomic<std::size_t> resolved_count_{0};
+
+    // Loaded, with its lock held by the caller.
+    Module& module(const std::filesystem::path& path, std::unique_lock<std::mutex>& lock);
+    void load(Module& module, const std::filesystem::path& path);
+    CachedSymbol resolve(Module& module, std::uint64_t address);
+};
+
+/*
+ * Symbolizer of the addresses of one process. Not thread-safe; symbolizers of different
+ * processes may share their modules.
+ */
+class Symbolizer
+{
+public:
+    /**
+     * @param cache_dir Directory of the symbol cache. An empty path disables the cache.
+     */
+    explicit Symbolizer(std::filesystem::path cache_dir = {});
+
+    // Uses modules shared with other symbolizers.
+    explicit Symbolizer(std::shared_ptr<SymbolModules> modules);
+
+    // Saves the cache.
+    ~Symbolizer();
+
+    Symbolizer(const Symbolizer&) = delete;
+    Symbolizer& operator=(const Symbolizer&) = delete;
+
+    void add_mapping(ModuleMapping mapping);
+
+    // Adds the file mappings from the /proc/<pid>/maps format.
+    void load_proc_maps(std::istream& maps);
+
+    // Returns null if the address is not in a known module.
+    std::shared_ptr<const Symbol> symbolize(std::uint64_t address);
+
+    // Appends the newly resolved symbols to the cache files.
+    void save_cache();
+
+    // Number of addresses resolved through the debug information, not through the cache.
+    // Shared modules count the addresses of all their symbolizers.
+    std::size_t resolved_count() const { return modules_->resolved_count(); }
+
+    // $XDG_CACHE_HOME/threads-merger/symbols or ~/.cache/threads-merger/symbols.
+    static std::filesystem::path default_cache_dir();
+
+private:
+    std::shared_ptr<SymbolModules> modules_;
+    std::vector<ModuleMapping> mappings_;
+    std::unordered_map<std::uint64_t, std::shared_ptr<const Symbol>> symbols_;
+};
+
+/**
+ * Copies the tree of addresses and attaches symbols to the nodes.
+ * Each distinct address is symbolized once.
+ */
+Node<SymbolizedAddress> symbolize_tree(const Node<std::uint64_t>& root, Symbolizer& symbolizer);
@@ -0,0 +1,327 @@
+#include "dwarf_line.hpp"
+#include "dwarf_reader.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+using Dwarf::Reader;
+
+// Line number program opcodes and forms used by the header.
+enum : std::uint8_t {
+    DW_LNS_copy = 1,
+    DW_LNS_advance_pc = 2,
+    DW_LNS_advance_line = 3,
+    DW_LNS_set_file = 4,
+    DW_LNS_set_column = 5,
+    DW_LNS_negate_stmt = 6,
+    DW_LNS_set_basic_block = 7,
+    DW_LNS_const_add_pc = 8,
+    DW_LNS_fixed_advance_pc = 9,
+
+    DW_LNE_end_sequence = 1,
+    DW_LNE_set_address = 2,
+    DW_LNE_define_file = 3,
+
+    DW_LNCT_path = 1,
+    DW_LNCT_directory_index = 2,
+
+    DW_FORM_block2 = 0x03,
+    DW_FORM_block4 = 0x04,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0a,
+    DW_FORM_data1 = 0x0b,
+    DW_FORM_strp = 0x0e,
+    DW_FORM_udata = 0x0f,
+    DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f,
+};
+
+std::string_view string_at(std::span<const std::byte> section, std::uint64_t offset) {
+    if (offset >= section.size()) {
+        return {};
+    }
+    Reader reader{section.subspan(offset)};
+    return reader.string();
+}
+
+struct FormValue {
+    std::string_view string;
+    std::uint64_t number = 0;
+};
+
+FormValue read_form(Reader& reader, std::uint64_t form, bool is_dwarf64, const Dwarf::LineSections& sections) {
+    switch (form) {
+        case DW_FORM_string: return {reader.string()};
+        case DW_FORM_strp: return {string_at(sections.debug_str, reader.offset(is_dwarf64))};
+        case DW_FORM_line_strp: return {string_at(sections.debug_line_str, reader.offset(is_dwarf64))};
+        case DW_FORM_udata: return {{}, reader.uleb()};
+        case DW_FORM_data1: return {{}, reader.fixed<std::uint8_t>()};
+        case DW_FORM_data2: return {{}, reader.fixed<std::uint16_t>()};
+        case DW_FORM_data4: return {{}, reader.fixed<std::uint32_t>()};
+        case DW_FORM_data8: return {{}, reader.fixed<std::uint64_t>()};
+        case DW_FORM_data16: reader.skip(16); return {};
+        case DW_FORM_block: reader.skip(reader.uleb()); return {};
+        case DW_FORM_block1: reader.skip(reader.fixed<std::uint8_t>()); return {};
+        case DW_FORM_block2: reader.skip(reader.fixed<std::uint16_t>()); return {};
+        case DW_FORM_block4: reader.skip(reader.fixed<std::uint32_t>()); return {};
+        default: throw std::runtime_error("Unsupported DWARF form in a line table header");
+    }
+}
+
+std::string join_path(std::string_view directory, std::string_view name) {
+    if (directory.empty() || name.starts_with('/')) {
+        return std::string(name);
+    }
+    std::string path(directory);
+    if (!path.ends_with('/')) {
+        path += '/';
+    }
+    path += name;
+    return path;
+}
+
+} // namespace
+
+namespace Dwarf {
+
+LineTable::LineTable(const LineSections& sections) {
+    files_.emplace_back();
+
+    Reader reader{sections.debug_line};
+    while (!reader.at_end()) {
+        std::uint64_t unit_length = 0;
+        bool is_dwarf64 = false;
+        try {
+            unit_length = reader.fixed<std::uint32_t>();
+            if (unit_length == 0xFFFFFFFF) {
+                unit_length = reader.fixed<std::uint64_t>();
+                is_dwarf64 = true;
+            }
+        } catch (const std::runtime_error&) {
+            break;
+        }
+
+        const auto unit_begin = reader.position();
+        if (unit_length > sections.debug_line.size() - unit_begin) {
+            break;
+        }
+
+        try {
+            parse_unit(sections, sections.debug_line.subspan(unit_begin, unit_length), is_dwarf64);
+        } catch (const std::runtime_error&) {
+            // Keep the rows decoded so far and go on with the next unit.
+        }
+        reader.seek(unit_begin + unit_length);
+    }
+
+    // Rows of different sequences are ordered by address. An end of a sequence goes before
+    // a start of another sequence at the same address.
+    std::ranges::stable_sort(rows_, [](const Row& a, const Row& b) {
+        if (a.address != b.address) {
+            return a.address < b.address;
+        }
+        return a.end_sequence && !b.end_sequence;
+    });
+}
+
+void LineTable::parse_unit(const LineSections& sections, std::span<const std::byte> unit, bool is_dwarf64) {
+    Reader reader{unit};
+
+    const auto version = reader.fixed<std::uint16_t>();
+    if (version < 2 || version > 5) {
+        return;
+    }
+    if (version >= 5) {
+        reader.fixed<std::uint8_t>(); // address_size
+        reader.fixed<std::uint8_t>(); // segment_selector_size
+    }
+    const auto header_length = reader.offset(is_dwarf64);
+    const auto program_begin = reader.position() + header_length;
+
+    const auto minimum_instruction_length = reader.fixed<std::uint8_t>();
+    if (version >= 4) {
+        reader.fixed<std::uint8_t>(); // maximum_operations_per_instruction
+    }
+    reader.fixed<std::uint8_t>(); // default_is_stmt
+    const auto line_base = reader.fixed<std::int8_t>();
+    const auto line_range = reader.fixed<std::uint8_t>();
+    const auto opcode_base = reader.fixed<std::uint8_t>();
+    if (line_range == 0) {
+        return;
+    }
+
+    std::vector<std::uint8_t> standard_opcode_lengths;
+    for (int i = 1; i < opcode_base; ++i) {
+        standard_opcode_lengths.push_back(reader.fixed<std::uint8_t>());
+    }
+
+    // Indices of the unit files in files_, as numbered by the line number program.
+    std::vector<std::uint32_t> unit_files;
+    std::vector<std::string> directories;
+
+    auto add_file = [&](std::string_view name, std::uint64_t directory_index) {
+        const auto directory = directory_index < directories.size()
+            ? std::string_view{directories[directory_index]}
+            : std::string_view{};
+        unit_files.push_back(static_cast<std::uint32_t>(files_.size()));
+        files_.push_back(join_path(directory, name));
+    };
+
+    if (version >= 5) {
+        auto read_entries = [&](auto&& on_entry) {
+            const auto format_count = reader.fixed<std::uint8_t>();
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> formats;
+            for (int i = 0; i < format_count; ++i) {
+                const auto content_type = reader.uleb();
+                const auto form = reader.uleb();
+                formats.emplace_back(content_type, form);
+            }
+            const auto count = reader.uleb();
+            for (std::uint64_t i = 0; i < count; ++i) {
+                std::string_view path;
+                std::uint64_t directory_index = 0;
+                for (const auto& [content_type, form] : formats) {
+                    const auto value = read_form(reader, form, is_dwarf64, sections);
+                    if (content_type == DW_LNCT_path) {
+                        path = value.string;
+                    } else if (content_type == DW_LNCT_directory_index) {
+                        directory_index = value.number;
+                    }
+                }
+                on_entry(path, directory_index);
+            }
+        };
+
+        read_entries([&](std::string_view path, std::uint64_t) {
+            directories.emplace_back(path);
+        });
+        read_entries([&](std::string_view path, std::uint64_t directory_index) {
+            add_file(path, directory_index);
+        });
+    } else {
+        // Directory 0 is the compilation directory, which is not listed before DWARF 5.
+        directories.emplace_back();
+        for (auto directory = reader.string(); !directory.empty(); directory = reader.string()) {
+            directories.emplace_back(directory);
+        }
+        // File numbers start from 1 before DWARF 5.
+        unit_files.push_back(static_cast<std::uint32_t>(files_.size()));
+        files_.emplace_back();
+        for (auto name = reader.string(); !name.empty(); name = reader.string()) {
+            const auto directory_index = reader.uleb();
+            reader.uleb(); // modification time
+            reader.uleb(); // file length
+            add_file(name, directory_index);
+        }
+    }
+
+    reader.seek(program_begin);
+
+    // The file register starts at 1 in all versions, even though DWARF 5 numbers files from 0.
+    const std::uint32_t default_file = 1;
+    std::uint64_t address = 0;
+    std::uint32_t file = default_file;
+    std::int64_t line = 1;
+    std::uint64_t column = 0;
+
+    auto emit_row = [&](bool end_sequence) {
+        // Index 0 of files_ is the unknown file.
+        const auto file_index = file < unit_files.size() ? unit_files[file] : 0;
+        rows_.push_back(Row{
+            address,
+            file_index,
+            static_cast<std::uint32_t>(std::max<std::int64_t>(line, 0)),
+            static_cast<std::uint32_t>(column),
+            end_sequence
+        });
+    };
+
+    while (!reader.at_end()) {
+        const auto opcode = reader.fixed<std::uint8_t>();
+
+        if (opcode >= opcode_base) {
+            const auto adjusted = static_cast<std::uint8_t>(opcode - opcode_base);
+            address += static_cast<std::uint64_t>(adjusted / line_range) * minimum_instruction_length;
+            line += line_base + adjusted % line_range;
+            emit_row(false);
+            continue;
+        }
+
+        switch (opcode) {
+            case 0: {
+                const auto length = reader.uleb();
+                if (length == 0) {
+                    break;
+                }
+                const auto end = reader.position() + length;
+                const auto extended = reader.fixed<std::uint8_t>();
+                if (extended == DW_LNE_end_sequence) {
+                    emit_row(true);
+                    address = 0;
+                    file = default_file;
+                    line = 1;
+                    column = 0;
+                } else if (extended == DW_LNE_set_address) {
+                    address = length - 1 == 8 ? reader.fixed<std::uint64_t>() : reader.fixed<std::uint32_t>();
+                } else if (extended == DW_LNE_define_file) {
+                    const auto name = reader.string();
+                    const auto directory_index = reader.uleb();
+                    add_file(name, directory_index);
+                }
+                reader.seek(end);
+                break;
+            }
+            case DW_LNS_copy:
+                emit_row(false);
+                break;
+            case DW_LNS_advance_pc:
+                address += reader.uleb() * minimum_instruction_length;
+                break;
+            case DW_LNS_advance_line:
+                line += reader.sleb();
+                break;
+            case DW_LNS_set_file:
+                file = static_cast<std::uint32_t>(reader.uleb());
+                break;
+            case DW_LNS_set_column:
+                column = reader.uleb();
+                break;
+            case DW_LNS_negate_stmt:
+            case DW_LNS_set_basic_block:
+                break;
+            case DW_LNS_const_add_pc:
+                address += static_cast<std::uint64_t>((255 - opcode_base) / line_range) * minimum_instruction_length;
+                break;
+            case DW_LNS_fixed_advance_pc:
+                address += reader.fixed<std::uint16_t>();
+                break;
+            default:
+                // Skip operands of the opcodes that don't change the address or position.
+                for (int i = 0; i < standard_opcode_lengths[opcode - 1]; ++i) {
+                    reader.uleb();
+                }
+                break;
+        }
+    }
+}
+
+std::optional<LineInfo> LineTable::find(std::uint64_t address) const {
+    auto it = std::ranges::upper_bound(rows_, address, {}, &Row::address);
+    if (it == rows_.begin()) {
+        return std::nullopt;
+    }
+    --it;
+    if (it->end_sequence) {
+        return std::nullopt;
+    }
+    return LineInfo{files_[it->file], static_cast<int>(it->row), static_cast<int>(it->column)};
+}
+
+} // namespace Dwarf
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+/* Reader of DWARF line number tables (.debug_line, versions 2–5).
+ *
+ * DWARF 5 specification, section 6.2: https://dwarfstd.org/dwarf5std.html
+ *
+ */
+
+namespace Dwarf {
+
+struct LineInfo {
+    std::string filename;
+    int row = 0;
+    int column = 0;
+};
+
+struct LineSections {
+    std::span<const std::byte> debug_line;
+    std::span<const std::byte> debug_str;
+    std::span<const std::byte> debug_line_str;
+};
+
+class LineTable {
+public:
+    // Decodes all line number programs. Malformed units are skipped.
+    explicit LineTable(const LineSections& sections);
+
+    // Source position of the instruction at the address.
+    std::optional<LineInfo> find(std::uint64_t address) const;
+
+    bool empty() const { return rows_.empty(); }
+
+private:
+    struct Row {
+        std::uint64_t address = 0;
+        std::uint32_t file = 0;
+        std::uint32_t row = 0;
+        std::uint32_t column = 0;
+        bool end_sequence = false;
+    };
+
+    std::vector<std::string> files_;
+    std::vector<Row> rows_;
+
+    void parse_unit(const LineSections& sections, std::span<const std::byte> unit, bool is_dwarf64);
+};
+
+} // namespace Dwarf
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+namespace Dwarf {
+
+// Sequential reader of DWARF encoded data. Throws std::runtime_error when the data ends early.
+class Reader {
+public:
+    explicit Reader(std::span<const std::byte> data) : data_(data) {}
+
+    bool at_end() const { return position_ >= data_.size(); }
+    std::size_t position() const { return position_; }
+
+    template<typename T>
+    T fixed() {
+        T value{};
+        require(sizeof(T));
+        std::memcpy(&value, data_.data() + position_, sizeof(T));
+        position_ += sizeof(T);
+        return value;
+    }
+
+    std::uint64_t offset(bool is_dwarf64) {
+        return is_dwarf64 ? fixed<std::uint64_t>() : fixed<std::uint32_t>();
+    }
+
+    std::uint64_t uleb() {
+        std::uint64_t value = 0;
+        unsigned shift = 0;
+        std::uint8_t byte = 0;
+        do {
+            byte = fixed<std::uint8_t>();
+            if (shift < 64) {
+                value |= std::uint64_t{byte & 0x7Fu} << shift;
+            }
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    std::int64_t sleb() {
+        std::int64_t value = 0;
+        unsigned shift = 0;
+        std::uint8_t byte = 0;
+        do {
+            byte = fixed<std::uint8_t>();
+            if (shift < 64) {
+                value |= std::int64_t{byte & 0x7F} << shift;
+            }
+            shift += 7;
+        } while (byte & 0x80);
+        if (shift < 64 && (byte & 0x40)) {
+            value |= -(std::int64_t{1} << shift);
+        }
+        return value;
+    }
+
+    std::string_view string() {
+        const auto* begin = reinterpret_cast<const char*>(data_.data()) + position_;
+        const auto* end = reinterpret_cast<const char*>(data_.data()) + data_.size();
+        const auto* terminator = std::find(begin, end, '\0');
+        if (terminator == end) {
+            throw std::runtime_error("Unterminated string");
+        }
+        position_ += static_cast<std::size_t>(terminator - begin) + 1;
+        return {begin, terminator};
+    }
+
+    void skip(std::size_t size) {
+        require(size);
+        position_ += size;
+    }
+
+    void seek(std::size_t position) {
+        position_ = std::min(position, data_.size());
+    }
+
+private:
+    std::span<const std::byte> data_;
+    std::size_t position_ = 0;
+
+    void require(std::size_t size) const {
+        if (size > data_.size() - position_) {
+            throw std::runtime_error("Unexpected end of DWARF data");
+        }
+    }
+};
+
+} // namespace Dwarf
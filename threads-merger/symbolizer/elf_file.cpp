@@ -0,0 +1,194 @@
+#include "elf_file.hpp"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr unsigned char ELFCLASS64 = 2;
+constexpr unsigned char ELFDATA2LSB = 1;
+
+std::uint64_t align4(std::uint64_t value) {
+    return (value + 3) & ~std::uint64_t{3};
+}
+
+} // namespace
+
+namespace Elf {
+
+File::File(const std::filesystem::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(std::format("Can't open '{}'", path.string()));
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        ::close(fd);
+        throw std::runtime_error(std::format("Not an ELF file: '{}'", path.string()));
+    }
+
+    size_ = static_cast<std::size_t>(st.st_size);
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::format("Can't map '{}'", path.string()));
+    }
+    data_ = static_cast<const std::byte*>(mapping);
+
+    const auto& h = header();
+    if (std::memcmp(h.ident, "\x7f" "ELF", 4) != 0 || h.ident[4] != ELFCLASS64 || h.ident[5] != ELFDATA2LSB) {
+        ::munmap(const_cast<std::byte*>(data_), size_);
+        throw std::runtime_error(std::format("Not a 64-bit little-endian ELF file: '{}'", path.string()));
+    }
+
+    for (std::uint16_t i = 0; i < h.phnum; ++i) {
+        program_headers_.push_back(read<ProgramHeader>(h.phoff + std::uint64_t{i} * h.phentsize));
+    }
+    for (std::uint16_t i = 0; i < h.shnum; ++i) {
+        section_headers_.push_back(read<SectionHeader>(h.shoff + std::uint64_t{i} * h.shentsize));
+    }
+}
+
+File::~File() {
+    ::munmap(const_cast<std::byte*>(data_), size_);
+}
+
+const FileHeader& File::header() const {
+    return *reinterpret_cast<const FileHeader*>(data_);
+}
+
+std::span<const ProgramHeader> File::program_headers() const {
+    return program_headers_;
+}
+
+std::span<const SectionHeader> File::section_headers() const {
+    return section_headers_;
+}
+
+std::span<const std::byte> File::data(std::uint64_t offset, std::uint64_t size) const {
+    if (offset >= size_) {
+        return {};
+    }
+    return {data_ + offset, static_cast<std::size_t>(std::min<std::uint64_t>(size, size_ - offset))};
+}
+
+std::string_view File::string_at(const SectionHeader& strtab, std::uint32_t offset) const {
+    const auto bytes = data(strtab.offset, strtab.size);
+    if (offset >= bytes.size()) {
+        return {};
+    }
+    const auto* begin = reinterpret_cast<const char*>(bytes.data()) + offset;
+    const auto* end = std::find(begin, reinterpret_cast<const char*>(bytes.data()) + bytes.size(), '\0');
+    return {begin, end};
+}
+
+const SectionHeader* File::section(std::string_view name) const {
+    if (header().shstrndx >= section_headers_.size()) {
+        return nullptr;
+    }
+    const auto& names = section_headers_[header().shstrndx];
+    for (const auto& section : section_headers_) {
+        if (string_at(names, section.name) == name) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+std::span<const std::byte> File::section_data(std::string_view name) const {
+    const auto* header = section(name);
+    if (!header || header->type == SHT_NOBITS) {
+        return {};
+    }
+    return data(header->offset, header->size);
+}
+
+std::vector<Note> File::notes() const {
+    std::vector<Note> result;
+    for (const auto& segment : program_headers_) {
+        if (segment.type != PT_NOTE) {
+            continue;
+        }
+
+        std::uint64_t offset = segment.offset;
+        const std::uint64_t end = segment.offset + segment.filesz;
+        while (offset + 12 <= end) {
+            const auto name_size = read<std::uint32_t>(offset);
+            const auto desc_size = read<std::uint32_t>(offset + 4);
+            const auto type = read<std::uint32_t>(offset + 8);
+            const auto name_offset = offset + 12;
+            const auto desc_offset = name_offset + align4(name_size);
+            if (desc_offset + desc_size > end) {
+                break;
+            }
+
+            const auto name_bytes = data(name_offset, name_size);
+            std::string_view name{reinterpret_cast<const char*>(name_bytes.data()), name_bytes.size()};
+            if (!name.empty() && name.back() == '\0') {
+                name.remove_suffix(1);
+            }
+
+            result.push_back(Note{name, type, data(desc_offset, desc_size)});
+            offset = desc_offset + align4(desc_size);
+        }
+    }
+    return result;
+}
+
+std::string File::build_id() const {
+    for (const auto& note : notes()) {
+        if (note.type == NT_GNU_BUILD_ID && note.name == "GNU") {
+            std::string id;
+            for (const auto byte : note.desc) {
+                id += std::format("{:02x}", static_cast<unsigned>(byte));
+            }
+            return id;
+        }
+    }
+    return {};
+}
+
+std::optional<std::uint64_t> File::offset_to_address(std::uint64_t offset) const {
+    for (const auto& segment : program_headers_) {
+        if (segment.type == PT_LOAD && offset >= segment.offset && offset < segment.offset + segment.filesz) {
+            return offset - segment.offset + segment.vaddr;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<FunctionSymbol> File::function_symbols() const {
+    auto read_table = [this](std::uint32_t table_type) {
+        std::vector<FunctionSymbol> symbols;
+        for (const auto& section : section_headers_) {
+            if (section.type != table_type || section.entsize != sizeof(SymbolEntry)
+                || section.link >= section_headers_.size()) {
+                continue;
+            }
+            const auto& strtab = section_headers_[section.link];
+            for (std::uint64_t offset = 0; offset + sizeof(SymbolEntry) <= section.size; offset += sizeof(SymbolEntry)) {
+                const auto entry = read<SymbolEntry>(section.offset + offset);
+                if ((entry.info & 0xF) == STT_FUNC && entry.value != 0) {
+                    symbols.push_back(FunctionSymbol{entry.value, entry.size, string_at(strtab, entry.name)});
+                }
+            }
+        }
+        return symbols;
+    };
+
+    auto symbols = read_table(SHT_SYMTAB);
+    if (symbols.empty()) {
+        symbols = read_table(SHT_DYNSYM);
+    }
+    std::ranges::sort(symbols, {}, &FunctionSymbol::address);
+    return symbols;
+}
+
+} // namespace Elf
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Read-only access to 64-bit little-endian ELF files.
+ *
+ * The file is mapped into memory, nothing is copied until it is asked for.
+ *
+ * ELF format: https://refspecs.linuxfoundation.org/elf/gabi4+/contents.html
+ *
+ */
+
+namespace Elf {
+
+struct FileHeader {
+    unsigned char ident[16];
+    std::uint16_t type;
+    std::uint16_t machine;
+    std::uint32_t version;
+    std::uint64_t entry;
+    std::uint64_t phoff;
+    std::uint64_t shoff;
+    std::uint32_t flags;
+    std::uint16_t ehsize;
+    std::uint16_t phentsize;
+    std::uint16_t phnum;
+    std::uint16_t shentsize;
+    std::uint16_t shnum;
+    std::uint16_t shstrndx;
+};
+
+struct ProgramHeader {
+    std::uint32_t type;
+    std::uint32_t flags;
+    std::uint64_t offset;
+    std::uint64_t vaddr;
+    std::uint64_t paddr;
+    std::uint64_t filesz;
+    std::uint64_t memsz;
+    std::uint64_t align;
+};
+
+struct SectionHeader {
+    std::uint32_t name;
+    std::uint32_t type;
+    std::uint64_t flags;
+    std::uint64_t addr;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t link;
+    std::uint32_t info;
+    std::uint64_t addralign;
+    std::uint64_t entsize;
+};
+
+struct SymbolEntry {
+    std::uint32_t name;
+    unsigned char info;
+    unsigned char other;
+    std::uint16_t shndx;
+    std::uint64_t value;
+    std::uint64_t size;
+};
+
+constexpr std::uint16_t ET_CORE = 4;
+constexpr std::uint32_t PT_LOAD = 1;
+constexpr std::uint32_t PT_NOTE = 4;
+constexpr std::uint32_t SHT_SYMTAB = 2;
+constexpr std::uint32_t SHT_NOBITS = 8;
+constexpr std::uint32_t SHT_DYNSYM = 11;
+constexpr unsigned char STT_FUNC = 2;
+constexpr std::uint32_t NT_GNU_BUILD_ID = 3;
+
+struct Note {
+    std::string_view name;
+    std::uint32_t type = 0;
+    std::span<const std::byte> desc;
+};
+
+struct FunctionSymbol {
+    std::uint64_t address = 0;
+    std::uint64_t size = 0;
+    std::string_view name;
+};
+
+class File {
+public:
+    // Throws std::runtime_error if the file can't be mapped or is not a 64-bit little-endian ELF.
+    explicit File(const std::filesystem::path& path);
+    ~File();
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    const FileHeader& header() const;
+    std::span<const ProgramHeader> program_headers() const;
+    std::span<const SectionHeader> section_headers() const;
+
+    // Returns null if there is no such section.
+    const SectionHeader* section(std::string_view name) const;
+
+    // Returns an empty span if there is no such section.
+    std::span<const std::byte> section_data(std::string_view name) const;
+
+    // Bytes of the file in [offset, offset + size), clipped to the file size.
+    std::span<const std::byte> data(std::uint64_t offset, std::uint64_t size) const;
+
+    std::vector<Note> notes() const;
+
+    // Hex string of the GNU build-id, or an empty string.
+    std::string build_id() const;
+
+    // Converts a file offset to a virtual address using the PT_LOAD segments.
+    std::optional<std::uint64_t> offset_to_address(std::uint64_t offset) const;
+
+    // Function symbols from .symtab, or from .dynsym if there is no .symtab, sorted by address.
+    std::vector<FunctionSymbol> function_symbols() const;
+
+    template<typename T>
+    T read(std::uint64_t offset) const {
+        T value{};
+        const auto bytes = data(offset, sizeof(T));
+        std::memcpy(&value, bytes.data(), bytes.size());
+        return value;
+    }
+
+private:
+    const std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::vector<ProgramHeader> program_headers_;
+    std::vector<SectionHeader> section_headers_;
+
+    std::string_view string_at(const SectionHeader& strtab, std::uint32_t offset) const;
+};
+
+} // namespace Elf
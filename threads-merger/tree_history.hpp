@@ -0,0 +1,289 @@
+#ifndef TREE_HISTORY_HPP
+#define TREE_HISTORY_HPP
+
+#include "merger.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/*
+ * Versions of a merged tree, e.g. snapshots of a process taken every second.
+ *
+ * A new version is compared with the last one path by path, and the subtrees that didn't change
+ * are taken from the last version. So a version costs only the nodes on the changed paths.
+ * Nodes are immutable and are freed with the last version that has them.
+ */
+
+// A node whose number of stacks differs between two versions.
+template<typename T>
+struct PathChange
+{
+    // Frames from the root.
+    std::vector<T> path;
+    std::size_t before = 0;
+    std::size_t after = 0;
+
+    auto operator<=>(const PathChange&) const = default;
+};
+
+template<typename T>
+class TreeHistory
+{
+public:
+    /**
+     * @param max_versions Maximum number of kept versions, the oldest ones are dropped;
+     * 0 means no limit.
+     */
+    explicit TreeHistory(std::size_t max_versions = 0) : max_versions_(max_versions) {}
+
+    /**
+     * Adds a version of the tree. The tree may be collapsed or not, but the same way for all versions.
+     * @return The number of the version. Versions are numbered from 0 in the order they are added.
+     */
+    std::size_t push(const Node<T>& tree);
+
+    // Numbers of the kept versions are in [first_version(), end_version()).
+    std::size_t first_version() const { return first_version_; }
+    std::size_t end_version() const { return first_version_ + versions_.size(); }
+
+    /**
+     * The tree of a kept version, e.g. for get_dot_graph().
+     * @param resource Memory resource for all nodes of the tree.
+     */
+    Node<T> tree(std::size_t version, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+    /**
+     * Nodes that are added, removed, or have another number of stacks in the version `to`
+     * compared with the version `from`. The cost depends on the changed paths only.
+     */
+    std::vector<PathChange<T>> diff(std::size_t from, std::size_t to) const;
+
+    // Number of distinct nodes of all kept versions.
+    std::size_t node_count() const;
+
+private:
+    struct PersistentNode;
+    using NodePtr = std::shared_ptr<const PersistentNode>;
+    using Child = std::pair<T, NodePtr>;
+
+    struct PersistentNode {
+        std::size_t count = 0;
+        std::size_t level = 0;
+        std::size_t collapsed = 0;
+        // Sorted by frames.
+        std::vector<Child> children;
+    };
+
+    std::size_t max_versions_;
+    std::size_t first_version_ = 0;
+    std::deque<NodePtr> versions_;
+
+    const NodePtr& version(std::size_t version) const;
+    static const NodePtr* find_child(const PersistentNode* node, const T& frame);
+};
+
+
+template<typename T>
+auto TreeHistory<T>::version(std::size_t version) const -> const NodePtr&
+{
+    if (version < first_version_ || version >= end_version()) {
+        throw std::out_of_range("No version " + std::to_string(version) + " in the tree history");
+    }
+    return versions_[version - first_version_];
+}
+
+template<typename T>
+auto TreeHistory<T>::find_child(const PersistentNode* node, const T& frame) -> const NodePtr*
+{
+    if (!node) {
+        return nullptr;
+    }
+    const auto it = std::ranges::lower_bound(node->children, frame, {}, &Child::first);
+    return it != node->children.end() && it->first == frame ? &it->second : nullptr;
+}
+
+template<typename T>
+std::size_t TreeHistory<T>::push(const Node<T>& tree)
+{
+    // Nodes are built after their children. A node of the new tree that has the same counts and
+    // the same children as the node at its path in the last version is replaced by that node.
+    struct Work {
+        const Node<T>* node;
+        const T* frame;
+        NodePtr last;
+        std::vector<NodeMapValueConstRef<T>> children;
+        std::size_t next = 0;
+        PersistentNode built;
+        bool unchanged;
+    };
+
+    const auto make_work = [](const Node<T>& node, const T* frame, NodePtr last) {
+        Work work{.node = &node, .frame = frame, .last = std::move(last)};
+        work.children.reserve(node.next_nodes.size());
+        for (const auto& child : node.next_nodes) {
+            work.children.push_back(child);
+        }
+        std::ranges::sort(work.children, {}, [](const NodeMapValue<T>& child) -> const T& { return child.first; });
+        work.built = {.count = node.count, .level = node.level, .collapsed = node.collapsed};
+        work.built.children.reserve(work.children.size());
+        work.unchanged = work.last
+            && work.last->count == node.count
+            && work.last->level == node.level
+            && work.last->collapsed == node.collapsed
+            && work.last->children.size() == work.children.size();
+        return work;
+    };
+
+    NodePtr root;
+    std::vector<Work> stack;
+    stack.push_back(make_work(tree, nullptr, versions_.empty() ? nullptr : versions_.back()));
+
+    while (!stack.empty()) {
+        auto& work = stack.back();
+        if (work.next < work.children.size()) {
+            const auto& [frame, child] = work.children[work.next++].get();
+            const auto* last_child = find_child(work.last.get(), frame);
+            stack.push_back(make_work(child, &frame, last_child ? *last_child : nullptr));
+            continue;
+        }
+
+        auto built = work.unchanged ? work.last : std::make_shared<const PersistentNode>(std::move(work.built));
+        const auto* frame = work.frame;
+        const bool reused = built == work.last;
+        stack.pop_back();
+
+        if (stack.empty()) {
+            root = std::move(built);
+        } else {
+            auto& parent = stack.back();
+            parent.unchanged = parent.unchanged && reused;
+            parent.built.children.emplace_back(*frame, std::move(built));
+        }
+    }
+
+    versions_.push_back(std::move(root));
+    if (max_versions_ > 0 && versions_.size() > max_versions_) {
+        versions_.pop_front();
+        ++first_version_;
+    }
+    return end_version() - 1;
+}
+
+template<typename T>
+Node<T> TreeHistory<T>::tree(std::size_t number, std::pmr::memory_resource* resource) const
+{
+    const auto& root = version(number);
+
+    Node<T> result{
+        .count = root->count,
+        .level = root->level,
+        .collapsed = root->collapsed,
+        .next_nodes = NodeMap<T>(resource),
+    };
+
+    std::vector<std::pair<const PersistentNode*, Node<T>*>> stack{{root.get(), &result}};
+    while (!stack.empty()) {
+        const auto [source, target] = stack.back();
+        stack.pop_back();
+        for (const auto& [frame, child] : source->children) {
+            auto& node = child_node(*target, frame);
+            node.count = child->count;
+            node.level = child->level;
+            node.collapsed = child->collapsed;
+            stack.emplace_back(child.get(), &node);
+        }
+    }
+    return result;
+}
+
+template<typename T>
+std::vector<PathChange<T>> TreeHistory<T>::diff(std::size_t from, std::size_t to) const
+{
+    struct Work {
+        const PersistentNode* before;
+        const PersistentNode* after;
+        const T* frame;
+        std::size_t depth;
+    };
+
+    std::vector<PathChange<T>> changes;
+    std::vector<const T*> path;
+    std::vector<Work> stack{{version(from).get(), version(to).get(), nullptr, 0}};
+
+    while (!stack.empty()) {
+        const auto work = stack.back();
+        stack.pop_back();
+
+        // Shared subtrees have no changes.
+        if (work.before == work.after) {
+            continue;
+        }
+
+        path.resize(work.depth);
+        if (work.frame) {
+            path.push_back(work.frame);
+            const auto before = work.before ? work.before->count : 0;
+            const auto after = work.after ? work.after->count : 0;
+            if (before != after) {
+                PathChange<T> change{.before = before, .after = after};
+                change.path.reserve(path.size());
+                for (const auto* frame : path) {
+                    change.path.push_back(*frame);
+                }
+                changes.push_back(std::move(change));
+            }
+        }
+
+        // Children of both nodes are sorted, so they are matched in one pass.
+        static const std::vector<Child> no_children;
+        const auto& before = work.before ? work.before->children : no_children;
+        const auto& after = work.after ? work.after->children : no_children;
+        auto b = before.begin();
+        auto a = after.begin();
+        while (b != before.end() || a != after.end()) {
+            if (a == after.end() || (b != before.end() && b->first < a->first)) {
+                stack.push_back({b->second.get(), nullptr, &b->first, path.size()});
+                ++b;
+            } else if (b == before.end() || a->first < b->first) {
+                stack.push_back({nullptr, a->second.get(), &a->first, path.size()});
+                ++a;
+            } else {
+                stack.push_back({b->second.get(), a->second.get(), &a->first, path.size()});
+                ++b;
+                ++a;
+            }
+        }
+    }
+    return changes;
+}
+
+template<typename T>
+std::size_t TreeHistory<T>::node_count() const
+{
+    std::unordered_set<const PersistentNode*> visited;
+    std::vector<const PersistentNode*> stack;
+    for (const auto& root : versions_) {
+        stack.push_back(root.get());
+    }
+    while (!stack.empty()) {
+        const auto* node = stack.back();
+        stack.pop_back();
+        if (!visited.insert(node).second) {
+            continue;
+        }
+        for (const auto& child : node->children) {
+            stack.push_back(child.second.get());
+        }
+    }
+    return visited.size();
+}
+
+#endif // TREE_HISTORY_HPP
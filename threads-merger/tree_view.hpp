@@ -0,0 +1,378 @@
+#ifndef TREE_VIEW_HPP
+#define TREE_VIEW_HPP
+
+#include "merger.hpp"
+#include "budget.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/*
+ * A merged tree that is rendered to DOT partially.
+ *
+ * Only the tables up to some depth are rendered first, the children of a deeper table are
+ * replaced with a placeholder node "table_<id>_more". A table is expanded by its id on demand.
+ * So the size of the DOT graph, and the time of its layout, depends on the visible part of
+ * the tree only.
+ *
+ * A budget bounds the rendering of the visible part too. Tables are rendered breadth-first, the
+ * children of the expanded tables first of all, and the tables that are left out when the budget
+ * runs out are replaced with the placeholder of their parent, or with "table_roots_more" for roots.
+ *
+ * Table ids are assigned when a table is rendered for the first time. A table is identified by
+ * its parent table and its first frame, so its id survives the changes of the stacks. The ids of
+ * the tables that a change removes are dropped, and never used again.
+ *
+ * Stacks are added and removed one by one, so the view is updated on each stop of a debugger
+ * without merging all stacks again. The collapsed tree is updated in place: only the subtree of
+ * the deepest run of frames that the stack doesn't restructure is collapsed again, the counts
+ * above it are adjusted. So a change costs the size of that subtree, usually the few nodes where
+ * the threads diverge, not the size of the tree.
+ */
+template<typename T>
+class TreeView
+{
+public:
+    explicit TreeView(const std::vector<std::vector<T>>& lists)
+    {
+        for (const auto& list : lists) {
+            ::add_stack(stacks_, list);
+        }
+        root_ = stacks_;
+        collapse(root_);
+    }
+
+    TreeView(const TreeView&) = delete;
+    TreeView& operator=(const TreeView&) = delete;
+
+    void add_stack(const std::vector<T>& list)
+    {
+        const auto new_nodes = ::add_stack(stacks_, list);
+        if (!list.empty()) {
+            sync(list, list.size() - new_nodes + 1, true);
+        }
+    }
+
+    // Removes a stack that was added before. Unknown stacks, even prefixes of added ones, are ignored.
+    void remove_stack(const std::vector<T>& list)
+    {
+        const auto count = stacks_.count;
+        ::remove_stack(stacks_, list);
+        if (stacks_.count == count) {
+            return;
+        }
+        // The erased nodes are the end of the path.
+        std::size_t kept = 0;
+        for (const Node<T>* node = &stacks_; kept < list.size(); ++kept) {
+            const auto it = node->next_nodes.find(merged_frame(list, kept, Orientation::CallerRooted));
+            if (it == node->next_nodes.end()) {
+                break;
+            }
+            node = &it->second;
+        }
+        sync(list, kept + 1, false);
+    }
+
+    /**
+     * Shows the tables up to the depth and hides the expanded ones deeper.
+     * @param depth Number of levels of tables from the bottom; 0 shows all tables.
+     * @param tracker Budget of the rendering; without it all visible tables are rendered.
+     * @return DOT graph of the visible tables.
+     */
+    std::string render(std::size_t depth, BudgetTracker* tracker = nullptr)
+    {
+        depth_ = depth;
+        expanded_.clear();
+        return dot(tracker);
+    }
+
+    /**
+     * Shows the children of the table. Unknown ids are ignored.
+     * @return DOT graph of the visible tables.
+     */
+    std::string expand(int table_id, BudgetTracker* tracker = nullptr)
+    {
+        if (table_id >= 0 && table_id < next_table_id_) {
+            expanded_.insert(table_id);
+        }
+        return dot(tracker);
+    }
+
+    // DOT graph of the visible tables with the current stacks.
+    std::string dot(BudgetTracker* tracker = nullptr);
+
+    // The collapsed tree of the current stacks.
+    const Node<T>& root() const { return root_; }
+
+    // Number of the tables with ids: the rendered tables that still exist.
+    std::size_t table_id_count() const { return table_ids_.size(); }
+
+private:
+    // Not collapsed, so stacks can be removed.
+    Node<T> stacks_;
+    // Collapsed, kept in sync with the stacks.
+    Node<T> root_;
+
+    std::size_t depth_ = 0;
+    std::map<std::pair<int, T>, int> table_ids_;
+    int next_table_id_ = 0;
+    std::unordered_set<int> expanded_;
+
+    /**
+     * Updates the collapsed tree after a stack is added to or removed from the stacks.
+     * A node of the stacks starts a collapsed node, a run, unless its parent has only it as a child
+     * with the same frame. Only the children of the nodes on the path from `first_changed`, the
+     * first created or erased node (1-based), change; so the runs that start above it stay, and
+     * the subtree of the deepest of them is collapsed again.
+     */
+    void sync(const std::vector<T>& list, const std::size_t first_changed, const bool added)
+    {
+        const auto frame = [&](std::size_t depth) -> const T& {
+            return merged_frame(list, depth - 1, Orientation::CallerRooted);
+        };
+
+        // The deepest run start above the first change.
+        std::size_t run_depth = 0;
+        const NodeMapValue<T>* run_source = nullptr;
+        const Node<T>* parent = &stacks_;
+        for (std::size_t depth = 1; depth < first_changed && depth <= list.size(); ++depth) {
+            const auto& node = *parent->next_nodes.find(frame(depth));
+            if (depth == 1 || parent->next_nodes.size() != 1 || !(frame(depth - 1) == frame(depth))) {
+                run_depth = depth;
+                run_source = &node;
+            }
+            parent = &node.second;
+        }
+
+        // Adjust the counts down to the run, which is replaced. The table of the target is followed
+        // too, so the ids of the tables that are gone after the change can be dropped.
+        const auto delta_count = [added](auto& count) { count = added ? count + 1 : count - 1; };
+        delta_count(root_.count);
+        Node<T>* target = &root_;
+        std::optional<int> table = -1;
+        for (std::size_t depth = 1; depth < run_depth;) {
+            auto& [key, node] = *target->next_nodes.find(frame(depth));
+            if (starts_table(*target)) {
+                table = known_table_id(table, key);
+            }
+            delta_count(node.count);
+            depth += node.collapsed + 1;
+            target = &node;
+        }
+
+        const auto& run_frame = run_depth == 0 ? frame(1) : run_source->first;
+        const auto old_ids = subtree_table_ids(*target, run_frame, table);
+        if (run_depth == 0) {
+            // A root of the tree is created or erased.
+            root_.next_nodes.erase(frame(1));
+            if (const auto it = stacks_.next_nodes.find(frame(1)); it != stacks_.next_nodes.end()) {
+                root_.next_nodes.emplace(it->first, collapsed_copy(*it));
+            }
+        } else {
+            target->next_nodes.find(run_frame)->second = collapsed_copy(*run_source);
+        }
+
+        if (old_ids.empty()) {
+            return;
+        }
+        std::unordered_set<int> kept;
+        for (const auto& [parent_and_first, id] : subtree_table_ids(*target, run_frame, table)) {
+            kept.insert(id);
+        }
+        for (const auto& [parent_and_first, id] : old_ids) {
+            if (!kept.contains(id)) {
+                table_ids_.erase(parent_and_first);
+                expanded_.erase(id);
+            }
+        }
+    }
+
+    // The children of the node start tables, see dot().
+    bool starts_table(const Node<T>& node) const
+    {
+        return &node == &root_ || node.next_nodes.size() != 1;
+    }
+
+    std::optional<int> known_table_id(const std::optional<int> parent_id, const T& first) const
+    {
+        if (!parent_id) {
+            return std::nullopt;
+        }
+        const auto it = table_ids_.find({*parent_id, first});
+        return it == table_ids_.end() ? std::nullopt : std::optional{it->second};
+    }
+
+    /**
+     * Ids of the tables in the subtree of the child of `parent` with the frame, including the
+     * child's own table if it starts one. `table` is the table of `parent`, if it has an id.
+     */
+    std::vector<std::pair<std::pair<int, T>, int>> subtree_table_ids(
+        const Node<T>& parent, const T& first, std::optional<int> table) const
+    {
+        std::vector<std::pair<std::pair<int, T>, int>> ids;
+        const auto it = parent.next_nodes.find(first);
+        if (it == parent.next_nodes.end()) {
+            return ids;
+        }
+        if (starts_table(parent)) {
+            const auto parent_id = table;
+            table = known_table_id(parent_id, first);
+            if (table) {
+                ids.push_back({{*parent_id, first}, *table});
+            }
+        }
+        if (!table) {
+            return ids;
+        }
+
+        // Only rendered tables have ids, and so only the children of tables with ids.
+        std::vector<std::pair<const NodeMapValue<T>*, int>> tables{{&*it, *table}};
+        while (!tables.empty()) {
+            const auto [first_node, id] = tables.back();
+            tables.pop_back();
+            const auto* last = first_node;
+            while (last->second.next_nodes.size() == 1) {
+                last = &*last->second.next_nodes.begin();
+            }
+            for (const auto& next_node : last->second.next_nodes) {
+                if (const auto next_id = known_table_id(id, next_node.first)) {
+                    ids.push_back({{id, next_node.first}, *next_id});
+                    tables.emplace_back(&next_node, *next_id);
+                }
+            }
+        }
+        return ids;
+    }
+
+    // The node collapsed as a child of a node with another frame.
+    static Node<T> collapsed_copy(const NodeMapValue<T>& source)
+    {
+        Node<T> parent;
+        parent.next_nodes.emplace(source.first, source.second);
+        collapse(parent);
+        return std::move(parent.next_nodes.begin()->second);
+    }
+
+    int table_id(int parent_id, const T& first)
+    {
+        const auto [it, inserted] = table_ids_.try_emplace({parent_id, first}, next_table_id_);
+        if (inserted) {
+            ++next_table_id_;
+        }
+        return it->second;
+    }
+};
+
+template<typename T>
+std::string TreeView<T>::dot(BudgetTracker* tracker)
+{
+    struct Table {
+        const NodeMapValue<T>* first;
+        // -1 for roots.
+        int parent_id;
+        std::size_t depth;
+    };
+
+    // sorted_nodes() returns the descending order, tables are rendered in the ascending one.
+    std::deque<Table> tables;
+    const auto queue_children = [&](const NodeMap<T>& next_nodes, int parent_id, std::size_t depth, bool first) {
+        const auto children = sorted_nodes<T>(next_nodes);
+        if (first) {
+            for (const auto& next_node : children) {
+                tables.push_front({&next_node.get(), parent_id, depth});
+            }
+            return;
+        }
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            tables.push_back({&it->get(), parent_id, depth});
+        }
+    };
+    queue_children(root_.next_nodes, -1, 1, false);
+
+    std::ostringstream table_dot;
+    std::vector<std::reference_wrapper<const NodeMapValue<T>>> chain;
+    std::vector<std::pair<int, int>> table_links;
+    // Placeholders of the tables that are not rendered, with their numbers, by parent ids.
+    std::vector<std::pair<int, std::size_t>> hidden;
+    std::size_t rendered = 0;
+
+    while (!tables.empty()) {
+        if (tracker && !tracker->check(BudgetStage::Render, rendered, rendered + tables.size())) {
+            break;
+        }
+        const auto table = tables.front();
+        tables.pop_front();
+        const auto id = table_id(table.parent_id, table.first->first);
+        if (table.parent_id >= 0) {
+            table_links.emplace_back(table.parent_id, id);
+        }
+
+        chain.clear();
+        const auto* last = table.first;
+        chain.push_back(*last);
+        while (last->second.next_nodes.size() == 1) {
+            last = &*last->second.next_nodes.begin();
+            chain.push_back(*last);
+        }
+        write_dot_table<T>(table_dot, id, chain, Orientation::CallerRooted, DotStyle::Compact);
+        ++rendered;
+
+        const auto& next_nodes = last->second.next_nodes;
+        if (next_nodes.empty()) {
+            continue;
+        }
+
+        if (expanded_.contains(id)) {
+            // Asked for, so they go before the tables that are visible by depth.
+            queue_children(next_nodes, id, table.depth + 1, true);
+        } else if (depth_ == 0 || table.depth < depth_) {
+            queue_children(next_nodes, id, table.depth + 1, false);
+        } else {
+            hidden.emplace_back(id, next_nodes.size());
+        }
+    }
+
+    // The budget ran out. The children of a table are queued together.
+    const auto left_out = tables.size();
+    for (; !tables.empty(); tables.pop_front()) {
+        const auto parent_id = tables.front().parent_id;
+        if (!hidden.empty() && hidden.back().first == parent_id) {
+            ++hidden.back().second;
+        } else {
+            hidden.emplace_back(parent_id, 1);
+        }
+    }
+
+    std::ostringstream dot;
+    write_dot_header(dot, Orientation::CallerRooted, DotStyle::Compact);
+    if (left_out > 0) {
+        dot << "labelloc=t;\nlabel=\"Truncated: " << left_out << " tables not rendered\";\n";
+    }
+    dot << table_dot.str();
+
+    for (const auto& link : table_links) {
+        dot << "table_" << link.first << " -> table_" << link.second << '\n';
+    }
+    for (const auto& [id, count] : hidden) {
+        // The font size of the graph is for tables.
+        if (id < 0) {
+            dot << "table_roots_more [shape=box style=dashed fontsize=14 label=\"+ " << count << " root tables\"]\n";
+            continue;
+        }
+        dot << "table_" << id << "_more [shape=box style=dashed fontsize=14 label=\"+ "
+            << count << " tables\" tooltip=\"Expand\"]\n";
+        dot << "table_" << id << " -> table_" << id << "_more [style=dashed]\n";
+    }
+
+    dot << "}\n";
+    return dot.str();
+}
+
+#endif // TREE_VIEW_HPP
@@ -1,8 +1,40 @@
 #include <time.h>
 #include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <latch>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include "merger.hpp"
+#include "json_export.hpp"
+#include "frame_index.hpp"
+#include "tree_view.hpp"
+#include "heavy_paths.hpp"
+#include "tree_history.hpp"
+#include "stuck_threads.hpp"
+#include "budget.hpp"
+#include "core_file.hpp"
+#include "symbolizer.hpp"
+#include "symbolizer/dwarf_line.hpp"
+#include "unwinder/unwinder.hpp"
+#include "input_parser.hpp"
+#include "perf_script.hpp"
+#include "merger_service.hpp"
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#include "stack_snapshot.hpp"
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
 
 std::filesystem::path baseFolder;
 
@@ -208,6 +240,177 @@ TEST(merge, frame_stacks) {
     EXPECT_EQ(actual, expected);
 }
 
+TEST(merge, remove_stack)
+{
+    Node<int> root;
+    add_stack(root, {C, B, A});
+    add_stack(root, {C, B, A});
+    add_stack(root, {D, A});
+
+    remove_stack(root, {C, B, A});
+    ASSERT_EQ(2, root.count);
+    ASSERT_EQ(1, root.next_nodes.at(A).next_nodes.at(B).count);
+
+    remove_stack(root, {C, B, A});
+    ASSERT_EQ(1, root.count);
+    ASSERT_EQ(1, root.next_nodes.at(A).count);
+    ASSERT_FALSE(root.next_nodes.at(A).next_nodes.contains(B));
+
+    remove_stack(root, {D, A});
+    ASSERT_EQ(Node<int>{}, root);
+}
+
+TEST(merge, remove_prefix_stack)
+{
+    Node<int> root;
+    add_stack(root, {C, B, A});
+    const auto expected = root;
+
+    // No stack ends at B, so nothing is removed.
+    remove_stack(root, {B, A});
+    ASSERT_EQ(expected, root);
+
+    add_stack(root, {B, A});
+    remove_stack(root, {B, A});
+    ASSERT_EQ(expected, root);
+
+    // A stack cut by the depth limit ends at the last merged node.
+    Node<int> limited;
+    add_stack(limited, {D, C, B, A}, 2);
+    add_stack(limited, {B, A}, 2);
+    remove_stack(limited, {C, B, A}, 2);
+    remove_stack(limited, {B, A}, 2);
+    ASSERT_EQ(Node<int>{}, limited);
+}
+
+TEST(merge, wide_fan_out)
+{
+    // Enough children for the hash index of a node.
+    std::vector<std::vector<int>> input;
+    for (int i = 0; i < 20; ++i) {
+        input.push_back({i + 100, A});
+    }
+    std::pmr::monotonic_buffer_resource arena;
+    auto actual = merge(input, 0, &arena);
+
+    auto& children = actual.next_nodes.at(A).next_nodes;
+    ASSERT_EQ(20, children.size());
+    const auto* child = &children.at(105);
+
+    for (int i = 0; i < 20; i += 2) {
+        remove_stack(actual, {i + 100, A});
+    }
+    ASSERT_EQ(10, children.size());
+    ASSERT_FALSE(children.contains(100));
+    ASSERT_EQ(child, &children.at(105));
+
+    Node<int> nodeA{.count=10, .level=1, .next_nodes={} };
+    for (int i = 1; i < 20; i += 2) {
+        nodeA.next_nodes.emplace(i + 100, Node<int>{.count=1, .level=2, .next_nodes={} });
+    }
+    Node<int> expected{.count=10, .level=0, .next_nodes={{A, nodeA}, }};
+    ASSERT_EQ(expected, actual);
+}
+
+TEST(merge, callee_rooted)
+{
+    auto input = std::vector<std::vector<int>>{
+        {G, C, B, A},
+        {G, D, B, A},
+        {G, E, A},
+        {F, F},
+    };
+
+    Node<int> nodeA1{.count=1, .level=4, .next_nodes={} };
+    Node<int> nodeB1{.count=1, .level=3, .next_nodes={{A, nodeA1},} };
+    Node<int> nodeC {.count=1, .level=2, .next_nodes={{B, nodeB1},} };
+    Node<int> nodeA2{.count=1, .level=4, .next_nodes={} };
+    Node<int> nodeB2{.count=1, .level=3, .next_nodes={{A, nodeA2},} };
+    Node<int> nodeD {.count=1, .level=2, .next_nodes={{B, nodeB2},} };
+    Node<int> nodeA3{.count=1, .level=3, .next_nodes={} };
+    Node<int> nodeE {.count=1, .level=2, .next_nodes={{A, nodeA3},} };
+    Node<int> nodeG {.count=3, .level=1, .next_nodes={{C, nodeC}, {D, nodeD}, {E, nodeE},} };
+    Node<int> nodeF {.count=1, .level=1, .next_nodes={}, .collapsed=1};
+
+    Node<int> expected{.count=4, .level=0, .next_nodes={{G, nodeG}, {F, nodeF},} };
+    ASSERT_EQ(expected, merge(input, Orientation::CalleeRooted));
+
+    // The same stacks merged in both orientations from one parse.
+    ASSERT_EQ(2, merge(input).next_nodes.size());
+
+    Node<int> root;
+    for (const auto& stack : input) {
+        add_stack(root, stack, 2, Orientation::CalleeRooted);
+    }
+    ASSERT_EQ(3, root.next_nodes.at(G).next_nodes.size());
+    remove_stack(root, input[0], 2, Orientation::CalleeRooted);
+    ASSERT_EQ(2, root.next_nodes.at(G).count);
+    ASSERT_EQ(1, root.next_nodes.at(F).next_nodes.at(F).count);
+    remove_stack(root, input[1], 2, Orientation::CalleeRooted);
+    ASSERT_FALSE(root.next_nodes.at(G).next_nodes.contains(D));
+}
+
+TEST(merge, duplicate_stacks)
+{
+    auto input = std::vector<std::vector<int>>{
+        {C, B, A},
+        {D, B, A},
+        {C, B, A},
+        {E, C, B, A},
+        {C, B, A},
+    };
+
+    Node<int> nodeE {.count=1, .level=4, .next_nodes={} };
+    Node<int> nodeC {.count=4, .level=3, .next_nodes={{E, nodeE},} };
+    Node<int> nodeD {.count=1, .level=3, .next_nodes={} };
+    Node<int> nodeB {.count=5, .level=2, .next_nodes={{C, nodeC}, {D, nodeD},} };
+    Node<int> nodeA {.count=5, .level=1, .next_nodes={{B, nodeB},} };
+    Node<int> expected{.count=5, .level=0, .next_nodes={{A, nodeA},} };
+    ASSERT_EQ(expected, merge(input));
+
+    // Stacks that differ below the depth limit only are the same.
+    const auto limited = merge(input, 3);
+    ASSERT_EQ(4, limited.next_nodes.at(A).next_nodes.at(B).next_nodes.at(C).count);
+    ASSERT_TRUE(limited.next_nodes.at(A).next_nodes.at(B).next_nodes.at(C).next_nodes.empty());
+    ASSERT_EQ(3, merge(input, Orientation::CalleeRooted, 1).next_nodes.at(C).count);
+}
+
+TEST(merge, weighted_stacks)
+{
+    auto input = std::vector<WeightedStack<int>>{
+        {{C, B, A}, 3},
+        {{D, B, A}, 1},
+        {{E, C, B, A}, 1},
+        {{F}, 0},
+    };
+
+    ASSERT_EQ(merge(std::vector<std::vector<int>>{
+        {C, B, A},
+        {D, B, A},
+        {C, B, A},
+        {E, C, B, A},
+        {C, B, A},
+    }), merge(input));
+}
+
+TEST(dot, callee_rooted)
+{
+    auto input = std::vector<std::vector<std::string>>{
+        {"wait", "lock", "main"},
+        {"wait", "read", "main"},
+    };
+
+    const auto dot = get_dot_graph(merge(input, Orientation::CalleeRooted), Orientation::CalleeRooted);
+    ASSERT_TRUE(dot.contains("rankdir=TB;"));
+    ASSERT_TRUE(dot.contains("table_0 -> table_1 [arrowsize=2 minlen=2 dir=back]"));
+    ASSERT_TRUE(dot.contains("table_0 -> table_2 [arrowsize=2 minlen=2 dir=back]"));
+
+    // Tables show the innermost frames at the top.
+    const auto lock = dot.find("lock");
+    const auto lock_table = dot.substr(dot.rfind("table_", lock), dot.find(">]", lock) - dot.rfind("table_", lock));
+    ASSERT_LT(lock_table.find("lock"), lock_table.find("main"));
+}
+
 TEST(stack_depth_limit, default_limit)
 {
     auto input = std::vector<std::vector<int>>{
@@ -355,6 +558,1246 @@ TEST(dot, recursion) {
     ASSERT_EQ(actualDot, expectedDot);
 }
 
+TEST(dot, parallel)
+{
+    auto input = std::vector<std::vector<int>>{
+       {7, 6, 5, 4, 3, 2, 1},
+       {7, 6, 5, 3, 2, 1},
+    };
+
+    std::ifstream expectedDotFile{baseFolder / "tests_data/test-int.dot"};
+    ASSERT_FALSE(expectedDotFile.fail());
+
+    std::string expectedDot{
+        std::istreambuf_iterator<char>(expectedDotFile),
+        std::istreambuf_iterator<char>()
+    };
+
+    ASSERT_EQ(expectedDot, get_dot_graph_parallel(merge(input), Orientation::CallerRooted, 4));
+
+    const auto read_golden = [](const char* name) {
+        std::ifstream file{baseFolder / "tests_data" / name};
+        return std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    };
+    const auto frames = std::vector<std::vector<Frame>>{
+        {Frame{"func2", "file2.cpp", 20, 10}, Frame{"func1", "file1.cpp", 10, 5}},
+        {Frame{"func3", "file3.cpp", 30, 15}, Frame{"func1", "file1.cpp", 10, 5}}
+    };
+    const auto recursion = std::vector<std::vector<std::string>>{
+       {"e", "d", "c", "b", "a"},
+       {"e", "d", "c", "c", "c", "c", "c", "b", "a"},
+    };
+    const auto expectedFrameDot = read_golden("test-frame.dot");
+    const auto expectedRecursionDot = read_golden("test-recursion.dot");
+    ASSERT_FALSE(expectedFrameDot.empty());
+    ASSERT_FALSE(expectedRecursionDot.empty());
+    ASSERT_EQ(expectedFrameDot, get_dot_graph_parallel(merge(frames), Orientation::CallerRooted, 4));
+    ASSERT_EQ(expectedRecursionDot, get_dot_graph_parallel(merge(recursion), Orientation::CallerRooted, 4));
+
+    // Enough tables for several chunks.
+    std::vector<std::vector<int>> wide;
+    for (int i = 0; i < 1000; ++i) {
+        wide.push_back({i % 7, i % 13, i % 10, A});
+    }
+    const auto tree = merge(wide);
+    ASSERT_EQ(get_dot_graph(tree), get_dot_graph_parallel(tree, Orientation::CallerRooted, 4));
+    ASSERT_EQ(get_dot_graph(tree, Orientation::CalleeRooted), get_dot_graph_parallel(tree, Orientation::CalleeRooted, 3));
+}
+
+TEST(dot, compact)
+{
+    std::vector<std::vector<Frame>> input;
+    for (int i = 0; i < 200; ++i) {
+        input.push_back({
+            Frame{"worker_" + std::to_string(i % 17), "worker.cpp", i % 17, 5},
+            Frame{"pool_" + std::to_string(i % 3), "pool.cpp", 40, 9},
+            Frame{"main", "main.cpp", 10, 1},
+        });
+    }
+    const auto tree = merge(input);
+    const auto verbose = get_dot_graph(tree);
+    const auto compact = get_dot_graph(tree, Orientation::CallerRooted, DotStyle::Compact);
+
+    const auto count = [](std::string_view dot, std::string_view text) {
+        std::size_t result = 0;
+        for (auto i = dot.find(text); i != std::string_view::npos; i = dot.find(text, i + 1)) {
+            ++result;
+        }
+        return result;
+    };
+
+    // The same tables, cells and links, without the common style.
+    ASSERT_EQ(count(verbose, "[label=<"), count(compact, "[label=<"));
+    ASSERT_EQ(count(verbose, "<td"), count(compact, "<td"));
+    ASSERT_EQ(count(verbose, "SIDES=\"LT\""), count(compact, "SIDES=\"LT\""));
+    ASSERT_EQ(count(verbose, " -> "), count(compact, " -> "));
+    ASSERT_EQ(0, count(compact, "POINT-SIZE"));
+    ASSERT_NE(std::string::npos, compact.find("node [shape=plaintext fontsize=40];"));
+    ASSERT_NE(std::string::npos, compact.find("<td COLSPAN=\"3\" BORDER=\"0\">200 Threads</td>"));
+    ASSERT_LT(compact.size() * 3, verbose.size() * 2);
+
+    ASSERT_EQ(compact, get_dot_graph_parallel(tree, Orientation::CallerRooted, 2, DotStyle::Compact));
+
+    const auto callee_rooted = get_dot_graph(tree, Orientation::CalleeRooted, DotStyle::Compact);
+    ASSERT_NE(std::string::npos, callee_rooted.find("edge [arrowsize=2 minlen=2 dir=back];"));
+    ASSERT_EQ(std::string::npos, callee_rooted.find("dir=back]\n}"));
+}
+
+TEST(dot, identical_subtrees)
+{
+    // The same calls 2..6 under the handlers 10 and 11.
+    const auto tree = merge(std::vector<std::vector<int>>{
+        {6, 5, 4, 3, 2, 10, 1},
+        {6, 5, 4, 3, 2, 11, 1},
+        {7, 1},
+    });
+    const auto graph = get_dot_graph(tree);
+    const auto dag = get_dot_dag(tree);
+
+    const auto count = [](std::string_view dot, std::string_view text) {
+        std::size_t result = 0;
+        for (auto i = dot.find(text); i != std::string_view::npos; i = dot.find(text, i + 1)) {
+            ++result;
+        }
+        return result;
+    };
+
+    // The tail of the handlers has a table of its own, linked from both of them.
+    ASSERT_EQ(4, count(graph, "[label=<"));
+    ASSERT_EQ(5, count(dag, "[label=<"));
+    ASSERT_LT(count(dag, "<tr"), count(graph, "<tr"));
+    ASSERT_EQ(1, count(dag, "1 Thread \u00d72"));
+    ASSERT_NE(std::string::npos, dag.find("table_1 -> table_4 "));
+    ASSERT_NE(std::string::npos, dag.find("table_2 -> table_4 "));
+
+    // Subtrees with other numbers of threads are not identical.
+    const auto other_counts = merge(std::vector<std::vector<int>>{
+        {3, 2, 10, 1},
+        {3, 2, 11, 1},
+        {3, 2, 11, 1},
+    });
+    ASSERT_EQ(get_dot_graph(other_counts), get_dot_dag(other_counts));
+
+    const auto compact = get_dot_dag(tree, Orientation::CallerRooted, DotStyle::Compact);
+    ASSERT_EQ(count(dag, " -> "), count(compact, " -> "));
+}
+
+TEST(json, frame_stacks) {
+    auto input = std::vector<std::vector<Frame>>{
+        {Frame{"func2", "file2.cpp", 20, 10}, Frame{"func1", "file1.cpp", 10, 5}},
+        {Frame{"func3", "file3.cpp", 30, 15}, Frame{"func1", "file1.cpp", 10, 5}}
+    };
+
+    std::ifstream expectedJsonFile{baseFolder / "tests_data/test-frame.json"};
+    ASSERT_FALSE(expectedJsonFile.fail());
+
+    std::string expectedJson{
+        std::istreambuf_iterator<char>(expectedJsonFile),
+        std::istreambuf_iterator<char>()
+    };
+
+    const auto actualJson = merge_to_json(input);
+
+    ASSERT_EQ(actualJson, expectedJson);
+}
+
+TEST(json, frame_stacks_lines) {
+    auto input = std::vector<std::vector<Frame>>{
+        {Frame{"func2", "file2.cpp", 20, 10}, Frame{"func1", "file1.cpp", 10, 5}},
+        {Frame{"func3", "file3.cpp", 30, 15}, Frame{"func1", "file1.cpp", 10, 5}}
+    };
+
+    std::ifstream expectedJsonFile{baseFolder / "tests_data/test-frame.jsonl"};
+    ASSERT_FALSE(expectedJsonFile.fail());
+
+    std::string expectedJson{
+        std::istreambuf_iterator<char>(expectedJsonFile),
+        std::istreambuf_iterator<char>()
+    };
+
+    std::ostringstream actualJson;
+    write_json_lines(actualJson, merge(input));
+
+    ASSERT_EQ(actualJson.str(), expectedJson);
+}
+
+TEST(json, escaping) {
+    auto input = std::vector<std::vector<std::string>>{
+        {"b\"\\\n\x01", "a"},
+    };
+
+    const auto actualJson = merge_to_json(input);
+
+    ASSERT_EQ(actualJson,
+        R"({"count":1,"children":[{"frame":"a","count":1,"level":1,"collapsed":0,"children":[)"
+        R"({"frame":"b\"\\\n\u0001","count":1,"level":2,"collapsed":0,"children":[]}]}]})" "\n");
+}
+
+TEST(json, deep_tree) {
+    constexpr int depth = 10000;
+
+    std::vector<int> stack(depth);
+    for (int i = 0; i < depth; ++i) {
+        stack[i] = i;
+    }
+    auto input = std::vector<std::vector<int>>{stack};
+
+    const auto actualJson = merge_to_json(input);
+
+    ASSERT_EQ(depth + 1, std::ranges::count(actualJson, '['));
+    ASSERT_EQ(depth + 1, std::ranges::count(actualJson, ']'));
+}
+
+TEST(tree_view, expand_tables)
+{
+    const auto input = std::vector<std::vector<std::string>>{
+        {"c1", "b", "a"},
+        {"c2", "b", "a"},
+        {"d", "a"},
+    };
+
+    TreeView<std::string> view{input};
+
+    // Only the bottom table with a placeholder of its children.
+    auto dot = view.render(1);
+    ASSERT_NE(std::string::npos, dot.find("table_0 -> table_0_more"));
+    ASSERT_NE(std::string::npos, dot.find("+ 2 tables"));
+    ASSERT_EQ(std::string::npos, dot.find(">b<"));
+
+    dot = view.expand(0);
+    ASSERT_EQ(std::string::npos, dot.find("table_0_more"));
+    ASSERT_NE(std::string::npos, dot.find(">b<"));
+    ASSERT_NE(std::string::npos, dot.find(">d<"));
+    ASSERT_EQ(std::string::npos, dot.find(">c1<"));
+
+    // Table ids do not change between renders.
+    const auto b_table = dot.substr(dot.rfind("table_", dot.find(">b<")));
+    const auto b_id = std::stoi(b_table.substr(6));
+    ASSERT_NE(std::string::npos, dot.find(std::format("table_{} -> table_{}_more", b_id, b_id)));
+    dot = view.expand(b_id);
+    ASSERT_NE(std::string::npos, dot.find(">c1<"));
+    ASSERT_NE(std::string::npos, dot.find(">c2<"));
+
+    // Depth 0 renders everything, the same tables as get_dot_graph().
+    dot = view.render(0);
+    ASSERT_EQ(std::string::npos, dot.find("_more"));
+    ASSERT_EQ(std::ranges::count(get_dot_graph(merge(input), Orientation::CallerRooted, DotStyle::Compact), '\n'),
+              std::ranges::count(dot, '\n'));
+}
+
+TEST(tree_view, render_budget)
+{
+    // The progress callback stops the rendering after the first check interval.
+    const auto one_interval = [] {
+        return BudgetTracker{Budget{.progress = [](BudgetStage, std::size_t done, std::size_t) { return done == 0; }}};
+    };
+
+    std::vector<std::vector<std::string>> input{{"d1", "c", "a"}, {"d2", "c", "a"}};
+    for (int i = 0; i < 600; ++i) {
+        input.push_back({std::format("k{}", i), "b", "a"});
+    }
+    TreeView<std::string> view{input};
+
+    // All tables are visible: a, b, c, k0..k599, d1 and d2.
+    auto tracker = one_interval();
+    auto dot = view.render(3, &tracker);
+    const auto rendered = BudgetTracker::check_interval;
+    ASSERT_NE(std::string::npos, dot.find(std::format("label=\"Truncated: {} tables not rendered\"", 605 - rendered)));
+    ASSERT_NE(std::string::npos, dot.find(">c<"));
+    ASSERT_EQ(std::string::npos, dot.find(">d1<"));
+
+    // The left out children of c take the placeholder of c, and expanding it renders them first.
+    const auto c_table = dot.substr(dot.rfind("table_", dot.find(">c<")));
+    const auto c_id = std::stoi(c_table.substr(6));
+    ASSERT_NE(std::string::npos, dot.find(std::format("table_{}_more [shape=box style=dashed fontsize=14 label=\"+ 2 tables\"", c_id)));
+    tracker = one_interval();
+    dot = view.expand(c_id, &tracker);
+    ASSERT_NE(std::string::npos, dot.find(">d1<"));
+    ASSERT_NE(std::string::npos, dot.find(">d2<"));
+    ASSERT_EQ(std::string::npos, dot.find(std::format("table_{}_more", c_id)));
+
+    // Roots too.
+    std::vector<std::vector<std::string>> roots;
+    for (int i = 0; i < 600; ++i) {
+        roots.push_back({std::format("r{}", i)});
+    }
+    TreeView<std::string> roots_view{roots};
+    tracker = one_interval();
+    dot = roots_view.render(0, &tracker);
+    ASSERT_NE(std::string::npos, dot.find(std::format("table_roots_more [shape=box style=dashed fontsize=14 label=\"+ {} root tables\"]", 600 - rendered)));
+
+    // Without a budget, everything.
+    ASSERT_EQ(std::string::npos, roots_view.render(0).find("_more"));
+}
+
+TEST(tree_view, stack_deltas)
+{
+    const auto input = std::vector<std::vector<std::string>>{
+        {"c1", "b", "a"},
+        {"d", "a"},
+    };
+
+    TreeView<std::string> view{input};
+    view.render(0);
+    ASSERT_EQ(merge(input), view.root());
+
+    // The thread moves from c1 to c2, a new thread appears.
+    view.remove_stack({"c1", "b", "a"});
+    view.add_stack({"c2", "b", "a"});
+    view.add_stack({"e"});
+    const auto expected = std::vector<std::vector<std::string>>{
+        {"c2", "b", "a"},
+        {"d", "a"},
+        {"e"},
+    };
+    ASSERT_EQ(merge(expected), view.root());
+
+    // Removing an unknown stack changes nothing.
+    view.remove_stack({"x", "a"});
+    ASSERT_EQ(merge(expected), view.root());
+
+    const auto dot = view.dot();
+    ASSERT_EQ(std::string::npos, dot.find(">c1<"));
+    ASSERT_NE(std::string::npos, dot.find(">c2<"));
+
+    // The tables that stay keep their ids.
+    const auto table_of = [](const std::string& dot, const std::string& frame) {
+        return dot.substr(dot.rfind("table_", dot.find(frame)), 8);
+    };
+    view.add_stack({"f", "d", "a"});
+    view.remove_stack({"e"});
+    const auto changed = view.dot();
+    ASSERT_EQ(table_of(dot, ">a<"), table_of(changed, ">a<"));
+    ASSERT_EQ(table_of(dot, ">c2<"), table_of(changed, ">c2<"));
+    ASSERT_EQ(std::string::npos, changed.find(">e<"));
+}
+
+TEST(tree_view, incremental_matches_merge)
+{
+    // Few frames, so stacks share prefixes and recursion makes and breaks collapsed runs.
+    std::vector<std::vector<std::string>> stacks;
+    TreeView<std::string> view{stacks};
+    std::mt19937 random{42};
+    for (int step = 0; step < 2000; ++step) {
+        if (!stacks.empty() && random() % 3 == 0) {
+            const auto index = random() % stacks.size();
+            view.remove_stack(stacks[index]);
+            stacks.erase(stacks.begin() + static_cast<std::ptrdiff_t>(index));
+        } else {
+            std::vector<std::string> stack(random() % 6 + 1);
+            for (auto& frame : stack) {
+                frame = std::string(1, static_cast<char>('a' + random() % 3));
+            }
+            view.add_stack(stack);
+            stacks.push_back(std::move(stack));
+        }
+        ASSERT_EQ(merge(stacks), view.root()) << "step " << step;
+
+        // Only the tables that still exist keep their ids.
+        const auto dot = view.render(0);
+        std::size_t tables = 0;
+        for (auto i = dot.find("[label=<"); i != std::string::npos; i = dot.find("[label=<", i + 1)) {
+            ++tables;
+        }
+        ASSERT_EQ(tables, view.table_id_count()) << "step " << step;
+    }
+}
+
+TEST(frame_index, count_and_callers)
+{
+    const auto input = std::vector<std::vector<std::string>>{
+        {"lock", "b", "a"},
+        {"lock", "b", "a"},
+        {"lock", "c", "a"},
+        {"x", "lock", "b", "lock", "a"},
+        {"d", "a"},
+    };
+
+    const auto tree = merge(input);
+    const FrameIndex<std::string> index{tree};
+
+    // The stack with the indirect recursion is counted once.
+    ASSERT_EQ(4, index.count("lock"));
+    ASSERT_EQ(5, index.count("a"));
+    ASSERT_EQ(0, index.count("unknown"));
+    ASSERT_EQ(3, index.subtrees("lock").size());
+
+    const auto expected = std::vector<std::pair<std::string, std::size_t>>{
+        {"b", 2}, {"a", 1}, {"c", 1},
+    };
+    ASSERT_EQ(expected, index.callers("lock"));
+}
+
+TEST(frame_index, filter)
+{
+    const auto matched = std::vector<std::vector<std::string>>{
+        {"lock", "b", "a"},
+        {"lock", "c", "a"},
+        {"x", "lock", "b", "lock", "a"},
+    };
+    auto input = matched;
+    input.push_back({"d", "a"});
+    input.push_back({"e"});
+
+    const auto tree = merge(input);
+    const FrameIndex<std::string> index{tree};
+
+    ASSERT_EQ(merge(matched), index.filter("lock"));
+    ASSERT_EQ(0, index.filter("unknown").count);
+    ASSERT_EQ(get_dot_graph(merge(matched)), get_dot_graph(index.filter("lock")));
+}
+
+TEST(budget, unlimited)
+{
+    const std::vector<std::vector<int>> input{{3, 2, 1}, {4, 2, 1}, {5, 1}};
+    const auto result = merge_to_graphviz_dot_budgeted(input, Budget{});
+    ASSERT_FALSE(result.truncated);
+    ASSERT_EQ(get_dot_graph(merge(input)), result.dot);
+}
+
+TEST(budget, truncated)
+{
+    // 600 leaves under two callers, so rendering is checked more than once.
+    std::vector<std::vector<int>> input;
+    for (int i = 0; i < 600; ++i) {
+        input.push_back({2000 + i, 1000 + i % 2, 0});
+    }
+
+    const auto count = [](std::string_view dot, std::string_view text) {
+        std::size_t result = 0;
+        for (auto i = dot.find(text); i != std::string_view::npos; i = dot.find(text, i + 1)) {
+            ++result;
+        }
+        return result;
+    };
+
+    // The node limit is checked before each stack, so the tree may exceed it by one stack.
+    {
+        BudgetTracker tracker{Budget{.node_limit = 10}};
+        const auto merged = merge(input, tracker);
+        ASSERT_TRUE(merged.truncated());
+        ASSERT_EQ(600, merged.total_stacks);
+        ASSERT_EQ(7, merged.merged_stacks);
+        ASSERT_EQ(7, merged.tree.count);
+    }
+
+    // Cancelled rendering leaves placeholders for the tables that are not rendered.
+    std::vector<std::pair<BudgetStage, std::size_t>> progress;
+    const auto rendered = merge_to_graphviz_dot_budgeted(input, Budget{
+        .progress = [&](BudgetStage stage, std::size_t done, std::size_t) {
+            progress.emplace_back(stage, done);
+            return stage == BudgetStage::Merge || done < BudgetTracker::check_interval;
+        },
+    });
+    ASSERT_TRUE(rendered.truncated);
+    ASSERT_EQ(BudgetTracker::check_interval, count(rendered.dot, "[label=<"));
+    ASSERT_NE(std::string::npos, rendered.dot.find("label=\"Truncated: 347 tables not rendered\";"));
+    // The caller 1001 and the rest of the leaves of the caller 1000.
+    ASSERT_EQ(2, count(rendered.dot, "_more [shape=box"));
+    ASSERT_EQ(BudgetTracker::check_interval + 1, count(rendered.dot, " -> "));
+    ASSERT_TRUE(rendered.dot.ends_with("}\n"));
+    ASSERT_EQ((std::vector<std::pair<BudgetStage, std::size_t>>{
+        {BudgetStage::Merge, 0}, {BudgetStage::Merge, 256}, {BudgetStage::Merge, 512},
+        {BudgetStage::Render, 0}, {BudgetStage::Render, 256},
+    }), progress);
+
+    // All roots are rendered before the deeper tables, the others are left with a placeholder.
+    std::vector<std::vector<int>> roots;
+    for (int i = 0; i < 300; ++i) {
+        roots.push_back({2000 + 2 * i, 1000 + i});
+        roots.push_back({2001 + 2 * i, 1000 + i});
+    }
+    const auto rendered_roots = merge_to_graphviz_dot_budgeted(roots, Budget{
+        .progress = [&](BudgetStage stage, std::size_t done, std::size_t) {
+            return stage == BudgetStage::Merge || done < BudgetTracker::check_interval;
+        },
+    });
+    ASSERT_EQ(BudgetTracker::check_interval, count(rendered_roots.dot, "[label=<"));
+    ASSERT_NE(std::string::npos, rendered_roots.dot.find("table_roots_more [shape=box style=dashed fontsize=14 label=\"+ 44 root tables\"]"));
+    ASSERT_EQ(BudgetTracker::check_interval, count(rendered_roots.dot, "_more [shape=box style=dashed fontsize=14 label=\"+ 2 tables\"]"));
+
+    // A stop request cancels the work before the first stack.
+    std::stop_source stop;
+    stop.request_stop();
+    const auto stopped = merge_to_graphviz_dot_budgeted(input, Budget{.stop_token = stop.get_token()});
+    ASSERT_TRUE(stopped.truncated);
+    ASSERT_EQ(0, count(stopped.dot, "[label=<"));
+    ASSERT_NE(std::string::npos, stopped.dot.find("label=\"Truncated: 600 stacks not merged\";"));
+}
+
+TEST(symbolizer, unknown_addresses)
+{
+    auto input = std::vector<std::vector<std::uint64_t>>{
+        {0x30, 0x20, 0x10},
+        {0x31, 0x20, 0x10},
+    };
+
+    const auto addressTree = merge(input);
+
+    Symbolizer symbolizer;
+    const auto tree = symbolize_tree(addressTree, symbolizer);
+
+    ASSERT_EQ(2, tree.count);
+    const auto& node10 = tree.next_nodes.at(SymbolizedAddress{.address = 0x10});
+    ASSERT_EQ(2, node10.count);
+    ASSERT_EQ(nullptr, tree.next_nodes.begin()->first.symbol);
+    ASSERT_EQ(2, node10.next_nodes.at(SymbolizedAddress{.address = 0x20}).next_nodes.size());
+
+    const auto dot = get_dot_graph(tree);
+    ASSERT_NE(std::string::npos, dot.find("0x31"));
+}
+
+#ifdef __linux__
+[[gnu::noinline]] int symbolizer_test_function(int value)
+{
+    return value * 3;
+}
+
+TEST(symbolizer, self_with_cache)
+{
+    const auto cacheDir = std::filesystem::temp_directory_path()
+        / ("threads-merger-tests-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(cacheDir);
+
+    const auto address = reinterpret_cast<std::uint64_t>(&symbolizer_test_function);
+
+    for (std::size_t expectedResolved : {1, 0}) {
+        Symbolizer symbolizer{cacheDir};
+        std::ifstream maps{"/proc/self/maps"};
+        symbolizer.load_proc_maps(maps);
+
+        const auto symbol = symbolizer.symbolize(address);
+        ASSERT_NE(nullptr, symbol);
+        EXPECT_EQ("symbolizer_test_function(int)", symbol->function);
+
+        // The same address is symbolized once.
+        ASSERT_EQ(symbol, symbolizer.symbolize(address));
+
+        // The second symbolizer finds the address in the cache.
+        EXPECT_EQ(expectedResolved, symbolizer.resolved_count());
+    }
+
+    std::filesystem::remove_all(cacheDir);
+}
+
+TEST(symbolizer, shared_modules)
+{
+    const auto address = reinterpret_cast<std::uint64_t>(&symbolizer_test_function);
+    const auto modules = std::make_shared<SymbolModules>();
+
+    // Symbolizers of several inputs on several threads read the debug information once.
+    std::vector<std::shared_ptr<const Symbol>> symbols(4);
+    {
+        std::vector<std::jthread> threads;
+        for (auto& symbol : symbols) {
+            threads.emplace_back([&modules, &symbol, address] {
+                Symbolizer symbolizer{modules};
+                std::ifstream maps{"/proc/self/maps"};
+                symbolizer.load_proc_maps(maps);
+                symbol = symbolizer.symbolize(address);
+            });
+        }
+    }
+
+    for (const auto& symbol : symbols) {
+        ASSERT_NE(nullptr, symbol);
+        EXPECT_EQ("symbolizer_test_function(int)", symbol->function);
+    }
+    EXPECT_EQ(1, modules->resolved_count());
+}
+#endif
+
+TEST(dwarf_line, version5_default_file)
+{
+    // A DWARF 5 line program with files 0 "a.c" and 1 "b.c" in "/src". Rows before
+    // DW_LNS_set_file have file 1, as in all versions.
+    std::vector<std::uint8_t> header{
+        1, 1, 1, static_cast<std::uint8_t>(-5), 14, 13,     // instruction length .. opcode_base
+        0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1,                 // standard opcode lengths
+        1, 1, 0x08, 1, '/', 's', 'r', 'c', 0,                // directories: path as a string
+        2, 1, 0x08, 2, 0x0f, 2,                              // files: path, directory index
+        'a', '.', 'c', 0, 0, 'b', '.', 'c', 0, 0,
+    };
+    const std::vector<std::uint8_t> program{
+        0, 9, 2, 0x00, 0x10, 0, 0, 0, 0, 0, 0,              // DW_LNE_set_address 0x1000
+        1,                                                   // DW_LNS_copy
+        2, 0x10,                                             // DW_LNS_advance_pc 16
+        0, 1, 1,                                             // DW_LNE_end_sequence
+    };
+
+    std::vector<std::uint8_t> unit{5, 0, 8, 0};              // version, address and selector sizes
+    for (int i = 0; i < 4; ++i) {
+        unit.push_back(static_cast<std::uint8_t>(header.size() >> (8 * i)));
+    }
+    unit.insert(unit.end(), header.begin(), header.end());
+    unit.insert(unit.end(), program.begin(), program.end());
+    std::vector<std::uint8_t> section;
+    for (int i = 0; i < 4; ++i) {
+        section.push_back(static_cast<std::uint8_t>(unit.size() >> (8 * i)));
+    }
+    section.insert(section.end(), unit.begin(), unit.end());
+
+    const Dwarf::LineTable table{Dwarf::LineSections{.debug_line = std::as_bytes(std::span{section})}};
+    const auto line = table.find(0x1008);
+    ASSERT_TRUE(line);
+    EXPECT_EQ("/src/b.c", line->filename);
+    EXPECT_EQ(1, line->row);
+}
+
+class TestMemory : public Unwind::Memory
+{
+public:
+    std::map<std::uint64_t, std::uint64_t> words;
+
+    std::optional<std::uint64_t> read_u64(std::uint64_t address) const override {
+        const auto it = words.find(address);
+        return it == words.end() ? std::nullopt : std::optional{it->second};
+    }
+};
+
+TEST(unwinder, frame_pointers)
+{
+    // Frame records of x86-64: the previous rbp, then the return address.
+    TestMemory memory;
+    memory.words = {
+        {0x1000, 0x1100}, {0x1008, 0x401010},
+        {0x1100, 0}, {0x1108, 0x402020},
+    };
+
+    Unwind::Registers registers;
+    registers.pc = 0x400500;
+    registers.set(6, 0x1000); // rbp
+    registers.set(7, 0x0FF0); // rsp
+
+    Unwind::Unwinder unwinder{Unwind::Architecture::X86_64, memory, {}};
+
+    // The return addresses point into the call instructions.
+    const auto expected = std::vector<std::uint64_t>{0x400500, 0x40100F, 0x40201F};
+    ASSERT_EQ(expected, unwinder.unwind(registers));
+    ASSERT_EQ(2, unwinder.unwind(registers, 2).size());
+}
+
+TEST(core_file, synthetic_core)
+{
+    // An x86-64 core dump with two threads, two mapped files and two dumped segments.
+    std::vector<std::byte> notes;
+    const auto append = [](std::vector<std::byte>& bytes, const auto& value) {
+        const auto* begin = reinterpret_cast<const std::byte*>(&value);
+        bytes.insert(bytes.end(), begin, begin + sizeof(value));
+    };
+    const auto add_note = [&](std::uint32_t type, std::vector<std::byte> desc) {
+        desc.resize((desc.size() + 3) & ~std::size_t{3});
+        append(notes, std::uint32_t{5});
+        append(notes, static_cast<std::uint32_t>(desc.size()));
+        append(notes, type);
+        append(notes, std::array<char, 8>{'C', 'O', 'R', 'E'});
+        notes.insert(notes.end(), desc.begin(), desc.end());
+    };
+    // struct elf_prstatus: the pid at 32, then user_regs_struct at 112 with rbp, rip and rsp.
+    const auto add_thread = [&](std::int32_t tid, std::uint64_t rip, std::uint64_t rsp, std::uint64_t rbp) {
+        std::vector<std::byte> desc(336);
+        std::memcpy(desc.data() + 32, &tid, sizeof(tid));
+        std::memcpy(desc.data() + 112 + 4 * 8, &rbp, sizeof(rbp));
+        std::memcpy(desc.data() + 112 + 16 * 8, &rip, sizeof(rip));
+        std::memcpy(desc.data() + 112 + 19 * 8, &rsp, sizeof(rsp));
+        add_note(1, std::move(desc));
+    };
+    add_thread(101, 0x400500, 0x6FF0, 0x7000);
+    add_thread(102, 0x400600, 0x6F00, 0);
+
+    std::vector<std::byte> files;
+    for (const std::uint64_t value : std::initializer_list<std::uint64_t>{2, 4096, 0x400000, 0x401000, 0, 0x500000, 0x502000, 2}) {
+        append(files, value);
+    }
+    for (const char c : std::string_view{"/nonexistent/app\0/nonexistent/lib.so\0", 37}) {
+        append(files, c);
+    }
+    add_note(0x46494c45, std::move(files));
+
+    // The frame record of the first thread, and a word of another segment.
+    std::vector<std::byte> memory;
+    for (const std::uint64_t value : std::initializer_list<std::uint64_t>{0, 0x401010, 0x1122334455667788}) {
+        append(memory, value);
+    }
+
+    constexpr std::uint64_t notes_offset = sizeof(Elf::FileHeader) + 3 * sizeof(Elf::ProgramHeader);
+    const auto memory_offset = notes_offset + notes.size();
+    Elf::FileHeader header{.ident = {0x7f, 'E', 'L', 'F', 2, 1, 1}, .type = 4, .machine = 62, .version = 1};
+    header.phoff = sizeof(Elf::FileHeader);
+    header.ehsize = sizeof(Elf::FileHeader);
+    header.phentsize = sizeof(Elf::ProgramHeader);
+    header.phnum = 3;
+    const Elf::ProgramHeader segments[] = {
+        {.type = Elf::PT_NOTE, .offset = notes_offset, .filesz = notes.size()},
+        // Only the first 16 bytes of the stack page are dumped.
+        {.type = Elf::PT_LOAD, .offset = memory_offset, .vaddr = 0x7000, .filesz = 16, .memsz = 0x1000},
+        {.type = Elf::PT_LOAD, .offset = memory_offset + 16, .vaddr = 0x1000, .filesz = 8, .memsz = 8},
+    };
+
+    std::vector<std::byte> core;
+    append(core, header);
+    append(core, segments);
+    core.insert(core.end(), notes.begin(), notes.end());
+    core.insert(core.end(), memory.begin(), memory.end());
+
+    const auto path = std::filesystem::temp_directory_path() / ("core-file-" + std::to_string(::getpid()));
+    {
+        std::ofstream file{path, std::ios::binary};
+        file.write(reinterpret_cast<const char*>(core.data()), static_cast<std::streamsize>(core.size()));
+    }
+    const CoreFile core_file{path};
+    std::filesystem::remove(path);
+
+    ASSERT_EQ(Unwind::Architecture::X86_64, core_file.architecture());
+    ASSERT_EQ(2, core_file.threads().size());
+    const auto& thread = core_file.threads()[0];
+    ASSERT_EQ(101, thread.tid);
+    ASSERT_EQ(0x400500, thread.registers.pc);
+    ASSERT_EQ(0x6FF0, thread.registers.values[7]);
+    ASSERT_EQ(0x7000, thread.registers.values[6]);
+    ASSERT_EQ(102, core_file.threads()[1].tid);
+    ASSERT_EQ(0x400600, core_file.threads()[1].registers.pc);
+
+    ASSERT_EQ(2, core_file.mappings().size());
+    const auto& library = core_file.mappings()[1];
+    ASSERT_EQ(0x500000, library.start);
+    ASSERT_EQ(0x502000, library.end);
+    ASSERT_EQ(2 * 4096, library.offset);
+    ASSERT_EQ("/nonexistent/lib.so", library.path);
+
+    ASSERT_EQ(0x401010, core_file.read_u64(0x7008));
+    ASSERT_EQ(0x1122334455667788, core_file.read_u64(0x1000));
+    // Not dumped, crossing the end of a dumped part, and not mapped.
+    ASSERT_FALSE(core_file.read_u64(0x7010));
+    ASSERT_FALSE(core_file.read_u64(0x700C));
+    ASSERT_FALSE(core_file.read_u64(0x800));
+
+    const auto stacks = core_file.stacks();
+    ASSERT_EQ(2, stacks.size());
+    ASSERT_EQ((std::vector<std::uint64_t>{0x400500, 0x40100F}), stacks[0]);
+    ASSERT_EQ(0x400600, stacks[1].front());
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+class SelfMemory : public Unwind::Memory
+{
+public:
+    SelfMemory() : fd_(::open("/proc/self/mem", O_RDONLY | O_CLOEXEC)) {}
+    ~SelfMemory() override { ::close(fd_); }
+
+    std::optional<std::uint64_t> read_u64(std::uint64_t address) const override {
+        std::uint64_t value = 0;
+        if (::pread(fd_, &value, sizeof(value), static_cast<off_t>(address)) != sizeof(value)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+private:
+    int fd_;
+};
+
+[[gnu::noinline]] std::vector<std::uint64_t> unwinder_test_inner(Unwind::Unwinder& unwinder)
+{
+    std::uint64_t rip = 0, rsp = 0, rbp = 0, rbx = 0;
+    asm volatile(
+        "lea 0(%%rip), %0\n"
+        "mov %%rsp, %1\n"
+        "mov %%rbp, %2\n"
+        "mov %%rbx, %3\n"
+        : "=r"(rip), "=r"(rsp), "=r"(rbp), "=r"(rbx));
+
+    Unwind::Registers registers;
+    registers.pc = rip;
+    registers.set(7, rsp);
+    registers.set(6, rbp);
+    registers.set(3, rbx);
+
+    // The captured frame stays alive while it is unwound.
+    auto frames = unwinder.unwind(registers);
+    asm volatile("" ::: "memory");
+    return frames;
+}
+
+[[gnu::noinline]] std::vector<std::uint64_t> unwinder_test_outer(Unwind::Unwinder& unwinder)
+{
+    auto frames = unwinder_test_inner(unwinder);
+    asm volatile("" ::: "memory");
+    return frames;
+}
+
+TEST(unwinder, self)
+{
+    std::ifstream maps{"/proc/self/maps"};
+    SelfMemory memory;
+    Unwind::Unwinder unwinder{Unwind::Architecture::X86_64, memory, parse_proc_maps(maps)};
+
+    const auto frames = unwinder_test_outer(unwinder);
+    ASSERT_GE(frames.size(), 3);
+
+    Symbolizer symbolizer;
+    std::ifstream maps_again{"/proc/self/maps"};
+    symbolizer.load_proc_maps(maps_again);
+    ASSERT_EQ("unwinder_test_inner(Unwind::Unwinder&)", symbolizer.symbolize(frames[0])->function);
+    ASSERT_EQ("unwinder_test_outer(Unwind::Unwinder&)", symbolizer.symbolize(frames[1])->function);
+    ASSERT_EQ("unwinder_self_Test::TestBody()", symbolizer.symbolize(frames[2])->function);
+}
+#endif
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+[[gnu::noinline]] void snapshot_test_wait(std::latch& started, const std::stop_token& stop)
+{
+    started.count_down();
+    while (!stop.stop_requested()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    asm volatile("" ::: "memory");
+}
+
+TEST(stack_snapshot, own_threads)
+{
+    Snapshot::StackSnapshotter snapshotter;
+
+    constexpr int thread_count = 3;
+    std::latch started{thread_count};
+    // The threads stop when they are destroyed, also after a failed assertion.
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&](std::stop_token stop) { snapshot_test_wait(started, stop); });
+    }
+    started.wait();
+
+    // The calling thread is not in the snapshot.
+    const auto snapshot = snapshotter.capture();
+    ASSERT_EQ(thread_count, snapshot.stacks.size());
+    ASSERT_EQ(0, snapshot.missed_threads);
+    ASSERT_EQ(thread_count, snapshot.thread_ids.size());
+    ASSERT_EQ(snapshot.thread_ids.end(), std::ranges::find(snapshot.thread_ids, static_cast<int>(::gettid())));
+
+    const auto tree = snapshotter.merged_tree();
+    ASSERT_EQ(thread_count, tree.count);
+    const auto dot = get_dot_graph(tree);
+    ASSERT_NE(std::string::npos, dot.find("snapshot_test_wait("));
+    ASSERT_NE(std::string::npos, dot.find(std::to_string(thread_count) + " Threads"));
+
+    // A dump is written by a background thread.
+    const auto path = std::filesystem::temp_directory_path() / ("stack-snapshot-" + std::to_string(::getpid()) + ".dot");
+    std::filesystem::remove(path);
+    {
+        Snapshot::DumpOnSignal dump{snapshotter, SIGUSR2, path};
+        ::raise(SIGUSR2);
+        for (int i = 0; i < 500 && !std::filesystem::exists(path); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+    }
+    std::ifstream file{path};
+    const std::string dumped{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    std::filesystem::remove(path);
+    ASSERT_NE(std::string::npos, dumped.find("snapshot_test_wait("));
+}
+#endif
+
+TEST(input_parser, frames)
+{
+    const auto actual = parse_input_frames("bbb:file2.cpp:15:4, aaa; ccc:file3.cpp:7,aaa::;");
+
+    const auto expected = std::vector<std::vector<Frame>>{
+        {Frame{"bbb", "file2.cpp", 15, 4}, Frame{"aaa", "", 0, 0}},
+        {Frame{"ccc", "file3.cpp", 7, 0}, Frame{"aaa", "", 0, 0}},
+    };
+
+    ASSERT_EQ(actual, expected);
+    ASSERT_THROW(parse_input_frames("aaa:file.cpp:x"), std::runtime_error);
+    ASSERT_THROW(parse_input_frames("aaa:file.cpp:99999999999"), std::runtime_error);
+    // Numbers are read like std::stoi() reads them, the rest of a field is ignored.
+    ASSERT_EQ((std::vector<std::vector<Frame>>{{Frame{"aaa", "file.cpp", 1, 2}}}), parse_input_frames("aaa:file.cpp:1:2:3"));
+    ASSERT_EQ((std::vector<std::vector<Frame>>{{Frame{"aaa", "file.cpp", 5, -2}}}), parse_input_frames("aaa:file.cpp:+5: -2"));
+    ASSERT_EQ((std::vector<std::vector<Frame>>{{Frame{"aaa", "file.cpp", 12, 0}}}), parse_input_frames("aaa:file.cpp:12abc"));
+    ASSERT_THROW(parse_input_frames("aaa, :file.cpp"), std::runtime_error);
+}
+
+TEST(input_parser, long_input)
+{
+    // Separators at all offsets of the scanned blocks.
+    std::string input;
+    std::string frames_input;
+    std::string addresses_input;
+    std::vector<std::vector<std::string>> expected;
+    std::vector<std::vector<Frame>> expected_frames;
+    std::vector<std::vector<std::uint64_t>> expected_addresses;
+    for (int i = 0; i < 100; ++i) {
+        const auto name = std::string(i % 7 + 1, 'a' + i % 26);
+        input += " " + name + ", " + name + "x,," + name + "y ;;";
+        expected.push_back({name, name + "x", name + "y"});
+        frames_input += std::format("{}:file{}.cpp:{}:{} , main ;", name, i, i, i % 5);
+        expected_frames.push_back({Frame{name, std::format("file{}.cpp", i), i, i % 5}, Frame{"main", "", 0, 0}});
+        addresses_input += std::format("{:#x},{:x};", i * 4096 + 16, i);
+        expected_addresses.push_back({std::uint64_t(i) * 4096 + 16, std::uint64_t(i)});
+    }
+
+    ASSERT_EQ(expected, parse_input(input));
+    ASSERT_EQ(expected_frames, parse_input_frames(frames_input));
+    ASSERT_EQ(expected_addresses, parse_input_addresses(addresses_input));
+    ASSERT_TRUE(parse_input(" ; ,, ;").empty());
+}
+
+TEST(perf_script, samples)
+{
+    std::istringstream input{
+        "# ========\n"
+        "# captured on: Mon Oct 19 10:00:00 2026\n"
+        "Web Content  4021/4022  [001] 10.000001:     250000 cycles:P: \n"
+        "\t    7f01a2b3c4d5 std::vector<int, std::allocator<int> >::push_back(int const&)+0x15 (/usr/lib/libxul.so)\n"
+        "\t    55d0c0ffee10 main+0x20 (/opt/app/app)\n"
+        "\n"
+        "swapper     0 [000] 10.000002:     250000 cycles:P: \n"
+        "\n"
+        "app 4023 10.000003: 1 cpu-clock:\n"
+        "\tffffffff81000010 [unknown] ([kernel.kallsyms])\n"
+        "\t    55d0c0ffee10 main+0x20 (/opt/app/app)\n"
+        "app 4023 10.000004: 1 cpu-clock:\n"
+        "\t    55d0c0ffee10 main+0x20 (/opt/app/app)\n"};
+
+    PerfScriptReader reader{input};
+    PerfSample sample;
+
+    ASSERT_TRUE(reader.next(sample));
+    ASSERT_EQ(sample.comm, "Web Content");
+    ASSERT_EQ(sample.pid, 4021);
+    ASSERT_EQ(sample.tid, 4022);
+    ASSERT_EQ(sample.stack, (std::vector<Frame>{
+        Frame{"std::vector<int, std::allocator<int> >::push_back(int const&)", "libxul.so", 0, 0},
+        Frame{"main", "app", 0, 0},
+    }));
+
+    // The sample without frames is skipped; the last ones end without empty lines.
+    ASSERT_TRUE(reader.next(sample));
+    ASSERT_EQ(sample.comm, "app");
+    ASSERT_EQ(sample.tid, 4023);
+    ASSERT_EQ(sample.stack, (std::vector<Frame>{
+        Frame{"0xffffffff81000010", "[kernel.kallsyms]", 0, 0},
+        Frame{"main", "app", 0, 0},
+    }));
+
+    ASSERT_TRUE(reader.next(sample));
+    ASSERT_EQ(sample.stack, (std::vector<Frame>{Frame{"main", "app", 0, 0}}));
+    ASSERT_FALSE(reader.next(sample));
+}
+
+TEST(perf_script, grouping)
+{
+    const std::string text =
+        "app 10/11 1.0: 1 cycles:\n"
+        "\t1 work+0x1 (app)\n"
+        "\t2 main+0x2 (app)\n"
+        "\n"
+        "app 10/12 1.0: 1 cycles:\n"
+        "\t1 work+0x1 (app)\n"
+        "\t2 main+0x2 (app)\n"
+        "\n"
+        "app 10/11 2.0: 1 cycles:\n"
+        "\t3 idle+0x3 (app)\n"
+        "\t2 main+0x2 (app)\n"
+        "\n";
+
+    const auto roots = [&](const PerfGrouping grouping, const Orientation orientation = Orientation::CallerRooted) {
+        std::istringstream input{text};
+        Node<Frame> root;
+        EXPECT_EQ(add_perf_script(root, input, grouping, 0, orientation), 3u);
+        collapse(root);
+        std::map<std::string, std::size_t> counts;
+        for (const auto& [frame, node] : root.next_nodes) {
+            counts[frame.function] = node.count;
+        }
+        return counts;
+    };
+
+    ASSERT_EQ(roots(PerfGrouping::None), (std::map<std::string, std::size_t>{{"main", 3}}));
+    ASSERT_EQ(roots(PerfGrouping::Command), (std::map<std::string, std::size_t>{{"app", 3}}));
+    ASSERT_EQ(roots(PerfGrouping::Thread), (std::map<std::string, std::size_t>{{"app/11", 2}, {"app/12", 1}}));
+
+    // The groups are the roots of a callee-rooted tree too.
+    ASSERT_EQ(roots(PerfGrouping::None, Orientation::CalleeRooted), (std::map<std::string, std::size_t>{{"idle", 1}, {"work", 2}}));
+    ASSERT_EQ(roots(PerfGrouping::Thread, Orientation::CalleeRooted), (std::map<std::string, std::size_t>{{"app/11", 2}, {"app/12", 1}}));
+}
+
+TEST(heavy_paths, exact_within_capacity)
+{
+    const auto input = std::vector<std::vector<int>>{
+        {D, C, B, A},
+        {E, C, B, A},
+        {F, B, A},
+        {D, C, B, A},
+        {G},
+    };
+    HeavyPaths<int> paths{16};
+    for (const auto& stack : input) {
+        paths.add_stack(stack);
+    }
+
+    ASSERT_EQ(7, paths.size());
+    ASSERT_EQ(5, paths.total());
+    ASSERT_EQ(0, paths.max_error());
+    Node<int> expected;
+    for (const auto& stack : input) {
+        add_stack(expected, stack);
+    }
+    auto tree = paths.tree();
+    ASSERT_EQ(expected, tree);
+
+    // The heaviest paths only: A, B, C, D.
+    tree = paths.tree(4);
+    ASSERT_EQ(5, tree.count);
+    ASSERT_EQ(4, tree.next_nodes.at(A).count);
+    ASSERT_EQ(2, tree.next_nodes.at(A).next_nodes.at(B).next_nodes.at(C).next_nodes.at(D).count);
+    ASSERT_FALSE(tree.next_nodes.contains(G));
+    ASSERT_FALSE(tree.next_nodes.at(A).next_nodes.at(B).next_nodes.contains(F));
+}
+
+TEST(heavy_paths, bounded_stream)
+{
+    // A hot stack among many stacks that are seen once.
+    constexpr std::size_t capacity = 64;
+    HeavyPaths<int> paths{capacity};
+    std::size_t hot = 0;
+    for (int i = 0; i < 100000; ++i) {
+        if (i % 4 == 0) {
+            paths.add_stack({C, B, A});
+            ++hot;
+        } else {
+            paths.add_stack({1000 + i, 100 + i % 7, A});
+        }
+        ASSERT_LE(paths.size(), capacity);
+    }
+    ASSERT_EQ(100000, paths.total());
+
+    // Counts are upper bounds that are off by at most max_error().
+    const auto tree = paths.tree(8);
+    const auto& a = tree.next_nodes.at(A);
+    ASSERT_EQ(100000, a.count);
+    const auto& c = a.next_nodes.at(B).next_nodes.at(C);
+    ASSERT_GE(c.count, hot);
+    ASSERT_LE(c.count, hot + paths.max_error());
+    ASSERT_LT(paths.max_error(), hot);
+
+    // Every path counts at least its children.
+    std::vector<const Node<int>*> nodes{&tree};
+    while (!nodes.empty()) {
+        const auto* node = nodes.back();
+        nodes.pop_back();
+        for (const auto& [frame, next_node] : node->next_nodes) {
+            ASSERT_LE(next_node.count, node->count);
+            nodes.push_back(&next_node);
+        }
+    }
+
+    paths.clear();
+    ASSERT_EQ(0, paths.size());
+    ASSERT_EQ(Node<int>{}, paths.tree());
+}
+
+TEST(merger_service, path_capacity)
+{
+    MergerService service{{}, 0, 3};
+
+    service.handle("PUSH c,b,a; c,b,a");
+    service.handle("PUSH d,b,a");
+    ASSERT_EQ(3, service.thread_count());
+
+    // The last path replaces the leaf c.
+    const auto json = service.handle("JSON");
+    ASSERT_NE(std::string::npos, json.find("\"b\""));
+    ASSERT_NE(std::string::npos, json.find("\"d\""));
+    ASSERT_EQ(std::string::npos, json.find("\"c\""));
+
+    // Counts are labeled as approximate.
+    ASSERT_NE(std::string::npos, json.find("\"max_error\":2,\"total\":3"));
+    ASSERT_NE(std::string::npos, service.handle("DOT").find("label=\"Counts are at most 2 too high, of 3 stacks\""));
+
+    // The heaviest paths, parents first on ties.
+    const auto heaviest = service.handle("JSON 2");
+    ASSERT_NE(std::string::npos, heaviest.find("\"b\""));
+    ASSERT_EQ(std::string::npos, heaviest.find("\"d\""));
+    ASSERT_NE(std::string::npos, service.handle("JSON 3").find("\"d\""));
+    ASSERT_TRUE(service.handle("DOT x").starts_with("ERR "));
+    ASSERT_TRUE(MergerService{}.handle("DOT 2").starts_with("ERR "));
+
+    service.handle("RESET");
+    ASSERT_EQ(0, service.thread_count());
+}
+
+TEST(tree_history, shared_versions)
+{
+    Node<int> tree;
+    add_stack(tree, {D, C, B, A});
+    add_stack(tree, {E, C, B, A});
+    const auto first_tree = tree;
+    add_stack(tree, {F, A});
+
+    TreeHistory<int> history;
+    ASSERT_EQ(0, history.push(first_tree));
+    ASSERT_EQ(1, history.push(tree));
+    ASSERT_EQ(first_tree, history.tree(0));
+    ASSERT_EQ(tree, history.tree(1));
+
+    // The second version has a new root, A and F; B, C, D and E are shared.
+    ASSERT_EQ(9, history.node_count());
+    ASSERT_EQ(2, history.push(tree));
+    ASSERT_EQ(9, history.node_count());
+
+    ASSERT_EQ((std::vector<PathChange<int>>{
+        {.path = {A}, .before = 2, .after = 3},
+        {.path = {A, F}, .before = 0, .after = 1},
+    }), history.diff(0, 1));
+    ASSERT_EQ((std::vector<PathChange<int>>{
+        {.path = {A}, .before = 3, .after = 2},
+        {.path = {A, F}, .before = 1, .after = 0},
+    }), history.diff(2, 0));
+    ASSERT_TRUE(history.diff(1, 2).empty());
+
+    // Collapsed trees are kept as they are.
+    auto collapsed = tree;
+    collapse(collapsed);
+    history.push(collapsed);
+    ASSERT_EQ(collapsed, history.tree(3));
+    ASSERT_EQ(get_dot_graph(collapsed), get_dot_graph(history.tree(3)));
+}
+
+TEST(tree_history, max_versions)
+{
+    TreeHistory<int> history{2};
+    for (int i = 0; i < 5; ++i) {
+        Node<int> tree;
+        add_stack(tree, {100 + i, B, A});
+        add_stack(tree, {C, B, A});
+        ASSERT_EQ(i, history.push(tree));
+    }
+
+    ASSERT_EQ(3, history.first_version());
+    ASSERT_EQ(5, history.end_version());
+    ASSERT_THROW(history.tree(2), std::out_of_range);
+    ASSERT_THROW(history.diff(3, 5), std::out_of_range);
+
+    // Two roots, A and B of each version, their shared C and a leaf of each version.
+    ASSERT_EQ(9, history.node_count());
+    ASSERT_EQ(1, history.tree(4).next_nodes.at(A).next_nodes.at(B).next_nodes.at(104).count);
+}
+
+TEST(stuck_threads, snapshots)
+{
+    using namespace std::chrono_literals;
+    using Stacks = std::vector<std::vector<Frame>>;
+    const auto start = StuckThreads<Frame>::Clock::time_point{};
+    const Frame wait{"wait", "", 0, 0};
+    const Frame lock{"lock", "", 0, 0};
+    const Frame work{"work", "", 0, 0};
+    const Frame main{"main", "", 0, 0};
+
+    StuckThreads<Frame> threads{3};
+    const std::vector<int> tids{1, 2, 3};
+    threads.add_snapshot(tids, Stacks{{lock, main}, {lock, main}, {work, main}}, start);
+    threads.add_snapshot(tids, Stacks{{lock, main}, {lock, main}, {wait, main}}, start + 5s);
+    ASSERT_TRUE(threads.stuck().empty());
+
+    // Thread 2 is gone and comes back, so it starts over.
+    threads.add_snapshot(std::vector<int>{1, 3}, Stacks{{lock, main}, {wait, main}}, start + 10s);
+    const Stacks last{{lock, main}, {lock, main}, {wait, main}};
+    threads.add_snapshot(tids, last, start + 15s);
+
+    ASSERT_EQ(threads.size(), 3u);
+    ASSERT_EQ(threads.stuck().size(), 2u);
+    ASSERT_EQ(threads.stuck()[0].tid, 1);
+    ASSERT_EQ(threads.stuck()[0].snapshots, 4u);
+    ASSERT_EQ(threads.stuck()[0].duration, 15s);
+    ASSERT_EQ(threads.stuck()[1].tid, 3);
+    ASSERT_EQ(threads.stuck()[1].snapshots, 3u);
+    ASSERT_EQ(threads.stuck()[1].stack, 2u);
+
+    const auto tree = merge_stuck_threads(threads, last, std::identity{});
+    ASSERT_EQ(tree.count, 2u);
+    std::map<std::string, std::size_t> roots;
+    for (const auto& [frame, node] : tree.next_nodes) {
+        roots[frame.function] = node.count;
+    }
+    ASSERT_EQ(roots, (std::map<std::string, std::size_t>{{"stuck for 15 s, 4 snapshots", 1}, {"stuck for 10 s, 3 snapshots", 1}}));
+
+    // The same roots in a callee-rooted tree.
+    std::map<std::string, std::size_t> callee_roots;
+    for (const auto& [frame, node] : merge_stuck_threads(threads, last, std::identity{}, Orientation::CalleeRooted).next_nodes) {
+        callee_roots[frame.function] = node.count;
+    }
+    ASSERT_EQ(roots, callee_roots);
+
+    ASSERT_THROW(StuckThreads<Frame>{1}, std::invalid_argument);
+}
+
+TEST(merger_service, incremental_updates)
+{
+    MergerService service;
+
+    ASSERT_EQ("OK 0\n", service.handle("PUSH func2:file2.cpp:20:10,func1:file1.cpp:10:5"));
+    ASSERT_EQ("OK 0\n", service.handle("PUSH func3:file3.cpp:30:15,func1:file1.cpp:10:5\r"));
+    ASSERT_EQ(2, service.thread_count());
+
+    const auto expectedDot = get_dot_graph(merge(std::vector<std::vector<Frame>>{
+        {Frame{"func2", "file2.cpp", 20, 10}, Frame{"func1", "file1.cpp", 10, 5}},
+        {Frame{"func3", "file3.cpp", 30, 15}, Frame{"func1", "file1.cpp", 10, 5}}
+    }));
+    ASSERT_EQ("OK " + std::to_string(expectedDot.size()) + "\n" + expectedDot, service.handle("DOT"));
+
+    // The collapsed tree of queries is cached until the tree changes.
+    ASSERT_EQ(service.handle("DOT"), service.handle("DOT"));
+    ASSERT_EQ("OK 0\n", service.handle("PUSH func2:file2.cpp:20:10,func1:file1.cpp:10:5"));
+    ASSERT_NE("OK " + std::to_string(expectedDot.size()) + "\n" + expectedDot, service.handle("DOT"));
+
+    ASSERT_EQ("OK 0\n", service.handle("RESET"));
+    ASSERT_EQ(0, service.thread_count());
+    const auto emptyDot = get_dot_graph(Node<Frame>{});
+    ASSERT_EQ("OK " + std::to_string(emptyDot.size()) + "\n" + emptyDot, service.handle("DOT"));
+
+    ASSERT_TRUE(service.handle("SVG").starts_with("ERR "));
+    ASSERT_TRUE(service.handle("PUSH a:b:c").starts_with("ERR "));
+    ASSERT_TRUE(service.handle("UNKNOWN").starts_with("ERR "));
+}
+
+TEST(merger_service, recursion_stays_mergeable)
+{
+    MergerService service;
+
+    // Queries must not collapse the tree that receives new stacks.
+    service.handle("PUSH b,a,a,a");
+    service.handle("JSON");
+    service.handle("PUSH c,b,a,a");
+
+    const auto expected = get_json_tree(merge(std::vector<std::vector<Frame>>{
+        {Frame{"b"}, Frame{"a"}, Frame{"a"}, Frame{"a"}},
+        {Frame{"c"}, Frame{"b"}, Frame{"a"}, Frame{"a"}},
+    }));
+    ASSERT_EQ("OK " + std::to_string(expected.size()) + "\n" + expected, service.handle("JSON"));
+}
+
+TEST(merger_service, snapshot_directory)
+{
+    ASSERT_TRUE(MergerService{}.handle("SNAPSHOT tree.json").starts_with("ERR "));
+
+    const auto dir = std::filesystem::temp_directory_path() / ("merger-service-" + std::to_string(::getpid()));
+    std::filesystem::create_directories(dir);
+    MergerService service{{}, 0, 0, dir};
+    service.handle("PUSH b,a");
+
+    // Only file names in the directory.
+    for (const auto* name : {"SNAPSHOT", "SNAPSHOT ../tree.json", "SNAPSHOT /tmp/tree.json", "SNAPSHOT sub/tree.json", "SNAPSHOT .."}) {
+        EXPECT_TRUE(service.handle(name).starts_with("ERR ")) << name;
+    }
+    EXPECT_FALSE(std::filesystem::exists(dir.parent_path() / "tree.json.tmp"));
+
+    ASSERT_EQ("OK 0\n", service.handle("SNAPSHOT tree.json"));
+    std::ifstream file{dir / "tree.json"};
+    const std::string snapshot{std::istreambuf_iterator<char>{file}, {}};
+    std::filesystem::remove_all(dir);
+    ASSERT_EQ(get_json_tree(merge(std::vector<std::vector<Frame>>{{Frame{"b"}, Frame{"a"}}})), snapshot);
+}
+
 TEST(node_class, Moving)
 {
     Node<int> nodeD {.count=1, .level=4, .next_nodes={}};
@@ -369,6 +1812,163 @@ TEST(node_class, Moving)
     ASSERT_EQ(4, nodeA.next_nodes[B].next_nodes[D].level);
 }
 
+TEST(arena, merge_into_resource)
+{
+    auto input = std::vector<std::vector<int>>{
+        {F, E, D, C, B, A},
+        {F, E, G, C, B, A},
+        {C, C, C, B, A},
+    };
+
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::monotonic_buffer_resource scratch;
+
+    const auto expected = merge(input);
+    const auto actual = merge(input, 0, &arena, &scratch);
+
+    ASSERT_EQ(actual, expected);
+
+    const auto& nodeC = actual.next_nodes.at(A).next_nodes.at(B).next_nodes.at(C);
+    ASSERT_EQ(&arena, nodeC.next_nodes.get_allocator().resource());
+    ASSERT_EQ(get_dot_graph(actual, &scratch), get_dot_graph(expected));
+}
+
+TEST(arena, move_between_resources)
+{
+    auto input = std::vector<std::vector<int>>{
+        {D, C, B, A},
+        {E, C, B, A},
+    };
+    const auto expected = merge(input);
+
+    std::pmr::monotonic_buffer_resource target;
+    Node<int> moved{.next_nodes = NodeMap<int>(&target)};
+    {
+        std::array<std::byte, 64 * 1024> buffer;
+        std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+        auto tree = merge(input, 0, &arena);
+        moved.next_nodes = std::move(tree.next_nodes);
+        moved.count = tree.count;
+        // Nothing of the moved tree may stay in the released arena.
+        arena.release();
+        buffer.fill(std::byte{0xff});
+    }
+
+    ASSERT_EQ(expected, moved);
+
+    // All descendants of a copied child use the resource of its new parent.
+    const auto resources = [](const Node<int>& root) {
+        std::set<std::pmr::memory_resource*> result;
+        std::vector<const Node<int>*> nodes{&root};
+        while (!nodes.empty()) {
+            const auto* node = nodes.back();
+            nodes.pop_back();
+            result.insert(node->next_nodes.get_allocator().resource());
+            for (const auto& [value, next_node] : node->next_nodes) {
+                nodes.push_back(&next_node);
+            }
+        }
+        return result;
+    };
+    ASSERT_EQ(std::set<std::pmr::memory_resource*>{&target}, resources(moved));
+
+    Node<int> copied{.next_nodes = NodeMap<int>(&target)};
+    copied.next_nodes = expected.next_nodes;
+    ASSERT_EQ(std::set<std::pmr::memory_resource*>{&target}, resources(copied));
+
+    const Node<int> default_copy{moved};
+    ASSERT_EQ(std::set<std::pmr::memory_resource*>{std::pmr::get_default_resource()}, resources(default_copy));
+}
+
+TEST(arena, wide_node_index)
+{
+    std::mt19937 random{7};
+    NodeMap<int> children;
+    std::map<int, int> expected;
+
+    for (int step = 0; step < 20000; ++step) {
+        const auto key = static_cast<int>(random() % 300);
+        if (random() % 3 == 0) {
+            ASSERT_EQ(expected.erase(key), children.erase(key));
+        } else {
+            children[key].count = step;
+            expected[key] = step;
+        }
+        ASSERT_EQ(expected.size(), children.size());
+    }
+    for (int key = 0; key < 300; ++key) {
+        const auto it = children.find(key);
+        ASSERT_EQ(expected.contains(key), it != children.end());
+        if (it != children.end()) {
+            ASSERT_EQ(expected[key], it->second.count);
+        }
+    }
+}
+
+TEST(arena, failed_insert)
+{
+    // Fails the allocations after the first `budget` ones and counts the allocated bytes.
+    class LimitedResource : public std::pmr::memory_resource
+    {
+    public:
+        int budget = 0;
+        std::size_t allocated = 0;
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            if (budget-- <= 0) {
+                throw std::bad_alloc{};
+            }
+            allocated += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+        {
+            allocated -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    LimitedResource resource;
+    resource.budget = 1000;
+    NodeMap<int> children{&resource};
+    for (int key = 0; key < 4; ++key) {
+        children[key];
+    }
+
+    // The fifth child grows the array, and then the eighth one adds the index.
+    for (const int key : {4, 7}) {
+        if (key == 7) {
+            children[5];
+            children[6];
+        }
+        const auto allocated = resource.allocated;
+        const auto size = children.size();
+        resource.budget = 1;
+        ASSERT_THROW(children[key], std::bad_alloc);
+        ASSERT_EQ(allocated, resource.allocated);
+        ASSERT_EQ(size, children.size());
+        ASSERT_EQ(children.end(), children.find(key));
+        resource.budget = 1000;
+        children[key];
+        ASSERT_EQ(size + 1, children.size());
+    }
+}
+
+TEST(arena, arena_tree)
+{
+    auto input = std::vector<std::vector<std::string>>{
+       {"e", "d", "c", "b", "a"},
+       {"e", "d", "c", "c", "c", "c", "c", "b", "a"},
+    };
+
+    const ArenaTree<std::string> tree{input};
+
+    ASSERT_EQ(tree.root(), merge(input));
+}
+
 TEST(collapsing, one_thread_four_same_frames)
 {
     Node<int> nodeA4 {.count=1, .level=4, .next_nodes={}};
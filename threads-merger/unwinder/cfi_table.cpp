@@ -0,0 +1,339 @@
+#include "cfi_table.hpp"
+#include "symbolizer/dwarf_reader.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+namespace {
+
+using Dwarf::Reader;
+
+enum : std::uint8_t {
+    DW_EH_PE_absptr = 0x00,
+    DW_EH_PE_uleb128 = 0x01,
+    DW_EH_PE_udata2 = 0x02,
+    DW_EH_PE_udata4 = 0x03,
+    DW_EH_PE_udata8 = 0x04,
+    DW_EH_PE_sleb128 = 0x09,
+    DW_EH_PE_sdata2 = 0x0a,
+    DW_EH_PE_sdata4 = 0x0b,
+    DW_EH_PE_sdata8 = 0x0c,
+    DW_EH_PE_pcrel = 0x10,
+    DW_EH_PE_omit = 0xff,
+
+    DW_CFA_advance_loc = 0x40,
+    DW_CFA_offset = 0x80,
+    DW_CFA_restore = 0xc0,
+    DW_CFA_nop = 0x00,
+    DW_CFA_set_loc = 0x01,
+    DW_CFA_advance_loc1 = 0x02,
+    DW_CFA_advance_loc2 = 0x03,
+    DW_CFA_advance_loc4 = 0x04,
+    DW_CFA_offset_extended = 0x05,
+    DW_CFA_restore_extended = 0x06,
+    DW_CFA_undefined = 0x07,
+    DW_CFA_same_value = 0x08,
+    DW_CFA_register = 0x09,
+    DW_CFA_remember_state = 0x0a,
+    DW_CFA_restore_state = 0x0b,
+    DW_CFA_def_cfa = 0x0c,
+    DW_CFA_def_cfa_register = 0x0d,
+    DW_CFA_def_cfa_offset = 0x0e,
+    DW_CFA_def_cfa_expression = 0x0f,
+    DW_CFA_expression = 0x10,
+    DW_CFA_offset_extended_sf = 0x11,
+    DW_CFA_def_cfa_sf = 0x12,
+    DW_CFA_def_cfa_offset_sf = 0x13,
+    DW_CFA_val_offset = 0x14,
+    DW_CFA_val_offset_sf = 0x15,
+    DW_CFA_val_expression = 0x16,
+    DW_CFA_GNU_args_size = 0x2e,
+    DW_CFA_GNU_negative_offset_extended = 0x2f,
+};
+
+// Reads a pointer in the .eh_frame encoding. `address` is the address of the reader position.
+std::uint64_t read_pointer(Reader& reader, std::uint8_t encoding, std::uint64_t address) {
+    std::uint64_t value = 0;
+    switch (encoding & 0x0F) {
+        case DW_EH_PE_absptr: value = reader.fixed<std::uint64_t>(); break;
+        case DW_EH_PE_uleb128: value = reader.uleb(); break;
+        case DW_EH_PE_udata2: value = reader.fixed<std::uint16_t>(); break;
+        case DW_EH_PE_udata4: value = reader.fixed<std::uint32_t>(); break;
+        case DW_EH_PE_udata8: value = reader.fixed<std::uint64_t>(); break;
+        case DW_EH_PE_sleb128: value = static_cast<std::uint64_t>(reader.sleb()); break;
+        case DW_EH_PE_sdata2: value = static_cast<std::uint64_t>(std::int64_t{reader.fixed<std::int16_t>()}); break;
+        case DW_EH_PE_sdata4: value = static_cast<std::uint64_t>(std::int64_t{reader.fixed<std::int32_t>()}); break;
+        case DW_EH_PE_sdata8: value = reader.fixed<std::uint64_t>(); break;
+        default: throw std::runtime_error("Unsupported pointer encoding");
+    }
+    if ((encoding & 0x70) == DW_EH_PE_pcrel) {
+        value += address;
+    }
+    return value;
+}
+
+} // namespace
+
+namespace Unwind {
+
+CfiTable::CfiTable(const Elf::File& elf) {
+    const auto* section = elf.section(".eh_frame");
+    const auto data = elf.section_data(".eh_frame");
+    if (!section || data.empty()) {
+        return;
+    }
+
+    // Indices of the parsed CIEs by their offsets in the section.
+    std::vector<std::pair<std::size_t, std::size_t>> cie_offsets;
+
+    Reader reader{data};
+    while (!reader.at_end()) {
+        const auto entry_offset = reader.position();
+        std::uint64_t length = 0;
+        try {
+            length = reader.fixed<std::uint32_t>();
+            if (length == 0xFFFFFFFF) {
+                length = reader.fixed<std::uint64_t>();
+            }
+        } catch (const std::runtime_error&) {
+            break;
+        }
+        if (length == 0) {
+            // Terminator.
+            break;
+        }
+
+        const auto body_offset = reader.position();
+        if (length > data.size() - body_offset) {
+            break;
+        }
+        const auto entry_end = body_offset + length;
+
+        try {
+            const auto id = reader.fixed<std::uint32_t>();
+            if (id == 0) {
+                Cie cie;
+                const auto version = reader.fixed<std::uint8_t>();
+                const std::string_view augmentation = reader.string();
+                if (augmentation.find("eh") != std::string_view::npos) {
+                    reader.skip(8);
+                }
+                cie.code_alignment = reader.uleb();
+                cie.data_alignment = reader.sleb();
+                cie.return_address_register = version == 1
+                    ? reader.fixed<std::uint8_t>()
+                    : static_cast<std::uint32_t>(reader.uleb());
+
+                if (augmentation.starts_with('z')) {
+                    const auto augmentation_length = reader.uleb();
+                    const auto augmentation_end = reader.position() + augmentation_length;
+                    for (const char c : augmentation.substr(1)) {
+                        if (c == 'R') {
+                            cie.pointer_encoding = reader.fixed<std::uint8_t>();
+                        } else if (c == 'L') {
+                            reader.fixed<std::uint8_t>();
+                        } else if (c == 'P') {
+                            const auto encoding = reader.fixed<std::uint8_t>();
+                            read_pointer(reader, encoding & 0x7F, section->addr + reader.position());
+                        }
+                    }
+                    reader.seek(augmentation_end);
+                }
+
+                cie.instructions = data.subspan(reader.position(), entry_end - reader.position());
+                cie_offsets.emplace_back(entry_offset, cies_.size());
+                cies_.push_back(cie);
+            } else {
+                // The CIE pointer is relative to its own position.
+                const auto cie_offset = body_offset - id;
+                const auto cie = std::ranges::find(cie_offsets, cie_offset, &std::pair<std::size_t, std::size_t>::first);
+                if (cie != cie_offsets.end()) {
+                    const auto& cie_data = cies_[cie->second];
+                    Fde fde;
+                    fde.cie = cie->second;
+                    fde.begin = read_pointer(reader, cie_data.pointer_encoding, section->addr + reader.position());
+                    fde.end = fde.begin + read_pointer(reader, cie_data.pointer_encoding & 0x0F, 0);
+                    reader.skip(reader.uleb()); // Augmentation data, the CIEs of .eh_frame always have 'z'.
+                    fde.instructions = data.subspan(reader.position(), entry_end - reader.position());
+                    fdes_.push_back(fde);
+                }
+            }
+        } catch (const std::runtime_error&) {
+            // Skip the entry.
+        }
+
+        reader.seek(entry_end);
+    }
+
+    std::ranges::sort(fdes_, {}, &Fde::begin);
+}
+
+std::optional<CfiRow> CfiTable::find(std::uint64_t address) const {
+    auto fde = std::ranges::upper_bound(fdes_, address, {}, &Fde::begin);
+    if (fde == fdes_.begin()) {
+        return std::nullopt;
+    }
+    --fde;
+    if (address >= fde->end) {
+        return std::nullopt;
+    }
+
+    const auto& cie = cies_[fde->cie];
+    if (cie.return_address_register >= register_count) {
+        return std::nullopt;
+    }
+
+    CfiRow row;
+    row.return_address_register = cie.return_address_register;
+    CfiRow initial_row;
+    std::vector<CfiRow> remembered;
+    std::uint64_t location = fde->begin;
+
+    auto rule = [&row](std::uint64_t reg) -> RegisterRule& {
+        if (reg >= register_count) {
+            throw std::runtime_error("Unsupported register");
+        }
+        return row.rules[reg];
+    };
+    auto restore = [&](std::uint64_t reg) {
+        auto& target = rule(reg);
+        target = initial_row.rules[reg];
+    };
+
+    // Returns false if the rules are not representable, or true when the address is reached.
+    auto execute = [&](std::span<const std::byte> instructions, bool stop_at_address) {
+        Reader reader{instructions};
+        while (!reader.at_end()) {
+            const auto opcode = reader.fixed<std::uint8_t>();
+            const auto operand = static_cast<std::uint8_t>(opcode & 0x3F);
+
+            switch (opcode & 0xC0) {
+                case DW_CFA_advance_loc:
+                    location += operand * cie.code_alignment;
+                    if (stop_at_address && location > address) return true;
+                    continue;
+                case DW_CFA_offset:
+                    rule(operand) = {RegisterRule::Kind::Offset, static_cast<std::int64_t>(reader.uleb()) * cie.data_alignment};
+                    continue;
+                case DW_CFA_restore:
+                    restore(operand);
+                    continue;
+                default:
+                    break;
+            }
+
+            switch (opcode) {
+                case DW_CFA_nop:
+                    break;
+                case DW_CFA_set_loc:
+                    location = read_pointer(reader, cie.pointer_encoding & 0x0F, 0);
+                    if (stop_at_address && location > address) return true;
+                    break;
+                case DW_CFA_advance_loc1:
+                    location += reader.fixed<std::uint8_t>() * cie.code_alignment;
+                    if (stop_at_address && location > address) return true;
+                    break;
+                case DW_CFA_advance_loc2:
+                    location += reader.fixed<std::uint16_t>() * cie.code_alignment;
+                    if (stop_at_address && location > address) return true;
+                    break;
+                case DW_CFA_advance_loc4:
+                    location += reader.fixed<std::uint32_t>() * cie.code_alignment;
+                    if (stop_at_address && location > address) return true;
+                    break;
+                case DW_CFA_offset_extended: {
+                    const auto reg = reader.uleb();
+                    rule(reg) = {RegisterRule::Kind::Offset, static_cast<std::int64_t>(reader.uleb()) * cie.data_alignment};
+                    break;
+                }
+                case DW_CFA_restore_extended:
+                    restore(reader.uleb());
+                    break;
+                case DW_CFA_undefined:
+                    rule(reader.uleb()) = {RegisterRule::Kind::Undefined};
+                    break;
+                case DW_CFA_same_value:
+                    rule(reader.uleb()) = {RegisterRule::Kind::SameValue};
+                    break;
+                case DW_CFA_register: {
+                    const auto reg = reader.uleb();
+                    rule(reg) = {RegisterRule::Kind::Register, 0, static_cast<std::uint32_t>(reader.uleb())};
+                    break;
+                }
+                case DW_CFA_remember_state:
+                    remembered.push_back(row);
+                    break;
+                case DW_CFA_restore_state:
+                    if (!remembered.empty()) {
+                        // Like libgcc, restores the CFA rule together with the register rules.
+                        row = remembered.back();
+                        remembered.pop_back();
+                    }
+                    break;
+                case DW_CFA_def_cfa:
+                    row.cfa_register = static_cast<std::uint32_t>(reader.uleb());
+                    row.cfa_offset = static_cast<std::int64_t>(reader.uleb());
+                    break;
+                case DW_CFA_def_cfa_register:
+                    row.cfa_register = static_cast<std::uint32_t>(reader.uleb());
+                    break;
+                case DW_CFA_def_cfa_offset:
+                    row.cfa_offset = static_cast<std::int64_t>(reader.uleb());
+                    break;
+                case DW_CFA_offset_extended_sf: {
+                    const auto reg = reader.uleb();
+                    rule(reg) = {RegisterRule::Kind::Offset, reader.sleb() * cie.data_alignment};
+                    break;
+                }
+                case DW_CFA_def_cfa_sf:
+                    row.cfa_register = static_cast<std::uint32_t>(reader.uleb());
+                    row.cfa_offset = reader.sleb() * cie.data_alignment;
+                    break;
+                case DW_CFA_def_cfa_offset_sf:
+                    row.cfa_offset = reader.sleb() * cie.data_alignment;
+                    break;
+                case DW_CFA_val_offset: {
+                    const auto reg = reader.uleb();
+                    rule(reg) = {RegisterRule::Kind::ValOffset, static_cast<std::int64_t>(reader.uleb()) * cie.data_alignment};
+                    break;
+                }
+                case DW_CFA_val_offset_sf: {
+                    const auto reg = reader.uleb();
+                    rule(reg) = {RegisterRule::Kind::ValOffset, reader.sleb() * cie.data_alignment};
+                    break;
+                }
+                case DW_CFA_GNU_args_size:
+                    reader.uleb();
+                    break;
+                case DW_CFA_GNU_negative_offset_extended: {
+                    const auto reg = reader.uleb();
+                    rule(reg) = {RegisterRule::Kind::Offset, -static_cast<std::int64_t>(reader.uleb()) * cie.data_alignment};
+                    break;
+                }
+                case DW_CFA_def_cfa_expression:
+                case DW_CFA_expression:
+                case DW_CFA_val_expression:
+                default:
+                    // DWARF expressions are not evaluated.
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    try {
+        if (!execute(cie.instructions, false)) {
+            return std::nullopt;
+        }
+        initial_row = row;
+        if (!execute(fde->instructions, true)) {
+            return std::nullopt;
+        }
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+
+    return row;
+}
+
+} // namespace Unwind
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "symbolizer/elf_file.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/* Call frame information from the .eh_frame section of an ELF file.
+ *
+ * DWARF 5 specification, section 6.4: https://dwarfstd.org/dwarf5std.html
+ * .eh_frame format: https://refspecs.linuxfoundation.org/LSB_5.0.0/LSB-Core-generic/LSB-Core-generic/ehframechpt.html
+ *
+ */
+
+namespace Unwind {
+
+// Enough for the DWARF register numbers of x86-64 (0–16) and AArch64 (0–31, 32 is pc).
+constexpr std::size_t register_count = 33;
+
+struct RegisterRule {
+    enum class Kind {
+        SameValue,
+        Undefined,
+        // Saved at CFA + offset.
+        Offset,
+        // The value is CFA + offset.
+        ValOffset,
+        // Saved in another register.
+        Register,
+    };
+
+    Kind kind = Kind::SameValue;
+    std::int64_t offset = 0;
+    std::uint32_t reg = 0;
+};
+
+// Rules to restore the registers of the caller at some instruction.
+struct CfiRow {
+    std::uint32_t cfa_register = 0;
+    std::int64_t cfa_offset = 0;
+    std::uint32_t return_address_register = 0;
+    std::array<RegisterRule, register_count> rules{};
+};
+
+class CfiTable {
+public:
+    // Reads all FDEs of .eh_frame. Malformed entries are skipped.
+    explicit CfiTable(const Elf::File& elf);
+
+    // Rules at the address in the address space of the ELF file. Returns nothing if there is
+    // no FDE for the address or the rules use DWARF expressions.
+    std::optional<CfiRow> find(std::uint64_t address) const;
+
+    bool empty() const { return fdes_.empty(); }
+
+private:
+    struct Cie {
+        std::uint64_t code_alignment = 1;
+        std::int64_t data_alignment = 1;
+        std::uint32_t return_address_register = 0;
+        std::uint8_t pointer_encoding = 0;
+        std::span<const std::byte> instructions;
+    };
+
+    struct Fde {
+        std::uint64_t begin = 0;
+        std::uint64_t end = 0;
+        std::size_t cie = 0;
+        std::span<const std::byte> instructions;
+    };
+
+    std::vector<Cie> cies_;
+    std::vector<Fde> fdes_;
+};
+
+} // namespace Unwind
@@ -0,0 +1,156 @@
+#include "unwinder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Unwind {
+
+Unwinder::Unwinder(Architecture architecture, const Memory& memory, std::vector<ModuleMapping> mappings)
+    : architecture_(architecture)
+    , memory_(memory)
+    , mappings_(std::move(mappings))
+{
+    std::ranges::sort(mappings_, {}, &ModuleMapping::start);
+}
+
+Unwinder::~Unwinder() = default;
+
+std::uint32_t Unwinder::stack_pointer() const {
+    return architecture_ == Architecture::X86_64 ? 7 : 31;
+}
+
+std::uint32_t Unwinder::frame_pointer() const {
+    return architecture_ == Architecture::X86_64 ? 6 : 29;
+}
+
+Unwinder::Module* Unwinder::module(const std::filesystem::path& path) {
+    auto [it, inserted] = modules_.try_emplace(path.string());
+    if (!inserted) {
+        return it->second.get();
+    }
+
+    try {
+        auto module = std::make_unique<Module>();
+        module->elf = std::make_unique<Elf::File>(path);
+        module->cfi = std::make_unique<CfiTable>(*module->elf);
+        it->second = std::move(module);
+    } catch (const std::runtime_error&) {
+        // Not readable or not an ELF file. It is remembered as a null module.
+    }
+    return it->second.get();
+}
+
+std::optional<CfiRow> Unwinder::find_cfi(std::uint64_t address) {
+    auto mapping = std::ranges::upper_bound(mappings_, address, {}, &ModuleMapping::start);
+    if (mapping == mappings_.begin() || address >= std::prev(mapping)->end) {
+        return std::nullopt;
+    }
+    --mapping;
+
+    const auto* module = this->module(mapping->path);
+    if (!module || module->cfi->empty()) {
+        return std::nullopt;
+    }
+    const auto elf_address = module->elf->offset_to_address(address - mapping->start + mapping->offset);
+    if (!elf_address) {
+        return std::nullopt;
+    }
+    return module->cfi->find(*elf_address);
+}
+
+bool Unwinder::step_cfi(Registers& registers, bool innermost) {
+    // The return address of a caller may be the first address after a noreturn call,
+    // which belongs to the next function. The address of the call is looked up instead.
+    const auto row = find_cfi(innermost ? registers.pc : registers.pc - 1);
+    if (!row || row->cfa_register >= register_count || !registers.valid[row->cfa_register]) {
+        return false;
+    }
+
+    const auto cfa = registers.values[row->cfa_register] + static_cast<std::uint64_t>(row->cfa_offset);
+
+    Registers caller;
+    for (std::uint32_t reg = 0; reg < register_count; ++reg) {
+        const auto& rule = row->rules[reg];
+        switch (rule.kind) {
+            case RegisterRule::Kind::SameValue:
+                if (registers.valid[reg]) {
+                    caller.set(reg, registers.values[reg]);
+                }
+                break;
+            case RegisterRule::Kind::Undefined:
+                break;
+            case RegisterRule::Kind::Offset:
+                if (const auto value = memory_.read_u64(cfa + static_cast<std::uint64_t>(rule.offset))) {
+                    caller.set(reg, *value);
+                }
+                break;
+            case RegisterRule::Kind::ValOffset:
+                caller.set(reg, cfa + static_cast<std::uint64_t>(rule.offset));
+                break;
+            case RegisterRule::Kind::Register:
+                if (rule.reg < register_count && registers.valid[rule.reg]) {
+                    caller.set(reg, registers.values[rule.reg]);
+                }
+                break;
+        }
+    }
+
+    // The return address column is not a real register on x86-64, its rule is always explicit.
+    // On AArch64 it is x30, which is live in the innermost frame.
+    if (!caller.valid[row->return_address_register]) {
+        return false;
+    }
+    caller.pc = caller.values[row->return_address_register];
+    caller.set(stack_pointer(), cfa);
+
+    registers = caller;
+    return true;
+}
+
+bool Unwinder::step_frame_pointer(Registers& registers) {
+    const auto fp_reg = frame_pointer();
+    if (!registers.valid[fp_reg]) {
+        return false;
+    }
+
+    // Both architectures save the previous frame pointer and the return address as a pair
+    // at the frame pointer.
+    const auto fp = registers.values[fp_reg];
+    const auto previous_fp = memory_.read_u64(fp);
+    const auto return_address = memory_.read_u64(fp + 8);
+    if (fp == 0 || !previous_fp || !return_address) {
+        return false;
+    }
+
+    Registers caller;
+    caller.pc = *return_address;
+    caller.set(fp_reg, *previous_fp);
+    caller.set(stack_pointer(), fp + 16);
+    registers = caller;
+    return true;
+}
+
+std::vector<std::uint64_t> Unwinder::unwind(Registers registers, std::size_t max_frames) {
+    std::vector<std::uint64_t> frames;
+    const auto sp_reg = stack_pointer();
+
+    bool innermost = true;
+    while (registers.pc != 0 && frames.size() < max_frames) {
+        frames.push_back(innermost ? registers.pc : registers.pc - 1);
+
+        const auto previous = registers;
+        if (!step_cfi(registers, innermost) && !step_frame_pointer(registers)) {
+            break;
+        }
+        innermost = false;
+
+        // The stack grows down, so a frame of a caller is always above the frame of a callee.
+        if (previous.valid[sp_reg] && registers.valid[sp_reg]
+            && registers.values[sp_reg] <= previous.values[sp_reg]) {
+            break;
+        }
+    }
+    return frames;
+}
+
+} // namespace Unwind
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "symbolizer.hpp"
+#include "unwinder/cfi_table.hpp"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Stack unwinding of a stopped thread.
+ *
+ * Frames are unwound with the call frame information from .eh_frame of the mapped modules.
+ * When there is no usable CFI for a frame, the unwinder falls back to the frame pointer chain.
+ *
+ */
+
+namespace Unwind {
+
+enum class Architecture {
+    X86_64,
+    AArch64,
+};
+
+// Registers by their DWARF numbers.
+struct Registers {
+    std::array<std::uint64_t, register_count> values{};
+    std::bitset<register_count> valid;
+    std::uint64_t pc = 0;
+
+    void set(std::uint32_t reg, std::uint64_t value) {
+        values[reg] = value;
+        valid.set(reg);
+    }
+};
+
+// Memory of the unwound process.
+class Memory {
+public:
+    virtual ~Memory() = default;
+
+    // Returns nothing if the address is not readable.
+    virtual std::optional<std::uint64_t> read_u64(std::uint64_t address) const = 0;
+};
+
+class Unwinder {
+public:
+    /**
+     * @param memory Must outlive the unwinder.
+     * @param mappings Modules whose .eh_frame is used for unwinding.
+     */
+    Unwinder(Architecture architecture, const Memory& memory, std::vector<ModuleMapping> mappings);
+    ~Unwinder();
+
+    Unwinder(const Unwinder&) = delete;
+    Unwinder& operator=(const Unwinder&) = delete;
+
+    /**
+     * Unwinds the stack from the innermost frame.
+     * Return addresses of the callers are decremented by one, so they point into the call
+     * instruction and are symbolized to the line of the call.
+     * @return Program counters from the innermost frame to the outermost one.
+     */
+    std::vector<std::uint64_t> unwind(Registers registers, std::size_t max_frames = 256);
+
+private:
+    struct Module {
+        std::unique_ptr<Elf::File> elf;
+        std::unique_ptr<CfiTable> cfi;
+    };
+
+    Architecture architecture_;
+    const Memory& memory_;
+    std::vector<ModuleMapping> mappings_;
+    std::unordered_map<std::string, std::unique_ptr<Module>> modules_;
+
+    std::uint32_t stack_pointer() const;
+    std::uint32_t frame_pointer() const;
+
+    Module* module(const std::filesystem::path& path);
+    std::optional<CfiRow> find_cfi(std::uint64_t address);
+    bool step_cfi(Registers& registers, bool innermost);
+    bool step_frame_pointer(Registers& registers);
+};
+
+} // namespace Unwind
@@ -0,0 +1,239 @@
+import * as path from 'path';
+import { promises as fs } from 'fs';
+import { performance } from 'perf_hooks';
+import createMerger from '../../media/merger';
+import { createVectorFrame, MergerModule, VectorFrame } from '../mergerFrames';
+import { StackTraceArgs } from '../stackFetcher';
+import { ThreadStacks } from '../threadStacks';
+import { fillWebviewTemplate } from '../webviewHtml';
+
+/*
+ * Times the stages of the 'parallel-stacks.show' command on synthetic stacks, without VS Code
+ * and a debug adapter. Results are printed as JSON for comparison between builds.
+ *
+ *     npm run bench -- --threads 10,100,1000 --depths 16,64,200 --runs 5 --out bench.json
+ */
+
+type Options = {
+    threads: number[];
+    depths: number[];
+    runs: number;
+    tableDepth: number;
+    concurrency: number;
+    out: string | null;
+};
+
+type Stats = {
+    median: number;
+    min: number;
+    max: number;
+};
+
+const STAGES = ['fetch', 'input', 'merge_to_graphviz_dot', 'tree_view', 'layout', 'html'] as const;
+type Stage = typeof STAGES[number];
+
+function parseOptions(args: string[]): Options {
+    const options: Options = {
+        threads: [10, 100, 1000],
+        depths: [16, 64, 200],
+        runs: 3,
+        tableDepth: 4,
+        concurrency: 16,
+        out: null,
+    };
+    const numbers = (value: string) => value.split(',').map((item) => {
+        const number = Number(item);
+        if (!Number.isInteger(number) || number < 0) {
+            throw new Error(`Invalid number: '${item}'`);
+        }
+        return number;
+    });
+    for (let i = 0; i < args.length; i += 2) {
+        const value = args[i + 1];
+        if (value === undefined) {
+            throw new Error(`No value of ${args[i]}`);
+        }
+        switch (args[i]) {
+            case '--threads': options.threads = numbers(value); break;
+            case '--depths': options.depths = numbers(value); break;
+            case '--runs': options.runs = Math.max(1, numbers(value)[0]); break;
+            case '--table-depth': options.tableDepth = numbers(value)[0]; break;
+            case '--concurrency': options.concurrency = Math.max(1, numbers(value)[0]); break;
+            case '--out': options.out = value; break;
+            default: throw new Error(`Unknown option: ${args[i]}`);
+        }
+    }
+    return options;
+}
+
+// Small deterministic generator, so every run and every build sees the same stacks.
+function createRandom(seed: number): () => number {
+    let state = seed >>> 0;
+    return () => {
+        state = (state + 0x6D2B79F5) >>> 0;
+        let t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+/**
+ * Stacks of threads from the top, as frames of 'stackTrace' responses. Threads share their callers
+ * and branch off into one of a few callees now and then, like workers of a thread pool.
+ */
+function createSyntheticStacks(threadCount: number, depth: number, seed = 1): any[][] {
+    const random = createRandom(seed);
+    const stacks: any[][] = [];
+    for (let thread = 0; thread < threadCount; ++thread) {
+        const frames: any[] = [];
+        let node = 0;
+        for (let level = 0; level < depth; ++level) {
+            const branch = random() < 0.1 ? Math.floor(random() * 4) : 0;
+            node = (node * 31 + branch + 1) % 1_000_003;
+            frames.push({
+                id: thread * depth + level,
+                name: `function_${level}_${node}`,
+                source: { path: `/src/module_${node % 50}.cpp` },
+                line: 10 + level,
+                column: 5,
+            });
+        }
+        stacks.push(frames.reverse());
+    }
+    return stacks;
+}
+
+// Answers 'stackTrace' requests like a debug adapter that reports totalFrames.
+// https://microsoft.github.io/debug-adapter-protocol/specification#Requests_StackTrace
+function createStubAdapter(stacks: any[][]) {
+    return async (args: StackTraceArgs) => {
+        const frames = stacks[args.threadId - 1];
+        const end = args.levels === 0 ? frames.length : Math.min(frames.length, args.startFrame + args.levels);
+        return { stackFrames: frames.slice(args.startFrame, end), totalFrames: frames.length };
+    };
+}
+
+async function time<R>(times: Map<Stage, number[]>, stage: Stage, action: () => R | Promise<R>): Promise<R> {
+    const start = performance.now();
+    const result = await action();
+    times.get(stage)!.push(performance.now() - start);
+    return result;
+}
+
+function stats(values: number[]): Stats {
+    const sorted = [...values].sort((a, b) => a - b);
+    const middle = Math.floor(sorted.length / 2);
+    const median = sorted.length % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+    const round = (value: number) => Math.round(value * 1000) / 1000;
+    return { median: round(median), min: round(sorted[0]), max: round(sorted[sorted.length - 1]) };
+}
+
+async function runCase(
+    merger: MergerModule,
+    viz: any,
+    template: string,
+    options: Options,
+    threadCount: number,
+    depth: number
+) {
+    const synthetic = createSyntheticStacks(threadCount, depth);
+    const request = createStubAdapter(synthetic);
+    const threadIds = synthetic.map((_, index) => index + 1);
+    const times = new Map(STAGES.map((stage): [Stage, number[]] => [stage, []]));
+    const sizes = { dotBytes: 0, viewDotBytes: 0, svgBytes: 0, htmlBytes: 0 };
+
+    for (let run = 0; run < options.runs; ++run) {
+        const fetched: any[][] = [];
+        await time(times, 'fetch', () => new ThreadStacks().update(
+            request, threadIds, depth, options.concurrency, (_removed, added) => {
+                if (added) {
+                    fetched.push(added);
+                }
+            }));
+
+        const stacks: VectorFrame[] = [];
+        const vectorStacks = new merger.VectorVectorFrame();
+        try {
+            await time(times, 'input', () => {
+                for (const frames of fetched) {
+                    const stack = createVectorFrame(merger, frames);
+                    stacks.push(stack);
+                    vectorStacks.push_back(stack);
+                }
+            });
+
+            const dot = await time(times, 'merge_to_graphviz_dot', () => merger.merge_to_graphviz_dot(vectorStacks));
+
+            const noStacks = new merger.VectorVectorFrame();
+            const view = new merger.TreeView(noStacks);
+            noStacks.delete();
+            let viewDot = '';
+            try {
+                viewDot = await time(times, 'tree_view', () => {
+                    for (const stack of stacks) {
+                        view.add_stack(stack);
+                    }
+                    return view.render(options.tableDepth);
+                });
+            } finally {
+                view.delete();
+            }
+
+            const svg: string = await time(times, 'layout', () => viz.renderString(viewDot, { format: 'svg' }));
+            const html = await time(times, 'html', () => fillWebviewTemplate(template, svg, 'svg-pan-zoom.min.js'));
+
+            sizes.dotBytes = dot.length;
+            sizes.viewDotBytes = viewDot.length;
+            sizes.svgBytes = svg.length;
+            sizes.htmlBytes = html.length;
+        } finally {
+            stacks.forEach((stack) => stack.delete());
+            vectorStacks.delete();
+        }
+    }
+
+    const stages: Record<string, Stats> = {};
+    for (const [stage, values] of times) {
+        stages[stage] = stats(values);
+    }
+    return { threads: threadCount, depth, ...sizes, stages };
+}
+
+async function main() {
+    const options = parseOptions(process.argv.slice(2));
+    const merger = await createMerger();
+    const { instance } = await import('@viz-js/viz');
+    const viz = await instance();
+    const template = await fs.readFile(path.resolve(__dirname, '../../media/webview.html'), 'utf8');
+
+    const results = [];
+    for (const threadCount of options.threads) {
+        for (const depth of options.depths) {
+            console.error(`threads=${threadCount} depth=${depth}`);
+            results.push(await runCase(merger, viz, template, options, threadCount, depth));
+        }
+    }
+
+    const report = JSON.stringify({
+        date: new Date().toISOString(),
+        node: process.version,
+        runs: options.runs,
+        tableDepth: options.tableDepth,
+        concurrency: options.concurrency,
+        unit: 'ms',
+        results,
+    }, null, 2);
+    if (options.out) {
+        await fs.writeFile(options.out, report + '\n', 'utf8');
+    } else {
+        console.log(report);
+    }
+}
+
+if (require.main === module) {
+    main().catch((error) => {
+        console.error(error);
+        process.exitCode = 1;
+    });
+}
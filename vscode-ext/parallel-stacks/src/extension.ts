@@ -5,12 +5,24 @@ import * as path from 'path';
 import { promises as fs } from 'fs';
 import * as os from 'os';
 import createMerger from '../media/merger';
-import { calculateStackBounds } from './stackBounds';
+import { createVectorFrame, MergerModule, VectorFrame } from './mergerFrames';
+import { StackTraceArgs } from './stackFetcher';
+import { StackChangeCallback, ThreadStacks } from './threadStacks';
+import { applyReplacements, fillWebviewTemplate } from './webviewHtml';
 
 const LAST_SAVE_DIR_KEY = 'parallelStacks.lastSaveDir';
 const MAX_STACK_DEPTH_LIMIT = 1_000_000_000;
+const DEFAULT_INITIAL_TABLE_DEPTH = 4;
+const DEFAULT_MAX_CONCURRENT_REQUESTS = 16;
+const DEFAULT_RENDER_TIME_LIMIT = 1000;
 
-type MergerModule = Awaited<ReturnType<typeof createMerger>>;
+type TreeView = InstanceType<MergerModule['TreeView']>;
+
+// A panel that is updated on each stop of its debug session.
+type LivePanel = {
+    session: vscode.DebugSession;
+    refresh: () => Promise<void>;
+};
 
 // This method is called when your extension is activated
 // Your extension is activated the very first time the command is executed
@@ -23,6 +35,7 @@ export function activate(context: vscode.ExtensionContext) {
     console.log('Congratulations, your extension "parallel-stacks" is now active!');
 
     let Merger: MergerModule | null = null;
+    const livePanels = new Set<LivePanel>();
 
     // Command to display thread stacks in a new tab (Webview)
     const disposable = vscode.commands.registerCommand('parallel-stacks.show', async () => {
@@ -41,73 +54,75 @@ export function activate(context: vscode.ExtensionContext) {
         const depthLimit = Number.isFinite(configuredDepthLimit) && configuredDepthLimit >= 0
             ? Math.min(Math.trunc(configuredDepthLimit), MAX_STACK_DEPTH_LIMIT)
             : 200;
+        const configuredTableDepth = configuration.get<number>('parallelStacks.initialTableDepth') ?? DEFAULT_INITIAL_TABLE_DEPTH;
+        const initialTableDepth = Number.isFinite(configuredTableDepth) && configuredTableDepth >= 0
+            ? Math.trunc(configuredTableDepth)
+            : DEFAULT_INITIAL_TABLE_DEPTH;
+        const configuredConcurrency = configuration.get<number>('parallelStacks.maxConcurrentRequests') ?? DEFAULT_MAX_CONCURRENT_REQUESTS;
+        const maxConcurrentRequests = Number.isFinite(configuredConcurrency) && configuredConcurrency >= 1
+            ? Math.trunc(configuredConcurrency)
+            : DEFAULT_MAX_CONCURRENT_REQUESTS;
+        const configuredTimeLimit = configuration.get<number>('parallelStacks.renderTimeLimit') ?? DEFAULT_RENDER_TIME_LIMIT;
+        const renderTimeLimit = Number.isFinite(configuredTimeLimit) && configuredTimeLimit >= 0
+            ? Math.trunc(configuredTimeLimit)
+            : DEFAULT_RENDER_TIME_LIMIT;
 
         try {
-            // Request thread information
-            // https://microsoft.github.io/debug-adapter-protocol/specification#Requests_Threads
-            const threadsResponse = await session.customRequest('threads');
-            const threads = threadsResponse.threads || [];
-
-            const stacks = new Merger.VectorVectorFrame();
+            // The merged tree stays in the WASM module while the panel is open. Deeper tables are
+            // rendered only when the user expands them, each rendering within the time limit, and
+            // the stacks are updated with deltas on each stop of the debugger.
+            const merger = Merger;
+            const threadStacks = new ThreadStacks();
+
+            const withStack = (frames: any[], callback: (stack: VectorFrame) => void) => {
+                const stack = createVectorFrame(merger, frames);
+                try {
+                    callback(stack);
+                } finally {
+                    stack.delete();
+                }
+            };
 
-            let dot = 'digraph { }';
-            try {
-                // Request the call stack for each thread
+            // Fetches the changed stacks and passes them to the callback.
+            // Returns the number of changed threads.
+            const updateStacks = async (onChange: StackChangeCallback): Promise<number> => {
+                // Request thread information
+                // https://microsoft.github.io/debug-adapter-protocol/specification#Requests_Threads
                 // Specification of Thread type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_Thread
-                // Specification of StackFrame type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_StackFrame
-                for (const thread of threads) {
-                    // Probe with one frame to discover totalFrames (if the debug adapter provides it).
-                    // https://microsoft.github.io/debug-adapter-protocol/specification#Requests_StackTrace
-                    const probeStackTraceResponse = await session.customRequest('stackTrace', {
-                        threadId: thread.id,
-                        startFrame: 0,
-                        levels: 1
-                    });
-
-                    const { startFrame, levels } = calculateStackBounds({
-                        totalFrames: probeStackTraceResponse?.totalFrames,
-                        depthLimit: depthLimit
-                    });
-
-                    // TODO: limit by Merger.merge_to_graphviz_dot() when totalFrames is unavailable.
-                    const stackTraceResponse = await session.customRequest('stackTrace', {
-                        threadId: thread.id,
-                        startFrame: startFrame,
-                        levels: levels
-                    });
-                    const frames = stackTraceResponse.stackFrames || [];
-
-                    // Specification of StackFrame type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_StackFrame
-                    // Specification of Source type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_Source
-                    const stack = new Merger.VectorFrame();
-
-                    for (const frame of frames) {
-                        const mergerFrame = new Merger.Frame();
-                        try {
-                            mergerFrame.function = String(frame.name || '');
-                            mergerFrame.filename = frame.source?.path
-                                ? path.basename(frame.source.path)
-                                : String(frame.source?.name || '');
-                            mergerFrame.row = Number(frame.line || 0);
-                            mergerFrame.column = Number(frame.column || 0);
-                            stack.push_back(mergerFrame);
-                        } finally {
-                            mergerFrame.delete();
-                        }
-                    }
-
-                    if (stack.size() > 0) {
-                        stacks.push_back(stack);
+                const threadsResponse = await session.customRequest('threads');
+                const threadIds: number[] = (threadsResponse.threads || []).map((thread: any) => thread.id);
+                const requestStackTrace = (args: StackTraceArgs) => session.customRequest('stackTrace', args);
+                return threadStacks.update(requestStackTrace, threadIds, depthLimit, maxConcurrentRequests, onChange);
+            };
+
+            // The first stacks are merged at once, the later changes one by one.
+            const initialStacks = new merger.VectorVectorFrame();
+            let view: TreeView;
+            try {
+                await updateStacks((_removed, added) => {
+                    if (added) {
+                        withStack(added, (stack) => initialStacks.push_back(stack));
                     }
-                    stack.delete();
+                });
+                view = new merger.TreeView(initialStacks);
+            } finally {
+                initialStacks.delete();
+            }
+            const applyStackChange: StackChangeCallback = (removed, added) => {
+                if (removed) {
+                    withStack(removed, (stack) => view.remove_stack(stack));
+                }
+                if (added) {
+                    withStack(added, (stack) => view.add_stack(stack));
                 }
+            };
 
-                dot = Merger.merge_to_graphviz_dot(stacks) || dot;
+            let dot = 'digraph { }';
+            try {
+                dot = view.render_budgeted(initialTableDepth, renderTimeLimit, undefined) || dot;
             } catch (mergeError: any) {
-                console.error('merge_to_graphviz_dot failed:', mergeError);
-                dot = 'digraph { label="merge_to_graphviz_dot failed" }';
-            } finally {
-                stacks.delete();
+                console.error('TreeView failed:', mergeError);
+                dot = 'digraph { label="TreeView failed" }';
             }
 
             const tabIndex = ++webviewCounter;
@@ -128,7 +143,7 @@ export function activate(context: vscode.ExtensionContext) {
             const viz = await instance();
 
             // Render to SVG
-            const svg = viz.renderString(dot, { format: "svg" });
+            let svg = viz.renderString(dot, { format: "svg" });
 
             const svgPanZoomUri = vscode.Uri.joinPath(context.extensionUri, 'media', 'svg-pan-zoom.min.js');
             const svgPanZoomWebviewUri = panel.webview.asWebviewUri(svgPanZoomUri).toString();
@@ -138,8 +153,50 @@ export function activate(context: vscode.ExtensionContext) {
             panel.webview.html = html;
             await persistWebviewHtml(html, [[svgPanZoomWebviewUri, svgPanZoomFileUri]]);
 
+            let disposed = false;
+            const showSvg = async (graph: string) => {
+                svg = viz.renderString(graph, { format: "svg" });
+                await panel.webview.postMessage({ type: 'updateSvg', svg });
+            };
+
+            // Stops come in bursts, so a refresh requested during another one runs once after it.
+            let refreshRunning = false;
+            let refreshQueued = false;
+            const livePanel: LivePanel = {
+                session,
+                refresh: async () => {
+                    if (refreshRunning) {
+                        refreshQueued = true;
+                        return;
+                    }
+                    refreshRunning = true;
+                    try {
+                        do {
+                            refreshQueued = false;
+                            const changed = await updateStacks(applyStackChange);
+                            if (changed > 0 && !disposed) {
+                                await showSvg(view.dot_budgeted(renderTimeLimit, undefined));
+                            }
+                        } while (refreshQueued && !disposed);
+                    } catch (refreshError: any) {
+                        console.error('Parallel Stacks refresh failed:', refreshError);
+                    } finally {
+                        refreshRunning = false;
+                    }
+                }
+            };
+            livePanels.add(livePanel);
+
+            panel.onDidDispose(() => {
+                disposed = true;
+                livePanels.delete(livePanel);
+                view.delete();
+            });
+
             panel.webview.onDidReceiveMessage(async (message) => {
-                if (message?.type === 'saveSvg') {
+                if (message?.type === 'expandTable' && !disposed && Number.isInteger(message.tableId)) {
+                    await showSvg(view.expand_budgeted(message.tableId, renderTimeLimit, undefined));
+                } else if (message?.type === 'saveSvg') {
                     const updatedDir = await handleSaveSvg(context, svg, lastSaveDir, tabIndex);
                     if (updatedDir) {
                         lastSaveDir = updatedDir;
@@ -151,6 +208,33 @@ export function activate(context: vscode.ExtensionContext) {
         }
     });
 
+    // Panels follow the stops of their debug session until the session ends.
+    const stopTracker = vscode.debug.registerDebugAdapterTrackerFactory('*', {
+        createDebugAdapterTracker(session: vscode.DebugSession) {
+            return {
+                onDidSendMessage(message: any) {
+                    // https://microsoft.github.io/debug-adapter-protocol/specification#Events_Stopped
+                    if (message?.type === 'event' && message.event === 'stopped') {
+                        for (const livePanel of livePanels) {
+                            if (livePanel.session.id === session.id) {
+                                void livePanel.refresh();
+                            }
+                        }
+                    }
+                }
+            };
+        }
+    });
+
+    const sessionEnd = vscode.debug.onDidTerminateDebugSession((session) => {
+        for (const livePanel of livePanels) {
+            if (livePanel.session.id === session.id) {
+                livePanels.delete(livePanel);
+            }
+        }
+    });
+
+    context.subscriptions.push(stopTracker, sessionEnd);
     context.subscriptions.push(disposable);
 }
 
@@ -174,10 +258,7 @@ async function buildWebviewHtml(
     svgPanZoomUri: string
 ): Promise<string> {
     const template = await getWebviewTemplate(context);
-    return applyReplacements(template, [
-        ['{{SVG_CONTENT}}', svgContent],
-        ['{{SVG_PAN_ZOOM_URI}}', svgPanZoomUri]
-    ]);
+    return fillWebviewTemplate(template, svgContent, svgPanZoomUri);
 }
 
 let cachedWebviewTemplate: string | null = null;
@@ -192,10 +273,6 @@ async function getWebviewTemplate(context: vscode.ExtensionContext): Promise<str
     return cachedWebviewTemplate;
 }
 
-function applyReplacements(value: string, replacements: Array<[string, string]>): string {
-    return replacements.reduce((acc, [from, to]) => acc.split(from).join(to), value);
-}
-
 async function handleSaveSvg(
     context: vscode.ExtensionContext,
     svgContent: string,
@@ -0,0 +1,30 @@
+import * as path from 'path';
+import createMerger from '../media/merger';
+
+export type MergerModule = Awaited<ReturnType<typeof createMerger>>;
+export type VectorFrame = InstanceType<MergerModule['VectorFrame']>;
+
+/**
+ * Converts frames of a 'stackTrace' response to a stack of the merger module.
+ * The caller deletes the stack.
+ */
+export function createVectorFrame(merger: MergerModule, frames: any[]): VectorFrame {
+    // Specification of StackFrame type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_StackFrame
+    // Specification of Source type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_Source
+    const stack = new merger.VectorFrame();
+    for (const frame of frames) {
+        const mergerFrame = new merger.Frame();
+        try {
+            mergerFrame.function = String(frame.name || '');
+            mergerFrame.filename = frame.source?.path
+                ? path.basename(frame.source.path)
+                : String(frame.source?.name || '');
+            mergerFrame.row = Number(frame.line || 0);
+            mergerFrame.column = Number(frame.column || 0);
+            stack.push_back(mergerFrame);
+        } finally {
+            mergerFrame.delete();
+        }
+    }
+    return stack;
+}
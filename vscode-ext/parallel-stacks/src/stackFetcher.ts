@@ -0,0 +1,82 @@
+import { calculateStackBounds } from './stackBounds';
+
+export type StackTraceArgs = {
+    threadId: number;
+    startFrame: number;
+    levels: number;
+};
+
+// Sends a 'stackTrace' request to the debug adapter.
+// https://microsoft.github.io/debug-adapter-protocol/specification#Requests_StackTrace
+export type StackTraceRequest = (args: StackTraceArgs) => Promise<any>;
+
+/**
+ * Calls `callback` for each item with at most `concurrency` calls in flight.
+ * Items are started in order; results are not collected, so the callback handles them as they arrive.
+ */
+export async function forEachConcurrently<T>(
+    items: readonly T[],
+    concurrency: number,
+    callback: (item: T, index: number) => Promise<void>
+): Promise<void> {
+    let next = 0;
+    const worker = async () => {
+        while (next < items.length) {
+            const index = next++;
+            await callback(items[index], index);
+        }
+    };
+
+    const workerCount = Math.max(1, Math.min(Math.trunc(concurrency) || 1, items.length));
+    await Promise.all(Array.from({ length: workerCount }, worker));
+}
+
+export type FetchedStack = {
+    // Frames from the top of the stack; only the bottom `depthLimit` frames are kept.
+    frames: any[];
+    // The top frame of the thread even if it is cut by the depth limit.
+    topFrame: any;
+};
+
+/**
+ * Fetches the bottom `depthLimit` frames of a thread, or all frames if `depthLimit` is 0.
+ *
+ * The first page already covers the whole stack in most cases, so a second request is sent only
+ * when the adapter reports more frames than the limit. If the adapter doesn't report `totalFrames`
+ * and the first page is full, the whole stack is fetched and cut on the client.
+ */
+export async function fetchStackFrames(
+    request: StackTraceRequest,
+    threadId: number,
+    depthLimit: number
+): Promise<FetchedStack> {
+    const safeDepthLimit = Math.max(0, Math.trunc(depthLimit));
+    if (safeDepthLimit === 0) {
+        const response = await request({ threadId, startFrame: 0, levels: 0 });
+        const frames: any[] = response?.stackFrames || [];
+        return { frames, topFrame: frames[0] };
+    }
+
+    const firstPage = await request({ threadId, startFrame: 0, levels: safeDepthLimit });
+    const firstFrames: any[] = firstPage?.stackFrames || [];
+    const topFrame = firstFrames[0];
+
+    // A short page means the end of the stack, regardless of totalFrames.
+    if (firstFrames.length < safeDepthLimit) {
+        return { frames: firstFrames, topFrame };
+    }
+
+    const totalFrames = Number(firstPage?.totalFrames);
+    if (Number.isFinite(totalFrames)) {
+        if (totalFrames <= firstFrames.length) {
+            return { frames: firstFrames, topFrame };
+        }
+        const { startFrame, levels } = calculateStackBounds({ totalFrames, depthLimit: safeDepthLimit });
+        const response = await request({ threadId, startFrame, levels });
+        return { frames: response?.stackFrames || [], topFrame };
+    }
+
+    const response = await request({ threadId, startFrame: 0, levels: 0 });
+    const frames: any[] = response?.stackFrames || [];
+    return { frames: frames.slice(-safeDepthLimit), topFrame };
+}
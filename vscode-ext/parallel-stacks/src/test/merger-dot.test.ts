@@ -64,3 +64,91 @@ test('merge_to_graphviz_dot should match expected .dot output', async () => {
         stacks.delete();
     }
 });
+
+test('TreeView should render deeper tables on demand', async () => {
+    Merger = await createMerger();
+
+    const input: FrameData[][] = [
+        [
+            { function: 'func2', filename: 'file2.cpp', row: 20, column: 10 },
+            { function: 'func1', filename: 'file1.cpp', row: 10, column: 5 }
+        ],
+        [
+            { function: 'func3', filename: 'file3.cpp', row: 30, column: 15 },
+            { function: 'func1', filename: 'file1.cpp', row: 10, column: 5 }
+        ]
+    ];
+
+    const stacks = createStacks(input);
+    const view = new Merger.TreeView(stacks);
+
+    try {
+        const firstDot = view.render(1);
+        assert.match(firstDot, /table_0 -> table_0_more/);
+        assert.doesNotMatch(firstDot, /func2/);
+
+        const expandedDot = view.expand(0);
+        assert.doesNotMatch(expandedDot, /table_0_more/);
+        assert.match(expandedDot, /func2/);
+        assert.match(expandedDot, /func3/);
+    } finally {
+        view.delete();
+        stacks.delete();
+    }
+});
+
+test('merge_to_graphviz_dot_budgeted should stop when the progress callback cancels it', async () => {
+    Merger = await createMerger();
+
+    const input: FrameData[][] = [];
+    for (let i = 0; i < 600; i++) {
+        input.push([
+            { function: `leaf${i}`, filename: 'leaf.cpp', row: i, column: 1 },
+            { function: 'main', filename: 'main.cpp', row: 1, column: 1 }
+        ]);
+    }
+
+    const stacks = createStacks(input);
+
+    try {
+        const complete = Merger.merge_to_graphviz_dot_budgeted(stacks, 0, 0, undefined);
+        assert.strictEqual(complete.truncated, false);
+        assert.doesNotMatch(complete.dot, /Truncated/);
+
+        const stages: string[] = [];
+        const cancelled = Merger.merge_to_graphviz_dot_budgeted(stacks, 0, 0, (stage: string, done: number) => {
+            stages.push(stage);
+            return stage === 'merge' || done === 0;
+        });
+        assert.strictEqual(cancelled.truncated, true);
+        assert.match(cancelled.dot, /label="Truncated: \d+ tables not rendered"/);
+        assert.match(cancelled.dot, /_more \[shape=box/);
+        assert.ok(stages.includes('merge') && stages.includes('render'));
+    } finally {
+        stacks.delete();
+    }
+});
+
+test('TreeView should render within the budget and replace the rest with placeholders', async () => {
+    Merger = await createMerger();
+
+    const input: FrameData[][] = [];
+    for (let i = 0; i < 600; i++) {
+        input.push([{ function: `root${i}`, filename: 'root.cpp', row: i, column: 1 }]);
+    }
+
+    const stacks = createStacks(input);
+    const view = new Merger.TreeView(stacks);
+
+    try {
+        const complete = view.render_budgeted(0, 0, undefined);
+        assert.doesNotMatch(complete, /_more/);
+
+        const truncated = view.render_budgeted(0, 0, (stage: string, done: number) => stage === 'render' && done === 0);
+        assert.match(truncated, /label="Truncated: \d+ tables not rendered"/);
+        assert.match(truncated, /table_roots_more \[shape=box/);
+    } finally {
+        view.delete();
+        stacks.delete();
+    }
+});
@@ -0,0 +1,64 @@
+import assert from 'node:assert/strict';
+import test from 'node:test';
+import { fetchStackFrames, forEachConcurrently, StackTraceArgs } from '../stackFetcher';
+
+// A fake debug adapter with a stack of `depth` frames named by their index.
+function createAdapter(depth: number, reportTotalFrames: boolean) {
+    const requests: StackTraceArgs[] = [];
+    const request = async (args: StackTraceArgs) => {
+        requests.push(args);
+        const end = args.levels === 0 ? depth : Math.min(depth, args.startFrame + args.levels);
+        const stackFrames = [];
+        for (let i = args.startFrame; i < end; i++) {
+            stackFrames.push({ name: `f${i}` });
+        }
+        return reportTotalFrames ? { stackFrames, totalFrames: depth } : { stackFrames };
+    };
+    return { request, requests };
+}
+
+test('fetchStackFrames sends one request when the first page covers the stack', async () => {
+    const adapter = createAdapter(5, true);
+    const { frames, topFrame } = await fetchStackFrames(adapter.request, 1, 10);
+    assert.strictEqual(frames.length, 5);
+    assert.strictEqual(topFrame.name, 'f0');
+    assert.deepStrictEqual(adapter.requests, [{ threadId: 1, startFrame: 0, levels: 10 }]);
+});
+
+test('fetchStackFrames fetches the bottom frames of a deep stack', async () => {
+    const adapter = createAdapter(10, true);
+    const { frames, topFrame } = await fetchStackFrames(adapter.request, 1, 3);
+    assert.deepStrictEqual(frames.map((frame) => frame.name), ['f7', 'f8', 'f9']);
+    assert.strictEqual(topFrame.name, 'f0');
+    assert.strictEqual(adapter.requests.length, 2);
+});
+
+test('fetchStackFrames cuts the whole stack when totalFrames is not reported', async () => {
+    const adapter = createAdapter(10, false);
+    const { frames } = await fetchStackFrames(adapter.request, 1, 3);
+    assert.deepStrictEqual(frames.map((frame) => frame.name), ['f7', 'f8', 'f9']);
+});
+
+test('fetchStackFrames sends one request without a depth limit', async () => {
+    const adapter = createAdapter(10, true);
+    const { frames } = await fetchStackFrames(adapter.request, 1, 0);
+    assert.strictEqual(frames.length, 10);
+    assert.strictEqual(adapter.requests.length, 1);
+});
+
+test('forEachConcurrently bounds the number of calls in flight', async () => {
+    let inFlight = 0;
+    let maxInFlight = 0;
+    const visited: number[] = [];
+
+    await forEachConcurrently([1, 2, 3, 4, 5, 6, 7], 3, async (item) => {
+        inFlight++;
+        maxInFlight = Math.max(maxInFlight, inFlight);
+        await new Promise((resolve) => setTimeout(resolve, 1));
+        visited.push(item);
+        inFlight--;
+    });
+
+    assert.strictEqual(maxInFlight, 3);
+    assert.deepStrictEqual(visited.sort(), [1, 2, 3, 4, 5, 6, 7]);
+});
@@ -0,0 +1,64 @@
+import assert from 'node:assert/strict';
+import test from 'node:test';
+import { StackTraceArgs } from '../stackFetcher';
+import { ThreadStacks } from '../threadStacks';
+
+// A fake debug adapter with the stacks of threads as lists of frame names from the top.
+function createAdapter(stacks: Map<number, string[]>) {
+    const requests: StackTraceArgs[] = [];
+    const request = async (args: StackTraceArgs) => {
+        requests.push(args);
+        const names = stacks.get(args.threadId);
+        if (!names) {
+            throw new Error('Unknown thread');
+        }
+        const end = args.levels === 0 ? names.length : Math.min(names.length, args.startFrame + args.levels);
+        const stackFrames = names.slice(args.startFrame, end).map((name) => ({ name, line: 1 }));
+        return { stackFrames, totalFrames: names.length };
+    };
+    return { request, requests };
+}
+
+function names(frames: any[] | null): string[] | null {
+    return frames ? frames.map((frame) => frame.name) : null;
+}
+
+test('ThreadStacks reports only the changed threads', async () => {
+    const stacks = new Map<number, string[]>([
+        [1, ['c', 'b', 'a']],
+        [2, ['d', 'a']],
+        [3, ['e']],
+    ]);
+    const adapter = createAdapter(stacks);
+    const threadStacks = new ThreadStacks();
+
+    const first: Array<[string[] | null, string[] | null]> = [];
+    const firstCount = await threadStacks.update(adapter.request, [1, 2, 3], 10, 4, (removed, added) => {
+        first.push([names(removed), names(added)]);
+    });
+    assert.strictEqual(firstCount, 3);
+    assert.ok(first.every(([removed]) => removed === null));
+
+    // Thread 1 moves, thread 3 exits, thread 4 appears.
+    stacks.set(1, ['x', 'b', 'a']);
+    stacks.delete(3);
+    stacks.set(4, ['f', 'a']);
+    adapter.requests.length = 0;
+
+    const changes: Array<[string[] | null, string[] | null]> = [];
+    const count = await threadStacks.update(adapter.request, [1, 2, 4], 10, 4, (removed, added) => {
+        changes.push([names(removed), names(added)]);
+    });
+
+    assert.strictEqual(count, 3);
+    assert.deepStrictEqual(changes.sort(), [
+        [['c', 'b', 'a'], ['x', 'b', 'a']],
+        [['e'], null],
+        [null, ['f', 'a']],
+    ].sort());
+
+    // Thread 2 is checked with a single one-frame request.
+    assert.deepStrictEqual(adapter.requests.filter((args) => args.threadId === 2), [
+        { threadId: 2, startFrame: 0, levels: 1 },
+    ]);
+});
@@ -0,0 +1,75 @@
+import { fetchStackFrames, forEachConcurrently, StackTraceRequest } from './stackFetcher';
+
+// Identity of a frame across stops of the debugger. Frame ids are not stable between stops.
+// Specification of StackFrame type: https://microsoft.github.io/debug-adapter-protocol/specification#Types_StackFrame
+export function stackFrameKey(frame: any): string {
+    if (!frame) {
+        return '';
+    }
+    const source = frame.source?.path ?? frame.source?.name ?? '';
+    return `${frame.name ?? ''}\u0000${source}\u0000${frame.line ?? 0}\u0000${frame.column ?? 0}`;
+}
+
+// Called for a thread whose stack changed: with its previous stack, its new stack, or both.
+export type StackChangeCallback = (removed: any[] | null, added: any[] | null) => void;
+
+type ThreadStack = {
+    topFrameKey: string;
+    frames: any[];
+};
+
+/**
+ * Stacks of the threads at the last stop of the debugger.
+ *
+ * On the next stop only the threads whose top frame moved, and the threads that appeared or
+ * disappeared, are reported as changes, so a merged tree is updated with deltas.
+ */
+export class ThreadStacks {
+    private readonly threads = new Map<number, ThreadStack>();
+
+    /**
+     * @returns The number of changed threads.
+     */
+    async update(
+        request: StackTraceRequest,
+        threadIds: readonly number[],
+        depthLimit: number,
+        concurrency: number,
+        onChange: StackChangeCallback
+    ): Promise<number> {
+        let changed = 0;
+        const alive = new Set<number>();
+
+        await forEachConcurrently(threadIds, concurrency, async (threadId) => {
+            const previous = this.threads.get(threadId);
+            try {
+                if (previous) {
+                    const top = await request({ threadId, startFrame: 0, levels: 1 });
+                    if (stackFrameKey(top?.stackFrames?.[0]) === previous.topFrameKey) {
+                        alive.add(threadId);
+                        return;
+                    }
+                }
+
+                const { frames, topFrame } = await fetchStackFrames(request, threadId, depthLimit);
+                alive.add(threadId);
+                this.threads.set(threadId, { topFrameKey: stackFrameKey(topFrame), frames });
+                onChange(previous?.frames ?? null, frames);
+                changed++;
+            } catch (error) {
+                // The thread may have exited since the 'threads' request. It is removed below.
+                console.error(`stackTrace failed for thread ${threadId}:`, error);
+            }
+        });
+
+        for (const [threadId, stack] of this.threads) {
+            if (!alive.has(threadId)) {
+                this.threads.delete(threadId);
+                onChange(stack.frames, null);
+                changed++;
+            }
+        }
+
+        return changed;
+    }
+}
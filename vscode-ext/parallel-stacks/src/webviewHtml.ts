@@ -0,0 +1,13 @@
+/**
+ * Fills the webview template (media/webview.html) with the SVG of a graph.
+ */
+export function fillWebviewTemplate(template: string, svgContent: string, svgPanZoomUri: string): string {
+    return applyReplacements(template, [
+        ['{{SVG_CONTENT}}', svgContent],
+        ['{{SVG_PAN_ZOOM_URI}}', svgPanZoomUri]
+    ]);
+}
+
+export function applyReplacements(value: string, replacements: Array<[string, string]>): string {
+    return replacements.reduce((acc, [from, to]) => acc.split(from).join(to), value);
+}